@@ -71,21 +71,38 @@
 
 #include <string.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <limits.h>
 
 #if defined(__unix__) || defined(__APPLE__) || defined(__linux__) || defined(__MINGW32__) || defined(__MINGW64__)
 #include <unistd.h>
 #endif
 #include <sched.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/sendfile.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <glob.h>
+#include <elf.h>
+#include <linux/perf_event.h>
 
 // 函数前向声明
 void test_memory_access_optimization(void);
 void aes_sm3_integrity_batch_no_prefetch(const uint8_t** inputs, uint8_t** outputs, int batch_size);
 void batch_xor_folding_compress_no_prefetch(const uint8_t** inputs, uint8_t** outputs, int batch_size);
 void batch_sm3_hash_no_prefetch(const uint8_t** compressed_inputs, uint8_t** outputs, int batch_size);
+void aes_sm3_integrity_batch_super_prefetch(const uint8_t** inputs, uint8_t** outputs, int batch_size);
+void aes_sm3_integrity_batch_pipeline_prefetch(const uint8_t** inputs, uint8_t** outputs, int batch_size);
 void aes_sm3_integrity_256bit_extreme(const uint8_t* input, uint8_t* output);
 void aes_sm3_integrity_256bit_ultra(const uint8_t* input, uint8_t* output);
 void aes_sm3_integrity_256bit_mega(const uint8_t* input, uint8_t* output);
@@ -106,6 +123,251 @@ static inline uint32x4_t vrev32q_u32(uint32x4_t vec) {
 #endif
 #endif
 
+// ============================================================================
+// 运行时统计（热路径部分）
+// ============================================================================
+/*
+ * 每个线程第一次记录时登记一个独占缓存行的计数块，之后只写自己的计数块：
+ * relaxed原子加载+存储编译为普通访存指令，没有原子读改写和锁。
+ * 快照在登记表锁下读取所有计数块；线程退出时计数并入退役累计。
+ * 编译时定义 AES_SM3_STATS=0 可完全去掉统计代码。
+ */
+#ifndef AES_SM3_STATS
+#define AES_SM3_STATS 1
+#endif
+
+#define AES_SM3_CACHE_LINE 64
+
+// 按入口统计的核函数（128位输出计入256bit）
+#define AES_SM3_KERNEL_256BIT    0
+#define AES_SM3_KERNEL_HYPER     1
+#define AES_SM3_KERNEL_BATCH     2
+#define AES_SM3_KERNEL_STREAMING 3
+#define AES_SM3_KERNEL_COPY      4
+#define AES_SM3_KERNEL_SECTOR    5  // 页数按512字节扇区数/8向上取整
+#define AES_SM3_KERNEL_LARGE     6  // 8KB/16KB/64KB特化，页数按4KB折算
+#define AES_SM3_KERNEL_EXTREME   7
+#define AES_SM3_KERNEL_ULTRA     8
+#define AES_SM3_KERNEL_MEGA      9
+#define AES_SM3_KERNEL_SUPER     10
+#define AES_SM3_KERNEL_BATCH_NO_PREFETCH       11
+#define AES_SM3_KERNEL_BATCH_SUPER_PREFETCH    12
+#define AES_SM3_KERNEL_BATCH_PIPELINE_PREFETCH 13
+#define AES_SM3_STAT_KERNELS     14
+
+#define AES_SM3_STAT_BATCH_BUCKETS 14  // 批大小：1, 2-3, 4-7, ..., >=8192
+#define AES_SM3_STAT_WAIT_BUCKETS  16  // 排队等待：<256ns, <512ns, ..., >=4.2ms
+
+// 所有字段都是 unsigned long long，快照和合并按数组处理
+typedef struct {
+    unsigned long long kernel_calls[AES_SM3_STAT_KERNELS];
+    unsigned long long kernel_pages[AES_SM3_STAT_KERNELS];
+    unsigned long long batch_calls;
+    unsigned long long batch_pages;
+    unsigned long long batch_hist[AES_SM3_STAT_BATCH_BUCKETS];
+    unsigned long long jobs;
+    unsigned long long wait_ns;
+    unsigned long long wait_hist[AES_SM3_STAT_WAIT_BUCKETS];
+    unsigned long long busy_ns;
+    unsigned long long idle_ns;
+} aes_sm3_stats_t;
+
+#define AES_SM3_STAT_FIELDS (sizeof(aes_sm3_stats_t) / sizeof(unsigned long long))
+#define STAT_INDEX(field) (offsetof(aes_sm3_stats_t, field) / sizeof(unsigned long long))
+
+static inline uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#if AES_SM3_STATS
+typedef struct stats_block {
+    atomic_ullong counters[AES_SM3_STAT_FIELDS];
+    struct stats_block* next;
+    int thread_id;
+} __attribute__((aligned(AES_SM3_CACHE_LINE))) stats_block_t;
+
+static __thread stats_block_t* tls_stats;
+static stats_block_t* stats_register(void);
+
+static inline void stats_add(size_t index, unsigned long long value) {
+    stats_block_t* block = tls_stats;
+    if (__builtin_expect(block == NULL, 0)) {
+        block = stats_register();
+    }
+    unsigned long long cur = atomic_load_explicit(&block->counters[index], memory_order_relaxed);
+    atomic_store_explicit(&block->counters[index], cur + value, memory_order_relaxed);
+}
+
+static inline void stats_kernel(int kernel, unsigned long long pages) {
+    stats_add(STAT_INDEX(kernel_calls) + kernel, 1);
+    stats_add(STAT_INDEX(kernel_pages) + kernel, pages);
+}
+
+static inline void stats_batch(unsigned long long pages) {
+    int bucket = pages ? 63 - __builtin_clzll(pages) : 0;
+    if (bucket >= AES_SM3_STAT_BATCH_BUCKETS) {
+        bucket = AES_SM3_STAT_BATCH_BUCKETS - 1;
+    }
+    stats_add(STAT_INDEX(batch_calls), 1);
+    stats_add(STAT_INDEX(batch_pages), pages);
+    stats_add(STAT_INDEX(batch_hist) + bucket, 1);
+}
+
+static inline void stats_job_wait(uint64_t enqueue_ns, uint64_t now) {
+    uint64_t wait = now > enqueue_ns ? now - enqueue_ns : 0;
+    uint64_t scaled = wait >> 8;
+    int bucket = scaled ? 64 - __builtin_clzll(scaled) : 0;
+    if (bucket >= AES_SM3_STAT_WAIT_BUCKETS) {
+        bucket = AES_SM3_STAT_WAIT_BUCKETS - 1;
+    }
+    stats_add(STAT_INDEX(jobs), 1);
+    stats_add(STAT_INDEX(wait_ns), wait);
+    stats_add(STAT_INDEX(wait_hist) + bucket, 1);
+}
+
+#define STAT_KERNEL(kernel, pages) stats_kernel((kernel), (pages))
+#define STAT_BATCH(pages) stats_batch(pages)
+#define STAT_TIMESTAMP(var) uint64_t var = monotonic_ns()
+#define STAT_JOB_STAMP(job) ((job).enqueue_ns = monotonic_ns())
+#define STAT_JOB_WAIT(job, now) stats_job_wait((job).enqueue_ns, (now))
+#define STAT_BUSY(ns) stats_add(STAT_INDEX(busy_ns), (ns))
+#define STAT_IDLE(ns) stats_add(STAT_INDEX(idle_ns), (ns))
+#else
+#define STAT_KERNEL(kernel, pages) ((void)0)
+#define STAT_BATCH(pages) ((void)0)
+#define STAT_TIMESTAMP(var) ((void)0)
+#define STAT_JOB_STAMP(job) ((void)0)
+#define STAT_JOB_WAIT(job, now) ((void)0)
+#define STAT_BUSY(ns) ((void)0)
+#define STAT_IDLE(ns) ((void)0)
+#endif
+
+// ============================================================================
+// 时间线追踪（热路径部分）
+// ============================================================================
+/*
+ * 并行引擎和批处理流水线在阶段边界记录区间（线程启动、分区、折叠、SM3、
+ * 等待/汇合），写入每线程环形缓冲区，导出为Chrome trace-event JSON。
+ * 未开启追踪时每个记录点只有一次relaxed加载；AES_SM3_TRACE=0 时完全去掉。
+ * 区间粒度为任务/批次，不在逐页路径上记录。
+ */
+#ifndef AES_SM3_TRACE
+#define AES_SM3_TRACE 1
+#endif
+
+#if AES_SM3_TRACE
+static atomic_int g_trace_enabled;
+static __thread char tls_trace_name[32];
+
+static void trace_record(const char* name, uint64_t start_ns, uint64_t end_ns, int arg);
+
+// 返回区间起点；未开启追踪时返回0，对应的trace_end不做任何事
+static inline uint64_t trace_begin(void) {
+    if (__builtin_expect(!atomic_load_explicit(&g_trace_enabled, memory_order_relaxed), 1)) {
+        return 0;
+    }
+    return monotonic_ns();
+}
+
+static inline void trace_end(uint64_t start_ns, const char* name, int arg) {
+    if (start_ns != 0) {
+        trace_record(name, start_ns, monotonic_ns(), arg);
+    }
+}
+
+static inline void trace_thread_name(const char* prefix, int id) {
+    snprintf(tls_trace_name, sizeof(tls_trace_name), "%s-%d", prefix, id);
+}
+
+#define TRACE_BEGIN(var) uint64_t var = trace_begin()
+#define TRACE_END(var, name, arg) trace_end((var), (name), (arg))
+#define TRACE_STAMP(lvalue) ((lvalue) = trace_begin())
+#define TRACE_THREAD_NAME(prefix, id) trace_thread_name((prefix), (id))
+#else
+#define TRACE_BEGIN(var) ((void)0)
+#define TRACE_END(var, name, arg) ((void)0)
+#define TRACE_STAMP(lvalue) ((void)0)
+#define TRACE_THREAD_NAME(prefix, id) ((void)0)
+#endif
+
+// ============================================================================
+// USDT静态探针
+// ============================================================================
+/*
+ * 系统提供 <sys/sdt.h> 时，在批处理、并行引擎、自适应线程控制和校验失败处
+ * 放置USDT探针（提供者aes_sm3），bpftrace/perf可在不重新编译的情况下挂接：
+ *   bpftrace -e 'usdt:./app:aes_sm3:batch_end { @[arg0] = hist(arg2); }'
+ * 探针位置只是一条nop；每个探针带semaphore，挂接后才读取周期计数器和计算参数。
+ *
+ *   batch_start(kernel, pages)            batch_end(kernel, pages, cycles)
+ *   job_submit(jobs, pages)               job_complete(pages, cycles)
+ *   adapt_decision(threads, next_threads, phase)
+ *   verify_mismatch(source, page)         source: 0巡检 1页缓存 2数据库页
+ *
+ * 定义 AES_SM3_USDT=0 可去掉探针。
+ */
+#ifndef AES_SM3_USDT
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define AES_SM3_USDT 1
+#endif
+#endif
+#endif
+#ifndef AES_SM3_USDT
+#define AES_SM3_USDT 0
+#endif
+
+#define AES_SM3_MISMATCH_SCRUB 0
+#define AES_SM3_MISMATCH_CACHE 1
+#define AES_SM3_MISMATCH_PAGE  2
+
+#if AES_SM3_USDT
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+// 周期计数器：ARM为通用定时器计数，x86为TSC
+static inline uint64_t cycle_counter(void) {
+#if defined(__aarch64__)
+    uint64_t v;
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(v));
+    return v;
+#elif defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return monotonic_ns();
+#endif
+}
+
+// semaphore由挂接工具写入，名称须为 <provider>_<probe>_semaphore
+#define USDT_SEMAPHORE(name) \
+    volatile unsigned short aes_sm3_##name##_semaphore __attribute__((unused, section(".probes")))
+#define USDT_ENABLED(name) __builtin_expect(aes_sm3_##name##_semaphore != 0, 0)
+
+USDT_SEMAPHORE(batch_start);
+USDT_SEMAPHORE(batch_end);
+USDT_SEMAPHORE(job_submit);
+USDT_SEMAPHORE(job_complete);
+USDT_SEMAPHORE(adapt_decision);
+USDT_SEMAPHORE(verify_mismatch);
+
+#define USDT_PROBE2(name, a, b) do { \
+    if (USDT_ENABLED(name)) STAP_PROBE2(aes_sm3, name, (a), (b)); \
+} while (0)
+#define USDT_PROBE3(name, a, b, c) do { \
+    if (USDT_ENABLED(name)) STAP_PROBE3(aes_sm3, name, (a), (b), (c)); \
+} while (0)
+// 仅在结束探针被挂接时读取起始周期数
+#define USDT_CYCLES_BEGIN(var, name) uint64_t var = USDT_ENABLED(name) ? cycle_counter() : 0
+#define USDT_CYCLES_SINCE(var) (cycle_counter() - (var))
+#else
+#define USDT_PROBE2(name, a, b) ((void)0)
+#define USDT_PROBE3(name, a, b, c) ((void)0)
+#define USDT_CYCLES_BEGIN(var, name) ((void)0)
+#define USDT_CYCLES_SINCE(var) 0
+#endif
+
 // ============================================================================
 // SM3算法常量和函数
 // ============================================================================
@@ -478,6 +740,7 @@ void aes_sm3_integrity_256bit(const uint8_t* input, uint8_t* output) {
     // 突破10倍极限优化策略：
     // 4KB -> 128B -> 256bit
     // 只需2个SM3块！（从64次减少到2次，32倍减少！）
+    STAT_KERNEL(AES_SM3_KERNEL_256BIT, 1);
     
     // 第一阶段：4KB -> 128字节（极限压缩，32:1压缩比）
     // 每256字节压缩到8字节，总共16组
@@ -670,13 +933,201 @@ void aes_sm3_integrity_256bit(const uint8_t* input, uint8_t* output) {
     out32[7] = __builtin_bswap32(sm3_state[7]);
 }
 
-// 128位输出版本
+// ============================================================================
+// 折叠/SM3阶段公共函数（供扩展接口复用，结果与aes_sm3_integrity_256bit一致）
+// ============================================================================
+
+// 单个256字节段 -> 8字节（与aes_sm3_integrity_256bit第一阶段逐平台一致）
+static inline void xor_fold_segment(const uint8_t* block, uint8_t* out) {
+#if defined(__ARM_FEATURE_CRYPTO) && defined(__aarch64__)
+    uint8x16_t x0 = veorq_u8(vld1q_u8(block + 0),   vld1q_u8(block + 16));
+    uint8x16_t x1 = veorq_u8(vld1q_u8(block + 32),  vld1q_u8(block + 48));
+    uint8x16_t x2 = veorq_u8(vld1q_u8(block + 64),  vld1q_u8(block + 80));
+    uint8x16_t x3 = veorq_u8(vld1q_u8(block + 96),  vld1q_u8(block + 112));
+    uint8x16_t x4 = veorq_u8(vld1q_u8(block + 128), vld1q_u8(block + 144));
+    uint8x16_t x5 = veorq_u8(vld1q_u8(block + 160), vld1q_u8(block + 176));
+    uint8x16_t x6 = veorq_u8(vld1q_u8(block + 192), vld1q_u8(block + 208));
+    uint8x16_t x7 = veorq_u8(vld1q_u8(block + 224), vld1q_u8(block + 240));
+    uint8x16_t final = veorq_u8(veorq_u8(veorq_u8(x0, x1), veorq_u8(x2, x3)),
+                                veorq_u8(veorq_u8(x4, x5), veorq_u8(x6, x7)));
+    vst1_u8(out, vget_low_u8(final));
+#else
+    // 按8字节步长异或：32个uint64逐字节异或与逐字节折叠等价
+    uint64_t acc0 = 0, acc1 = 0, acc2 = 0, acc3 = 0;
+    for (int k = 0; k < 32; k += 4) {
+        uint64_t w0, w1, w2, w3;
+        memcpy(&w0, block + (k + 0) * 8, 8);
+        memcpy(&w1, block + (k + 1) * 8, 8);
+        memcpy(&w2, block + (k + 2) * 8, 8);
+        memcpy(&w3, block + (k + 3) * 8, 8);
+        acc0 ^= w0; acc1 ^= w1; acc2 ^= w2; acc3 ^= w3;
+    }
+    uint64_t folded = acc0 ^ acc1 ^ acc2 ^ acc3;
+    memcpy(out, &folded, 8);
+#endif
+}
+
+// 覆盖段内全部字节的折叠：软件路径与xor_fold_segment相同，NEON路径把高8字节并入低8字节
+// （aarch64上aes_sm3_integrity_256bit只取低8字节，只改动每16字节中第8~15字节不影响其结果）
+static inline void xor_fold_segment_full(const uint8_t* block, uint8_t* out) {
+#if defined(__ARM_FEATURE_CRYPTO) && defined(__aarch64__)
+    uint8x16_t x0 = veorq_u8(vld1q_u8(block + 0),   vld1q_u8(block + 16));
+    uint8x16_t x1 = veorq_u8(vld1q_u8(block + 32),  vld1q_u8(block + 48));
+    uint8x16_t x2 = veorq_u8(vld1q_u8(block + 64),  vld1q_u8(block + 80));
+    uint8x16_t x3 = veorq_u8(vld1q_u8(block + 96),  vld1q_u8(block + 112));
+    uint8x16_t x4 = veorq_u8(vld1q_u8(block + 128), vld1q_u8(block + 144));
+    uint8x16_t x5 = veorq_u8(vld1q_u8(block + 160), vld1q_u8(block + 176));
+    uint8x16_t x6 = veorq_u8(vld1q_u8(block + 192), vld1q_u8(block + 208));
+    uint8x16_t x7 = veorq_u8(vld1q_u8(block + 224), vld1q_u8(block + 240));
+    uint8x16_t final = veorq_u8(veorq_u8(veorq_u8(x0, x1), veorq_u8(x2, x3)),
+                                veorq_u8(veorq_u8(x4, x5), veorq_u8(x6, x7)));
+    vst1_u8(out, veor_u8(vget_low_u8(final), vget_high_u8(final)));
+#else
+    xor_fold_segment(block, out);
+#endif
+}
+
+// 4KB -> 128B XOR折叠
+static inline void xor_fold_4kb(const uint8_t* input, uint8_t* compressed) {
+    for (int i = 0; i < 16; i++) {
+        xor_fold_segment(input + i * 256, compressed + i * 8);
+    }
+}
+
+// 128B折叠结果 -> SM3状态（2次压缩）
+static inline void sm3_hash_compressed(const uint8_t* compressed, uint32_t* state) {
+    uint32_t sm3_block[16];
+    memcpy(state, SM3_IV, sizeof(SM3_IV));
+    
+    for (int blk = 0; blk < 2; blk++) {
+        const uint8_t* src = compressed + blk * 64;
+        for (int i = 0; i < 16; i++) {
+            uint32_t w;
+            memcpy(&w, src + i * 4, 4);
+            sm3_block[i] = __builtin_bswap32(w);
+        }
+        sm3_compress_hw(state, sm3_block);
+    }
+}
+
+// 按大端字节序输出前words个状态字（8 = 256位，4 = 128位）
+static inline void sm3_store_state(const uint32_t* state, uint8_t* output, int words) {
+    for (int i = 0; i < words; i++) {
+        uint32_t w = __builtin_bswap32(state[i]);
+        memcpy(output + i * 4, &w, 4);
+    }
+}
+
+#define AES_SM3_MB_LANES 8
+
+// 8路多缓冲SM3压缩，逐路结果与sm3_compress_hw一致
+// 状态和消息字按[字][路]转置，每轮对8路做相同运算，编译器可向量化为NEON/AVX2指令
+// W的前16个字为各路消息块，其余作为消息扩展的工作区
+static inline void sm3_compress_x8(uint32_t state[8][AES_SM3_MB_LANES],
+                                   uint32_t W[68][AES_SM3_MB_LANES]) {
+    uint32_t A[AES_SM3_MB_LANES], B[AES_SM3_MB_LANES];
+    uint32_t C[AES_SM3_MB_LANES], D[AES_SM3_MB_LANES];
+    uint32_t E[AES_SM3_MB_LANES], F[AES_SM3_MB_LANES];
+    uint32_t G[AES_SM3_MB_LANES], H[AES_SM3_MB_LANES];
+    
+    for (int j = 16; j < 68; j++) {
+        for (int l = 0; l < AES_SM3_MB_LANES; l++) {
+            uint32_t x = W[j-16][l] ^ W[j-9][l] ^ ((W[j-3][l] << 15) | (W[j-3][l] >> 17));
+            W[j][l] = P1(x) ^ ((W[j-13][l] << 7) | (W[j-13][l] >> 25)) ^ W[j-6][l];
+        }
+    }
+    
+    for (int l = 0; l < AES_SM3_MB_LANES; l++) {
+        A[l] = state[0][l]; B[l] = state[1][l]; C[l] = state[2][l]; D[l] = state[3][l];
+        E[l] = state[4][l]; F[l] = state[5][l]; G[l] = state[6][l]; H[l] = state[7][l];
+    }
+    
+    for (int j = 0; j < 16; j++) {
+        uint32_t T = SM3_Tj[j] << (j % 32);
+        for (int l = 0; l < AES_SM3_MB_LANES; l++) {
+            uint32_t rot_a = (A[l] << 12) | (A[l] >> 20);
+            uint32_t SS1 = rot_a + E[l] + T;
+            SS1 = (SS1 << 7) | (SS1 >> 25);
+            uint32_t SS2 = SS1 ^ rot_a;
+            uint32_t TT1 = (A[l] ^ B[l] ^ C[l]) + D[l] + SS2 + (W[j][l] ^ W[j+4][l]);
+            uint32_t TT2 = (E[l] ^ F[l] ^ G[l]) + H[l] + SS1 + W[j][l];
+            D[l] = C[l]; C[l] = (B[l] << 9) | (B[l] >> 23); B[l] = A[l]; A[l] = TT1;
+            H[l] = G[l]; G[l] = (F[l] << 19) | (F[l] >> 13); F[l] = E[l]; E[l] = P0(TT2);
+        }
+    }
+    for (int j = 16; j < 64; j++) {
+        uint32_t T = SM3_Tj[j] << (j % 32);
+        for (int l = 0; l < AES_SM3_MB_LANES; l++) {
+            uint32_t rot_a = (A[l] << 12) | (A[l] >> 20);
+            uint32_t SS1 = rot_a + E[l] + T;
+            SS1 = (SS1 << 7) | (SS1 >> 25);
+            uint32_t SS2 = SS1 ^ rot_a;
+            uint32_t TT1 = ((A[l] & B[l]) | (A[l] & C[l]) | (B[l] & C[l])) + D[l] + SS2 +
+                           (W[j][l] ^ W[j+4][l]);
+            uint32_t TT2 = ((E[l] & F[l]) | (~E[l] & G[l])) + H[l] + SS1 + W[j][l];
+            D[l] = C[l]; C[l] = (B[l] << 9) | (B[l] >> 23); B[l] = A[l]; A[l] = TT1;
+            H[l] = G[l]; G[l] = (F[l] << 19) | (F[l] >> 13); F[l] = E[l]; E[l] = P0(TT2);
+        }
+    }
+    
+    for (int l = 0; l < AES_SM3_MB_LANES; l++) {
+        state[0][l] ^= A[l]; state[1][l] ^= B[l]; state[2][l] ^= C[l]; state[3][l] ^= D[l];
+        state[4][l] ^= E[l]; state[5][l] ^= F[l]; state[6][l] ^= G[l]; state[7][l] ^= H[l];
+    }
+}
+
+// 128位输出版本：只输出前4个状态字，不经过256位暂存
 void aes_sm3_integrity_128bit(const uint8_t* input, uint8_t* output) {
-    uint8_t full_hash[32];
-    aes_sm3_integrity_256bit(input, full_hash);
+    uint8_t compressed[128] __attribute__((aligned(64)));
+    uint32_t state[8];
+    STAT_KERNEL(AES_SM3_KERNEL_256BIT, 1);
+    xor_fold_4kb(input, compressed);
+    sm3_hash_compressed(compressed, state);
+    sm3_store_state(state, output, 4);
+}
+
+// 复制+哈希融合：把4KB页从src复制到dst，同一遍读取中完成折叠和SM3
+// 适用于把页从慢速存储的映射/暂存区装入缓存等场景，避免对数据的第二次遍历
+void aes_sm3_copy_integrity_256bit(uint8_t* dst, const uint8_t* src, uint8_t* output) {
+    uint8_t compressed[128] __attribute__((aligned(64)));
+    uint32_t state[8];
+    STAT_KERNEL(AES_SM3_KERNEL_COPY, 1);
+    
+    for (int i = 0; i < 16; i++) {
+        const uint8_t* s = src + i * 256;
+        uint8_t* d = dst + i * 256;
+#if defined(__ARM_FEATURE_CRYPTO) && defined(__aarch64__)
+        uint8x16_t acc = vdupq_n_u8(0);
+        for (int k = 0; k < 256; k += 64) {
+            uint8x16_t v0 = vld1q_u8(s + k);
+            uint8x16_t v1 = vld1q_u8(s + k + 16);
+            uint8x16_t v2 = vld1q_u8(s + k + 32);
+            uint8x16_t v3 = vld1q_u8(s + k + 48);
+            vst1q_u8(d + k, v0);
+            vst1q_u8(d + k + 16, v1);
+            vst1q_u8(d + k + 32, v2);
+            vst1q_u8(d + k + 48, v3);
+            acc = veorq_u8(acc, veorq_u8(veorq_u8(v0, v1), veorq_u8(v2, v3)));
+        }
+        vst1_u8(compressed + i * 8, vget_low_u8(acc));
+#else
+        uint64_t acc0 = 0, acc1 = 0;
+        for (int k = 0; k < 256; k += 16) {
+            uint64_t w0, w1;
+            memcpy(&w0, s + k, 8);
+            memcpy(&w1, s + k + 8, 8);
+            memcpy(d + k, &w0, 8);
+            memcpy(d + k + 8, &w1, 8);
+            acc0 ^= w0;
+            acc1 ^= w1;
+        }
+        uint64_t folded = acc0 ^ acc1;
+        memcpy(compressed + i * 8, &folded, 8);
+#endif
+    }
     
-    // 截取前128位
-    memcpy(output, full_hash, 16);
+    sm3_hash_compressed(compressed, state);
+    sm3_store_state(state, output, 8);
 }
 
 // ============================================================================
@@ -752,6 +1203,7 @@ void aes_sm3_integrity_128bit(const uint8_t* input, uint8_t* output) {
 
 // 极限优化版本 v3.0 - 单SM3块处理（64:1压缩比）
 void aes_sm3_integrity_256bit_extreme(const uint8_t* input, uint8_t* output) {
+    STAT_KERNEL(AES_SM3_KERNEL_EXTREME, 1);
     // 极限优化策略：4KB -> 64B -> 256bit
     // 只需1个SM3块！（从64次减少到1次，64倍减少！）
     
@@ -861,6 +1313,7 @@ void aes_sm3_integrity_256bit_extreme(const uint8_t* input, uint8_t* output) {
 // 极限优化版本 v3.1 - 完全展开的单SM3块处理
 // 进一步减少内存访问和循环开销
 void aes_sm3_integrity_256bit_ultra(const uint8_t* input, uint8_t* output) {
+    STAT_KERNEL(AES_SM3_KERNEL_ULTRA, 1);
     // 超极限优化策略：直接在寄存器中完成大部分计算
     // 4KB -> 64B -> 256bit，只需1个SM3块
     
@@ -994,6 +1447,7 @@ void aes_sm3_integrity_256bit_ultra(const uint8_t* input, uint8_t* output) {
 // 极限优化版本 v4.0 - Mega优化（完全展开循环+寄存器优化）
 // 进一步减少内存访问，完全在寄存器中完成XOR折叠
 void aes_sm3_integrity_256bit_mega(const uint8_t* input, uint8_t* output) {
+    STAT_KERNEL(AES_SM3_KERNEL_MEGA, 1);
     // Mega优化策略：
     // 1. 完全展开XOR折叠循环（4096字节 -> 64字节）
     // 2. 最大化寄存器使用，减少内存访问
@@ -1143,6 +1597,7 @@ void aes_sm3_integrity_256bit_mega(const uint8_t* input, uint8_t* output) {
 // 极限优化版本 v5.0 - Super优化（完全内联SM3+零拷贝）
 // 使用完全展开的SM3压缩函数，达到理论性能极限
 void aes_sm3_integrity_256bit_super(const uint8_t* input, uint8_t* output) {
+    STAT_KERNEL(AES_SM3_KERNEL_SUPER, 1);
     // Super优化策略：
     // 1. 使用完全内联展开的SM3压缩函数（无循环开销）
     // 2. 零拷贝XOR折叠（直接在SIMD寄存器中完成）
@@ -1289,6 +1744,7 @@ void aes_sm3_integrity_256bit_hyper(const uint8_t* input, uint8_t* output) {
     // 3. 智能预取：提前8个缓存行预取
     // 4. 零分支处理：完全无条件执行
     // 5. 完全内联展开的SM3（64轮）
+    STAT_KERNEL(AES_SM3_KERNEL_HYPER, 1);
     
     uint32_t sm3_state[8] __attribute__((aligned(64)));
     memcpy(sm3_state, SM3_IV, sizeof(SM3_IV));
@@ -1472,6 +1928,115 @@ void aes_sm3_integrity_256bit_hyper(const uint8_t* input, uint8_t* output) {
 #endif
 }
 
+// ============================================================================
+// 自动调优缓存（批处理分块大小）
+// ============================================================================
+/*
+ * 每个批处理族记录一个分块页数：大批次按分块执行，使折叠后的128B中间结果
+ * 留在L1/L2。分块大小由批大小扫描基准找到吞吐拐点后写入，可保存为文本
+ * 文件（每行"族名 页数"）；设置环境变量 AES_SM3_AUTOTUNE_CACHE 时，
+ * 第一次使用分块大小时从该文件载入。
+ */
+
+#define AES_SM3_TUNE_BATCH             0
+#define AES_SM3_TUNE_NO_PREFETCH       1
+#define AES_SM3_TUNE_SUPER_PREFETCH    2
+#define AES_SM3_TUNE_PIPELINE_PREFETCH 3
+#define AES_SM3_TUNE_FAMILIES          4
+
+#define AES_SM3_TILE_DEFAULT 64
+#define AES_SM3_TILE_MAX 4096
+
+static const char* const autotune_family_names[AES_SM3_TUNE_FAMILIES] = {
+    "batch", "no_prefetch", "super_prefetch", "pipeline_prefetch"
+};
+
+static atomic_int g_tile_pages[AES_SM3_TUNE_FAMILIES];
+static pthread_once_t g_autotune_once = PTHREAD_ONCE_INIT;
+
+static int autotune_load_file(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        return -1;
+    }
+    char name[32];
+    int pages;
+    int loaded = 0;
+    while (fscanf(f, "%31s %d", name, &pages) == 2) {
+        for (int family = 0; family < AES_SM3_TUNE_FAMILIES; family++) {
+            if (strcmp(name, autotune_family_names[family]) == 0 &&
+                pages >= 1 && pages <= AES_SM3_TILE_MAX) {
+                atomic_store_explicit(&g_tile_pages[family], pages, memory_order_relaxed);
+                loaded++;
+            }
+        }
+    }
+    fclose(f);
+    return loaded;
+}
+
+static void autotune_init_once(void) {
+    for (int family = 0; family < AES_SM3_TUNE_FAMILIES; family++) {
+        atomic_init(&g_tile_pages[family], AES_SM3_TILE_DEFAULT);
+    }
+    const char* path = getenv("AES_SM3_AUTOTUNE_CACHE");
+    if (path != NULL && path[0] != '\0') {
+        autotune_load_file(path);
+    }
+}
+
+int aes_sm3_autotune_tile(int family) {
+    pthread_once(&g_autotune_once, autotune_init_once);
+    if (family < 0 || family >= AES_SM3_TUNE_FAMILIES) {
+        return AES_SM3_TILE_DEFAULT;
+    }
+    return atomic_load_explicit(&g_tile_pages[family], memory_order_relaxed);
+}
+
+void aes_sm3_autotune_set_tile(int family, int pages) {
+    pthread_once(&g_autotune_once, autotune_init_once);
+    if (family < 0 || family >= AES_SM3_TUNE_FAMILIES) {
+        return;
+    }
+    if (pages < 1) {
+        pages = 1;
+    }
+    if (pages > AES_SM3_TILE_MAX) {
+        pages = AES_SM3_TILE_MAX;
+    }
+    atomic_store_explicit(&g_tile_pages[family], pages, memory_order_relaxed);
+}
+
+// 载入缓存文件，返回载入的条目数，文件不可读返回-1
+int aes_sm3_autotune_load(const char* path) {
+    pthread_once(&g_autotune_once, autotune_init_once);
+    return autotune_load_file(path);
+}
+
+// 先写临时文件再rename，并发读取者不会看到半个文件
+int aes_sm3_autotune_save(const char* path) {
+    char tmp_path[4096];
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >= (int)sizeof(tmp_path)) {
+        return -1;
+    }
+    FILE* f = fopen(tmp_path, "w");
+    if (f == NULL) {
+        return -1;
+    }
+    for (int family = 0; family < AES_SM3_TUNE_FAMILIES; family++) {
+        fprintf(f, "%s %d\n", autotune_family_names[family], aes_sm3_autotune_tile(family));
+    }
+    int ok = !ferror(f);
+    ok &= fclose(f) == 0;
+    if (ok && rename(tmp_path, path) != 0) {
+        ok = 0;
+    }
+    if (!ok) {
+        unlink(tmp_path);
+    }
+    return ok ? 0 : -1;
+}
+
 // ============================================================================
 // 批处理+流水线优化版本（一次处理多个4KB块）
 // ============================================================================
@@ -1683,7 +2248,9 @@ static void batch_xor_folding_compress(const uint8_t** inputs, uint8_t** outputs
 }
 
 // 批处理SM3哈希函数（一次处理多个压缩数据）- 内存访问优化版本
-static void batch_sm3_hash(const uint8_t** compressed_inputs, uint8_t** outputs, int batch_size) {
+// words为每个输出写入的状态字数（8 = 256位，4 = 128位）
+static void batch_sm3_hash_words(const uint8_t** compressed_inputs, uint8_t** outputs, int batch_size,
+                                 int words) {
     // 初始化SM3状态（批处理版本）- 缓存友好的数据布局
     // 使用数组结构体（AoS）转结构体数组（SoA）优化，提高缓存局部性
     uint32_t sm3_states[8][batch_size];  // 转置存储，提高缓存行利用率
@@ -1807,7 +2374,7 @@ static void batch_sm3_hash(const uint8_t** compressed_inputs, uint8_t** outputs,
     
     // 批量输出结果 - 优化内存访问模式
     // 按列访问，提高缓存局部性
-    for (int j = 0; j < 8; j++) {
+    for (int j = 0; j < words; j++) {
         for (int i = 0; i < batch_size; i++) {
             uint32_t* out32 = (uint32_t*)outputs[i];
             out32[j] = __builtin_bswap32(sm3_states[j][i]);
@@ -1815,8 +2382,29 @@ static void batch_sm3_hash(const uint8_t** compressed_inputs, uint8_t** outputs,
     }
 }
 
-// 批处理版本的主函数（一次处理多个4KB块）- 内存访问优化版本
-void aes_sm3_integrity_batch(const uint8_t** inputs, uint8_t** outputs, int batch_size) {
+static inline void batch_sm3_hash(const uint8_t** compressed_inputs, uint8_t** outputs, int batch_size) {
+    batch_sm3_hash_words(compressed_inputs, outputs, batch_size, 8);
+}
+
+// 128位紧密输出（16字节步长）：按组构造指向输出数组的指针，内核只写前4个状态字
+#define AES_SM3_PACKED_GROUP 64
+
+typedef void (*batch_words_fn)(const uint8_t** inputs, uint8_t** outputs, int batch_size, int words);
+
+static void batch_packed_128(batch_words_fn fn, const uint8_t** inputs, uint8_t* output, int batch_size) {
+    uint8_t* outputs[AES_SM3_PACKED_GROUP];
+    for (int base = 0; base < batch_size; base += AES_SM3_PACKED_GROUP) {
+        int n = batch_size - base < AES_SM3_PACKED_GROUP ? batch_size - base : AES_SM3_PACKED_GROUP;
+        for (int i = 0; i < n; i++) {
+            outputs[i] = output + (size_t)(base + i) * 16;
+        }
+        fn(inputs + base, outputs, n, 4);
+    }
+}
+
+// 处理一个分块：折叠与SM3两个阶段
+static void integrity_batch_tile_words(const uint8_t** inputs, uint8_t** outputs, int batch_size,
+                                       int words) {
     // 分配临时存储空间（批处理版本）- 内存对齐优化
     // 使用连续内存块，减少内存碎片和缓存未命中
     uint8_t* temp_pool = (uint8_t*)aligned_alloc(64, batch_size * 128);  // 64字节对齐
@@ -1833,68 +2421,402 @@ void aes_sm3_integrity_batch(const uint8_t** inputs, uint8_t** outputs, int batc
     }
     
     // 第一阶段：批处理XOR折叠压缩（4KB -> 128B）
+    TRACE_BEGIN(fold_start);
     batch_xor_folding_compress(inputs, compressed_data, batch_size);
+    TRACE_END(fold_start, "fold", batch_size);
     
     // 预取压缩后的数据到缓存
     for (int i = 0; i < batch_size; i++) {
         __builtin_prefetch(compressed_data[i], 0, 3);  // 预取128字节压缩数据
     }
     
-    // 第二阶段：批处理SM3哈希（128B -> 256bit）
-    batch_sm3_hash((const uint8_t**)compressed_data, outputs, batch_size);
+    // 第二阶段：批处理SM3哈希（128B -> 256bit/128bit）
+    TRACE_BEGIN(sm3_start);
+    batch_sm3_hash_words((const uint8_t**)compressed_data, outputs, batch_size, words);
+    TRACE_END(sm3_start, "sm3", batch_size);
     
     // 释放临时缓冲区（一次性释放，减少系统调用开销）
     free(temp_pool);
 }
 
+static void integrity_batch_tile(const uint8_t** inputs, uint8_t** outputs, int batch_size) {
+    integrity_batch_tile_words(inputs, outputs, batch_size, 8);
+}
+
+// 批处理版本的主函数（一次处理多个4KB块）- 内存访问优化版本
+// 超过自动调优分块大小的批次按分块执行，压缩中间结果不会溢出缓存
+void aes_sm3_integrity_batch(const uint8_t** inputs, uint8_t** outputs, int batch_size) {
+    STAT_KERNEL(AES_SM3_KERNEL_BATCH, batch_size);
+    STAT_BATCH(batch_size);
+    USDT_PROBE2(batch_start, AES_SM3_KERNEL_BATCH, batch_size);
+    USDT_CYCLES_BEGIN(usdt_start, batch_end);
+    
+    int tile = aes_sm3_autotune_tile(AES_SM3_TUNE_BATCH);
+    for (int base = 0; base < batch_size; base += tile) {
+        int n = batch_size - base < tile ? batch_size - base : tile;
+        integrity_batch_tile(inputs + base, outputs + base, n);
+    }
+    
+    USDT_PROBE3(batch_end, AES_SM3_KERNEL_BATCH, batch_size, USDT_CYCLES_SINCE(usdt_start));
+}
+
+// 128位输出的批处理版本，摘要以16字节步长紧密写入output
+void aes_sm3_integrity_batch_128bit(const uint8_t** inputs, uint8_t* output, int batch_size) {
+    STAT_KERNEL(AES_SM3_KERNEL_BATCH, batch_size);
+    STAT_BATCH(batch_size);
+    USDT_PROBE2(batch_start, AES_SM3_KERNEL_BATCH, batch_size);
+    USDT_CYCLES_BEGIN(usdt_start, batch_end);
+    
+    int tile = aes_sm3_autotune_tile(AES_SM3_TUNE_BATCH);
+    for (int base = 0; base < batch_size; base += tile) {
+        int n = batch_size - base < tile ? batch_size - base : tile;
+        uint8_t* outputs[n];
+        for (int i = 0; i < n; i++) {
+            outputs[i] = output + (size_t)(base + i) * 16;
+        }
+        integrity_batch_tile_words(inputs + base, outputs, n, 4);
+    }
+    
+    USDT_PROBE3(batch_end, AES_SM3_KERNEL_BATCH, batch_size, USDT_CYCLES_SINCE(usdt_start));
+}
+
 // ============================================================================
-// SHA256实现（用于性能对比）
+// 大页面尺寸特化（8KB / 16KB / 64KB）
 // ============================================================================
+/*
+ * 16KB/64KB基础页的ARM内核和8KB/16KB的数据库页：仍折叠为16组、每组8字节，
+ * 只是每组的段长随页长放大（页长/16），因此任何页长都只需2次SM3压缩，
+ * 而不是按多个独立的4KB摘要计算。段长为编译期常量，每种页长各自展开
+ * 一份折叠循环；页长取4096时与aes_sm3_integrity_256bit结果一致。
+ */
 
-static const uint32_t SHA256_K[64] = {
-    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
-    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
-    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
-    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
-    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
-    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
-    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
-    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
-};
+#define AES_SM3_PAGE_8K  8192
+#define AES_SM3_PAGE_16K 16384
+#define AES_SM3_PAGE_64K 65536
+#define AES_SM3_SIZED_GROUP 16  // 批处理每组的页数（折叠结果共2KB，留在L1中）
 
-static inline uint32_t rotr(uint32_t x, int n) {
-    return (x >> n) | (x << (32 - n));
+// 一段（页长/16字节）-> 8字节，segment=256时与xor_fold_segment一致；
+// 更长的段在NEON路径上把高8字节并入低8字节，覆盖段内全部字节（与软件路径结果相同）
+static inline __attribute__((always_inline))
+void xor_fold_segment_sized(const uint8_t* block, uint8_t* out, size_t segment) {
+#if defined(__ARM_FEATURE_CRYPTO) && defined(__aarch64__)
+    uint8x16_t a0 = vdupq_n_u8(0), a1 = vdupq_n_u8(0);
+    uint8x16_t a2 = vdupq_n_u8(0), a3 = vdupq_n_u8(0);
+    for (size_t k = 0; k < segment; k += 64) {
+        a0 = veorq_u8(a0, vld1q_u8(block + k));
+        a1 = veorq_u8(a1, vld1q_u8(block + k + 16));
+        a2 = veorq_u8(a2, vld1q_u8(block + k + 32));
+        a3 = veorq_u8(a3, vld1q_u8(block + k + 48));
+    }
+    uint8x16_t final = veorq_u8(veorq_u8(a0, a1), veorq_u8(a2, a3));
+    if (segment > 256) {
+        vst1_u8(out, veor_u8(vget_low_u8(final), vget_high_u8(final)));
+    } else {
+        vst1_u8(out, vget_low_u8(final));
+    }
+#else
+    uint64_t acc0 = 0, acc1 = 0, acc2 = 0, acc3 = 0;
+    for (size_t k = 0; k < segment; k += 32) {
+        uint64_t w0, w1, w2, w3;
+        memcpy(&w0, block + k, 8);
+        memcpy(&w1, block + k + 8, 8);
+        memcpy(&w2, block + k + 16, 8);
+        memcpy(&w3, block + k + 24, 8);
+        acc0 ^= w0; acc1 ^= w1; acc2 ^= w2; acc3 ^= w3;
+    }
+    uint64_t folded = acc0 ^ acc1 ^ acc2 ^ acc3;
+    memcpy(out, &folded, 8);
+#endif
 }
 
-static inline uint32_t ch(uint32_t x, uint32_t y, uint32_t z) {
-    return (x & y) ^ (~x & z);
+static inline __attribute__((always_inline))
+void xor_fold_sized(const uint8_t* input, uint8_t* compressed, size_t page_size) {
+    for (int i = 0; i < 16; i++) {
+        xor_fold_segment_sized(input + i * (page_size / 16), compressed + i * 8, page_size / 16);
+    }
 }
 
-static inline uint32_t maj(uint32_t x, uint32_t y, uint32_t z) {
-    return (x & y) ^ (x & z) ^ (y & z);
+static inline __attribute__((always_inline))
+void integrity_sized(const uint8_t* input, uint8_t* output, size_t page_size, int words) {
+    uint8_t compressed[128] __attribute__((aligned(64)));
+    uint32_t state[8];
+    STAT_KERNEL(AES_SM3_KERNEL_LARGE, page_size / 4096);
+    xor_fold_sized(input, compressed, page_size);
+    sm3_hash_compressed(compressed, state);
+    sm3_store_state(state, output, words);
 }
 
-static inline uint32_t sigma0(uint32_t x) {
-    return rotr(x, 2) ^ rotr(x, 13) ^ rotr(x, 22);
+// 按组折叠（组内逐页预取下一页），每组走一次批处理SM3阶段
+static inline __attribute__((always_inline))
+void integrity_batch_sized(const uint8_t** inputs, uint8_t** outputs, int batch_size, size_t page_size,
+                           int words) {
+    uint8_t compressed[AES_SM3_SIZED_GROUP * 128] __attribute__((aligned(64)));
+    uint8_t* compressed_ptrs[AES_SM3_SIZED_GROUP];
+    
+    for (int base = 0; base < batch_size; base += AES_SM3_SIZED_GROUP) {
+        int n = batch_size - base < AES_SM3_SIZED_GROUP ? batch_size - base : AES_SM3_SIZED_GROUP;
+        TRACE_BEGIN(fold_start);
+        for (int i = 0; i < n; i++) {
+            if (base + i + 1 < batch_size) {
+                __builtin_prefetch(inputs[base + i + 1], 0, 3);
+            }
+            compressed_ptrs[i] = compressed + i * 128;
+            xor_fold_sized(inputs[base + i], compressed_ptrs[i], page_size);
+        }
+        TRACE_END(fold_start, "fold", n);
+        TRACE_BEGIN(sm3_start);
+        batch_sm3_hash_words((const uint8_t**)compressed_ptrs, outputs + base, n, words);
+        TRACE_END(sm3_start, "sm3", n);
+    }
 }
 
-static inline uint32_t sigma1(uint32_t x) {
-    return rotr(x, 6) ^ rotr(x, 11) ^ rotr(x, 25);
+#define AES_SM3_DEFINE_PAGE_SIZE(suffix, size) \
+    void aes_sm3_integrity_##suffix##_256bit(const uint8_t* input, uint8_t* output) { \
+        integrity_sized(input, output, (size), 8); \
+    } \
+    void aes_sm3_integrity_##suffix##_128bit(const uint8_t* input, uint8_t* output) { \
+        integrity_sized(input, output, (size), 4); \
+    } \
+    void aes_sm3_integrity_batch_##suffix(const uint8_t** inputs, uint8_t** outputs, int batch_size) { \
+        STAT_KERNEL(AES_SM3_KERNEL_LARGE, (unsigned long long)batch_size * ((size) / 4096)); \
+        STAT_BATCH(batch_size); \
+        integrity_batch_sized(inputs, outputs, batch_size, (size), 8); \
+    } \
+    static void integrity_batch_##suffix##_words(const uint8_t** inputs, uint8_t** outputs, \
+                                                 int batch_size, int words) { \
+        integrity_batch_sized(inputs, outputs, batch_size, (size), words); \
+    } \
+    void aes_sm3_integrity_batch_##suffix##_128bit(const uint8_t** inputs, uint8_t* output, int batch_size) { \
+        STAT_KERNEL(AES_SM3_KERNEL_LARGE, (unsigned long long)batch_size * ((size) / 4096)); \
+        STAT_BATCH(batch_size); \
+        batch_packed_128(integrity_batch_##suffix##_words, inputs, output, batch_size); \
+    }
+
+AES_SM3_DEFINE_PAGE_SIZE(8k, AES_SM3_PAGE_8K)
+AES_SM3_DEFINE_PAGE_SIZE(16k, AES_SM3_PAGE_16K)
+AES_SM3_DEFINE_PAGE_SIZE(64k, AES_SM3_PAGE_64K)
+
+typedef void (*page_hash_fn)(const uint8_t* input, uint8_t* output);
+
+// 按页长和输出位数选择单页函数，不支持的页长返回NULL
+static page_hash_fn page_hash_for_size(int page_size, int output_size) {
+    switch (page_size) {
+        case 4096:
+            return output_size == 256 ? aes_sm3_integrity_256bit : aes_sm3_integrity_128bit;
+        case AES_SM3_PAGE_8K:
+            return output_size == 256 ? aes_sm3_integrity_8k_256bit : aes_sm3_integrity_8k_128bit;
+        case AES_SM3_PAGE_16K:
+            return output_size == 256 ? aes_sm3_integrity_16k_256bit : aes_sm3_integrity_16k_128bit;
+        case AES_SM3_PAGE_64K:
+            return output_size == 256 ? aes_sm3_integrity_64k_256bit : aes_sm3_integrity_64k_128bit;
+        default:
+            return NULL;
+    }
 }
 
-static inline uint32_t gamma0(uint32_t x) {
-    return rotr(x, 7) ^ rotr(x, 18) ^ (x >> 3);
+// ============================================================================
+// 混合长度批处理（尾页与逐项长度）
+// ============================================================================
+/*
+ * 文件末尾很少落在4KB边界上。每项给出自己的长度：不超过4096字节的项
+ * 按补零到4KB计算（与补零后调用aes_sm3_integrity_256bit一致），更长的项
+ * 按能容纳它的最小特化页长（8KB/16KB/64KB）补零计算。折叠只读取项内的
+ * 字节，缺失部分按零处理，不需要复制；SM3阶段每8项走一次8路多缓冲压缩。
+ */
+
+#define AES_SM3_MIXED_MAX_LENGTH AES_SM3_PAGE_64K
+
+// 项长度对应的页长，超过64KB返回0
+static inline size_t mixed_page_size(size_t length) {
+    if (length <= 4096) return 4096;
+    if (length <= AES_SM3_PAGE_8K) return AES_SM3_PAGE_8K;
+    if (length <= AES_SM3_PAGE_16K) return AES_SM3_PAGE_16K;
+    if (length <= AES_SM3_PAGE_64K) return AES_SM3_PAGE_64K;
+    return 0;
 }
 
-static inline uint32_t gamma1(uint32_t x) {
-    return rotr(x, 17) ^ rotr(x, 19) ^ (x >> 10);
+// 只覆盖前length字节的段折叠（其余按零），与补零后用xor_fold_segment_sized整段折叠一致
+static inline void xor_fold_segment_partial(const uint8_t* block, size_t length, size_t segment,
+                                            uint8_t* out) {
+#if defined(__ARM_FEATURE_CRYPTO) && defined(__aarch64__)
+    // 256字节的段整段折叠只保留每个16字节向量的低8字节；更长的段覆盖全部字节，同软件路径
+    if (segment <= 256) {
+        uint8x16_t acc = vdupq_n_u8(0);
+        size_t k = 0;
+        for (; k + 16 <= length; k += 16) {
+            acc = veorq_u8(acc, vld1q_u8(block + k));
+        }
+        vst1_u8(out, vget_low_u8(acc));
+        for (; k < length; k++) {
+            if ((k & 15) < 8) {
+                out[k & 15] ^= block[k];
+            }
+        }
+        return;
+    }
+#else
+    (void)segment;
+#endif
+    uint64_t acc = 0;
+    size_t k = 0;
+    for (; k + 8 <= length; k += 8) {
+        uint64_t w;
+        memcpy(&w, block + k, 8);
+        acc ^= w;
+    }
+    memcpy(out, &acc, 8);
+    for (; k < length; k++) {
+        out[k & 7] ^= block[k];
+    }
 }
 
-// SHA256硬件加速版本（使用ARMv8 SHA2指令集）
-#if (defined(__ARM_FEATURE_SHA2) || defined(__aarch64__)) && defined(__aarch64__)
-static void sha256_compress(uint32_t* state, const uint8_t* block) {
-    // 使用ARMv8 SHA2硬件指令
-    uint32x4_t STATE0, STATE1, ABEF_SAVE, CDGH_SAVE;
+// 折叠一项：整页走特化折叠，不足一页的只处理覆盖到的段
+static void xor_fold_mixed(const uint8_t* input, size_t length, size_t page_size, uint8_t* compressed) {
+    if (length == page_size) {
+        switch (page_size) {
+            case 4096: xor_fold_4kb(input, compressed); return;
+            case AES_SM3_PAGE_8K: xor_fold_sized(input, compressed, AES_SM3_PAGE_8K); return;
+            case AES_SM3_PAGE_16K: xor_fold_sized(input, compressed, AES_SM3_PAGE_16K); return;
+            default: xor_fold_sized(input, compressed, AES_SM3_PAGE_64K); return;
+        }
+    }
+    
+    size_t segment = page_size / 16;
+    for (int i = 0; i < 16; i++) {
+        size_t offset = i * segment;
+        uint8_t* out = compressed + i * 8;
+        if (offset >= length) {
+            memset(out, 0, 8);
+        } else if (offset + segment <= length) {
+            xor_fold_segment_sized(input + offset, out, segment);
+        } else {
+            xor_fold_segment_partial(input + offset, length - offset, segment, out);
+        }
+    }
+}
+
+// outputs非NULL时第i项写入outputs[i]，否则以16字节步长写入packed
+// 存在超过64KB的项时返回-1且不写任何输出
+static int integrity_batch_mixed(const uint8_t** inputs, const size_t* lengths, uint8_t** outputs,
+                                 uint8_t* packed, int batch_size, int words) {
+    for (int i = 0; i < batch_size; i++) {
+        if (mixed_page_size(lengths[i]) == 0) {
+            return -1;
+        }
+    }
+    STAT_KERNEL(AES_SM3_KERNEL_BATCH, batch_size);
+    STAT_BATCH(batch_size);
+    USDT_PROBE2(batch_start, AES_SM3_KERNEL_BATCH, batch_size);
+    USDT_CYCLES_BEGIN(usdt_start, batch_end);
+    
+    uint8_t compressed[AES_SM3_MB_LANES][128] __attribute__((aligned(64)));
+    uint32_t state[8][AES_SM3_MB_LANES];
+    uint32_t W[68][AES_SM3_MB_LANES];
+    for (int base = 0; base < batch_size; base += AES_SM3_MB_LANES) {
+        int n = batch_size - base < AES_SM3_MB_LANES ? batch_size - base : AES_SM3_MB_LANES;
+        
+        TRACE_BEGIN(fold_start);
+        for (int l = 0; l < AES_SM3_MB_LANES; l++) {
+            if (l < n) {
+                if (base + l + 1 < batch_size) {
+                    __builtin_prefetch(inputs[base + l + 1], 0, 3);
+                }
+                size_t length = lengths[base + l];
+                xor_fold_mixed(inputs[base + l], length, mixed_page_size(length), compressed[l]);
+            } else {
+                memset(compressed[l], 0, 128);
+            }
+            for (int i = 0; i < 8; i++) {
+                state[i][l] = SM3_IV[i];
+            }
+        }
+        TRACE_END(fold_start, "fold", n);
+        
+        TRACE_BEGIN(sm3_start);
+        for (int blk = 0; blk < 2; blk++) {
+            for (int l = 0; l < AES_SM3_MB_LANES; l++) {
+                for (int i = 0; i < 16; i++) {
+                    uint32_t w;
+                    memcpy(&w, compressed[l] + blk * 64 + i * 4, 4);
+                    W[i][l] = __builtin_bswap32(w);
+                }
+            }
+            sm3_compress_x8(state, W);
+        }
+        for (int l = 0; l < n; l++) {
+            uint8_t* out = outputs ? outputs[base + l] : packed + (size_t)(base + l) * 16;
+            for (int i = 0; i < words; i++) {
+                uint32_t w = __builtin_bswap32(state[i][l]);
+                memcpy(out + i * 4, &w, 4);
+            }
+        }
+        TRACE_END(sm3_start, "sm3", n);
+    }
+    
+    USDT_PROBE3(batch_end, AES_SM3_KERNEL_BATCH, batch_size, USDT_CYCLES_SINCE(usdt_start));
+    return 0;
+}
+
+// 每项输出256位摘要到outputs[i]
+int aes_sm3_integrity_batch_mixed(const uint8_t** inputs, const size_t* lengths, uint8_t** outputs,
+                                  int batch_size) {
+    return integrity_batch_mixed(inputs, lengths, outputs, NULL, batch_size, 8);
+}
+
+// 每项输出128位摘要，以16字节步长紧密写入output
+int aes_sm3_integrity_batch_mixed_128bit(const uint8_t** inputs, const size_t* lengths, uint8_t* output,
+                                         int batch_size) {
+    return integrity_batch_mixed(inputs, lengths, NULL, output, batch_size, 4);
+}
+
+// ============================================================================
+// SHA256实现（用于性能对比）
+// ============================================================================
+
+static const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline uint32_t rotr(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+static inline uint32_t ch(uint32_t x, uint32_t y, uint32_t z) {
+    return (x & y) ^ (~x & z);
+}
+
+static inline uint32_t maj(uint32_t x, uint32_t y, uint32_t z) {
+    return (x & y) ^ (x & z) ^ (y & z);
+}
+
+static inline uint32_t sigma0(uint32_t x) {
+    return rotr(x, 2) ^ rotr(x, 13) ^ rotr(x, 22);
+}
+
+static inline uint32_t sigma1(uint32_t x) {
+    return rotr(x, 6) ^ rotr(x, 11) ^ rotr(x, 25);
+}
+
+static inline uint32_t gamma0(uint32_t x) {
+    return rotr(x, 7) ^ rotr(x, 18) ^ (x >> 3);
+}
+
+static inline uint32_t gamma1(uint32_t x) {
+    return rotr(x, 17) ^ rotr(x, 19) ^ (x >> 10);
+}
+
+// SHA256硬件加速版本（使用ARMv8 SHA2指令集）
+#if (defined(__ARM_FEATURE_SHA2) || defined(__aarch64__)) && defined(__aarch64__)
+static void sha256_compress(uint32_t* state, const uint8_t* block) {
+    // 使用ARMv8 SHA2硬件指令
+    uint32x4_t STATE0, STATE1, ABEF_SAVE, CDGH_SAVE;
     uint32x4_t MSG0, MSG1, MSG2, MSG3;
     uint32x4_t TMP0, TMP1, TMP2;
     
@@ -1996,150 +2918,6391 @@ static void sha256_compress(uint32_t* state, const uint8_t* block) {
     vst1q_u32(&state[0], STATE0);
     vst1q_u32(&state[4], STATE1);
 }
-#else
-// 如果不支持SHA2硬件指令，编译时报错
-#error "SHA2硬件加速不可用！请使用 -march=armv8.2-a+crypto+sha2 编译选项，或在支持SHA2指令的ARM平台上编译。"
-#endif
+#else
+// 如果不支持SHA2硬件指令，编译时报错
+#error "SHA2硬件加速不可用！请使用 -march=armv8.2-a+crypto+sha2 编译选项，或在支持SHA2指令的ARM平台上编译。"
+#endif
+
+void sha256_4kb(const uint8_t* input, uint8_t* output) {
+    uint32_t state[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    
+    // 循环展开：每次处理4个块
+    for (int i = 0; i < 64; i += 4) {
+        sha256_compress(state, input + i * 64);
+        sha256_compress(state, input + (i+1) * 64);
+        sha256_compress(state, input + (i+2) * 64);
+        sha256_compress(state, input + (i+3) * 64);
+    }
+    
+    // 直接输出（减少循环）
+    uint32_t* out32 = (uint32_t*)output;
+    out32[0] = __builtin_bswap32(state[0]);
+    out32[1] = __builtin_bswap32(state[1]);
+    out32[2] = __builtin_bswap32(state[2]);
+    out32[3] = __builtin_bswap32(state[3]);
+    out32[4] = __builtin_bswap32(state[4]);
+    out32[5] = __builtin_bswap32(state[5]);
+    out32[6] = __builtin_bswap32(state[6]);
+    out32[7] = __builtin_bswap32(state[7]);
+}
+
+// ============================================================================
+// 纯SM3实现（用于对比）
+// ============================================================================
+
+void sm3_4kb(const uint8_t* input, uint8_t* output) {
+    uint32_t state[8];
+    memcpy(state, SM3_IV, sizeof(SM3_IV));
+    
+    // 循环展开：每次处理2个块
+    for (int i = 0; i < 64; i += 2) {
+        uint32_t block[16];
+        
+        // 第一个块
+        const uint32_t* src = (const uint32_t*)(input + i * 64);
+        for (int j = 0; j < 16; j++) {
+            block[j] = __builtin_bswap32(src[j]);
+        }
+        sm3_compress_hw(state, block);
+        
+        // 第二个块
+        src = (const uint32_t*)(input + (i+1) * 64);
+        for (int j = 0; j < 16; j++) {
+            block[j] = __builtin_bswap32(src[j]);
+        }
+        sm3_compress_hw(state, block);
+    }
+    
+    // 直接输出（减少循环）
+    uint32_t* out32 = (uint32_t*)output;
+    out32[0] = __builtin_bswap32(state[0]);
+    out32[1] = __builtin_bswap32(state[1]);
+    out32[2] = __builtin_bswap32(state[2]);
+    out32[3] = __builtin_bswap32(state[3]);
+    out32[4] = __builtin_bswap32(state[4]);
+    out32[5] = __builtin_bswap32(state[5]);
+    out32[6] = __builtin_bswap32(state[6]);
+    out32[7] = __builtin_bswap32(state[7]);
+}
+
+// ============================================================================
+// 无锁有界MPMC任务队列（并行引擎提交路径）
+// ============================================================================
+/*
+ * Vyukov风格的有界多生产者多消费者环形队列：
+ * - 每个槽位带序列号，生产者/消费者只通过CAS推进各自的位置，无互斥锁
+ * - 入队/出队位置、休眠计数分别独占缓存行，避免伪共享
+ * - 支持批量入队/出队：一次CAS预留连续多个槽位
+ * - 消费者两种等待模式：纯自旋（低延迟）和自旋后阻塞（省CPU）
+ * - 任务完成通过每个任务组的原子计数器通知，替代pthread_barrier_wait
+ */
+
+#define AES_SM3_JOB_PAGES 64          // 每个任务最多包含的4KB页数
+#define AES_SM3_QUEUE_SPIN_LIMIT 256  // 阻塞模式下进入休眠前的自旋次数
+
+#define HASH_QUEUE_SPIN  0  // 消费者自旋等待
+#define HASH_QUEUE_BLOCK 1  // 消费者自旋后阻塞等待
+
+#if defined(__aarch64__)
+#define cpu_relax() __asm__ __volatile__("yield" ::: "memory")
+#elif defined(__x86_64__) || defined(__i386__)
+#define cpu_relax() __builtin_ia32_pause()
+#else
+#define cpu_relax() __asm__ __volatile__("" ::: "memory")
+#endif
+
+// 任务完成计数器：提交时增加，任务执行完毕后减少
+typedef struct aes_sm3_completion {
+    atomic_int pending;
+} __attribute__((aligned(AES_SM3_CACHE_LINE))) aes_sm3_completion_t;
+
+// 哈希任务：一段连续的页及其摘要输出位置
+typedef struct {
+    const uint8_t* input;
+    uint8_t* output;
+    int page_count;
+    int page_size;    // 4096或特化的大页面尺寸
+    int output_size;  // 128 or 256
+    void (*hash)(const uint8_t* input, uint8_t* output);  // 非NULL时替代按页长选择的单页函数
+    aes_sm3_completion_t* completion;
+#if AES_SM3_STATS
+    uint64_t enqueue_ns;  // 入队时间，用于排队等待直方图
+#endif
+} aes_sm3_job_t;
+
+typedef struct {
+    atomic_size_t sequence;
+    aes_sm3_job_t job;
+} __attribute__((aligned(AES_SM3_CACHE_LINE))) hash_queue_cell_t;
+
+typedef struct {
+    hash_queue_cell_t* cells;
+    size_t mask;
+    int wait_mode;
+    
+    // 生产者、消费者和休眠状态分别独占缓存行
+    atomic_size_t enqueue_pos __attribute__((aligned(AES_SM3_CACHE_LINE)));
+    atomic_size_t dequeue_pos __attribute__((aligned(AES_SM3_CACHE_LINE)));
+    atomic_int sleepers __attribute__((aligned(AES_SM3_CACHE_LINE)));
+    atomic_int shutdown;
+    pthread_mutex_t sleep_lock;
+    pthread_cond_t sleep_cond;
+} hash_queue_t;
+
+static int hash_queue_init(hash_queue_t* q, size_t capacity, int wait_mode) {
+    size_t size = 2;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    
+    q->cells = (hash_queue_cell_t*)aligned_alloc(AES_SM3_CACHE_LINE, size * sizeof(hash_queue_cell_t));
+    if (q->cells == NULL) {
+        return -1;
+    }
+    for (size_t i = 0; i < size; i++) {
+        atomic_init(&q->cells[i].sequence, i);
+    }
+    
+    q->mask = size - 1;
+    q->wait_mode = wait_mode;
+    atomic_init(&q->enqueue_pos, 0);
+    atomic_init(&q->dequeue_pos, 0);
+    atomic_init(&q->sleepers, 0);
+    atomic_init(&q->shutdown, 0);
+    pthread_mutex_init(&q->sleep_lock, NULL);
+    pthread_cond_init(&q->sleep_cond, NULL);
+    return 0;
+}
+
+static void hash_queue_destroy(hash_queue_t* q) {
+    pthread_mutex_destroy(&q->sleep_lock);
+    pthread_cond_destroy(&q->sleep_cond);
+    free(q->cells);
+    q->cells = NULL;
+}
+
+// 唤醒阻塞的消费者（只有存在休眠者时才进入互斥锁）
+static void hash_queue_wake(hash_queue_t* q, int all) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&q->sleepers, memory_order_relaxed) > 0) {
+        pthread_mutex_lock(&q->sleep_lock);
+        if (all) {
+            pthread_cond_broadcast(&q->sleep_cond);
+        } else {
+            pthread_cond_signal(&q->sleep_cond);
+        }
+        pthread_mutex_unlock(&q->sleep_lock);
+    }
+}
+
+// 批量入队：一次CAS预留连续槽位，返回实际入队数量（队列满时为0）
+static int hash_queue_enqueue_batch(hash_queue_t* q, const aes_sm3_job_t* jobs, int count) {
+    size_t pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+    int reserved;
+    
+    for (;;) {
+        // 统计从pos开始连续空闲的槽位
+        reserved = 0;
+        while (reserved < count) {
+            hash_queue_cell_t* cell = &q->cells[(pos + reserved) & q->mask];
+            size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+            if (seq != pos + reserved) {
+                break;
+            }
+            reserved++;
+        }
+        
+        if (reserved == 0) {
+            hash_queue_cell_t* cell = &q->cells[pos & q->mask];
+            size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+            if ((intptr_t)(seq - pos) < 0) {
+                return 0;  // 队列已满
+            }
+            pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+            continue;
+        }
+        
+        if (atomic_compare_exchange_weak_explicit(&q->enqueue_pos, &pos, pos + reserved,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+            break;
+        }
+    }
+    
+    for (int i = 0; i < reserved; i++) {
+        hash_queue_cell_t* cell = &q->cells[(pos + i) & q->mask];
+        cell->job = jobs[i];
+        atomic_store_explicit(&cell->sequence, pos + i + 1, memory_order_release);
+    }
+    
+    if (q->wait_mode == HASH_QUEUE_BLOCK) {
+        hash_queue_wake(q, reserved > 1);
+    }
+    return reserved;
+}
+
+// 批量出队：返回实际出队数量（队列空时为0）
+static int hash_queue_dequeue_batch(hash_queue_t* q, aes_sm3_job_t* jobs, int max_count) {
+    size_t pos = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+    int reserved;
+    
+    for (;;) {
+        reserved = 0;
+        while (reserved < max_count) {
+            hash_queue_cell_t* cell = &q->cells[(pos + reserved) & q->mask];
+            size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+            if (seq != pos + reserved + 1) {
+                break;
+            }
+            reserved++;
+        }
+        
+        if (reserved == 0) {
+            hash_queue_cell_t* cell = &q->cells[pos & q->mask];
+            size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+            if ((intptr_t)(seq - (pos + 1)) < 0) {
+                return 0;  // 队列为空
+            }
+            pos = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+            continue;
+        }
+        
+        if (atomic_compare_exchange_weak_explicit(&q->dequeue_pos, &pos, pos + reserved,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+            break;
+        }
+    }
+    
+    for (int i = 0; i < reserved; i++) {
+        hash_queue_cell_t* cell = &q->cells[(pos + i) & q->mask];
+        jobs[i] = cell->job;
+        atomic_store_explicit(&cell->sequence, pos + i + q->mask + 1, memory_order_release);
+    }
+    return reserved;
+}
+
+// 消费者等待出队：按等待模式自旋或阻塞，队列关闭且为空时返回0
+// gate非空时仅当consumer_id < *gate才出队，否则返回-1（由调用方挂起，等待中同样检查）
+static int hash_queue_wait_dequeue(hash_queue_t* q, aes_sm3_job_t* jobs, int max_count,
+                                   const atomic_int* gate, int consumer_id) {
+    int spins = 0;
+    
+    for (;;) {
+        if (gate != NULL && consumer_id >= atomic_load_explicit(gate, memory_order_acquire)) {
+            return -1;
+        }
+        int n = hash_queue_dequeue_batch(q, jobs, max_count);
+        if (n > 0) {
+            return n;
+        }
+        if (atomic_load_explicit(&q->shutdown, memory_order_acquire)) {
+            return 0;
+        }
+        
+        if (q->wait_mode == HASH_QUEUE_SPIN || ++spins < AES_SM3_QUEUE_SPIN_LIMIT) {
+            cpu_relax();
+            if (q->wait_mode == HASH_QUEUE_SPIN && (++spins & 1023) == 0) {
+                sched_yield();
+            }
+            continue;
+        }
+        
+        // 阻塞模式：登记休眠后再次检查，避免丢失唤醒
+        pthread_mutex_lock(&q->sleep_lock);
+        atomic_fetch_add_explicit(&q->sleepers, 1, memory_order_seq_cst);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (gate != NULL && consumer_id >= atomic_load_explicit(gate, memory_order_acquire)) {
+            n = -1;
+        } else {
+            n = hash_queue_dequeue_batch(q, jobs, max_count);
+        }
+        if (n == 0 && !atomic_load_explicit(&q->shutdown, memory_order_acquire)) {
+            pthread_cond_wait(&q->sleep_cond, &q->sleep_lock);
+        }
+        atomic_fetch_sub_explicit(&q->sleepers, 1, memory_order_relaxed);
+        pthread_mutex_unlock(&q->sleep_lock);
+        
+        if (n != 0) {
+            return n;
+        }
+        spins = 0;
+    }
+}
+
+static void hash_queue_shutdown(hash_queue_t* q) {
+    atomic_store_explicit(&q->shutdown, 1, memory_order_release);
+    pthread_mutex_lock(&q->sleep_lock);
+    pthread_cond_broadcast(&q->sleep_cond);
+    pthread_mutex_unlock(&q->sleep_lock);
+}
+
+// 执行单个哈希任务并递减所属任务组的完成计数
+static void aes_sm3_job_execute(const aes_sm3_job_t* job) {
+    int digest_size = job->output_size / 8;
+    page_hash_fn hash = job->hash != NULL ? job->hash : page_hash_for_size(job->page_size, job->output_size);
+    
+    for (int i = 0; i < job->page_count; i++) {
+        const uint8_t* block_start = job->input + (size_t)i * job->page_size;
+        uint8_t* output_start = job->output + (size_t)i * digest_size;
+        hash(block_start, output_start);
+    }
+    
+    atomic_fetch_sub_explicit(&job->completion->pending, 1, memory_order_release);
+}
+
+aes_sm3_completion_t* aes_sm3_completion_create(void) {
+    aes_sm3_completion_t* completion = aligned_alloc(AES_SM3_CACHE_LINE, sizeof(aes_sm3_completion_t));
+    if (completion != NULL) {
+        atomic_init(&completion->pending, 0);
+    }
+    return completion;
+}
+
+void aes_sm3_completion_destroy(aes_sm3_completion_t* completion) {
+    free(completion);
+}
+
+// 等待任务组全部完成（自旋后让出CPU）
+void aes_sm3_completion_wait(aes_sm3_completion_t* completion) {
+    int spins = 0;
+    while (atomic_load_explicit(&completion->pending, memory_order_acquire) > 0) {
+        if (++spins < AES_SM3_QUEUE_SPIN_LIMIT) {
+            cpu_relax();
+        } else {
+            sched_yield();
+        }
+    }
+}
+
+// ============================================================================
+// 大页缓冲区与2MB边界分块
+// ============================================================================
+/*
+ * 多GB缓冲区若由4KB页映射，硬件预取在每个页边界停止，dTLB缺失也随数据量
+ * 线性增长。分配辅助函数依次尝试：MAP_HUGETLB显式大页 -> 2MB对齐映射 +
+ * MADV_HUGEPAGE透明大页 -> 普通页。调度器切分任务时不让单个任务跨越2MB
+ * 边界，使每个任务只触及一个大页（一个TLB项）。
+ */
+
+#define AES_SM3_HUGE_PAGE_SIZE (2UL * 1024 * 1024)
+#define AES_SM3_HUGE_PAGE_PAGES 512
+
+#define AES_SM3_BUFFER_NORMAL 0
+#define AES_SM3_BUFFER_THP 1
+#define AES_SM3_BUFFER_HUGETLB 2
+
+static inline size_t huge_page_round_up(size_t size) {
+    return (size + AES_SM3_HUGE_PAGE_SIZE - 1) & ~(AES_SM3_HUGE_PAGE_SIZE - 1);
+}
+
+// 从p开始到下一个2MB边界的完整4KB页数（至少为1）
+static inline int pages_to_huge_boundary(const uint8_t* p) {
+    size_t offset = (uintptr_t)p & (AES_SM3_HUGE_PAGE_SIZE - 1);
+    int pages = (int)((AES_SM3_HUGE_PAGE_SIZE - offset) / 4096);
+    return pages > 0 ? pages : 1;
+}
+
+// 把页下标page调整到最近的2MB边界（相对于input地址）
+static inline int huge_boundary_round(const uint8_t* input, int page) {
+    int head = pages_to_huge_boundary(input) % AES_SM3_HUGE_PAGE_PAGES;
+    if (page <= head) {
+        return page;
+    }
+    int rel = page - head + AES_SM3_HUGE_PAGE_PAGES / 2;
+    return head + rel / AES_SM3_HUGE_PAGE_PAGES * AES_SM3_HUGE_PAGE_PAGES;
+}
+
+// 分配按2MB取整的缓冲区，kind（可为NULL）输出实际采用的页类型
+void* aes_sm3_buffer_alloc(size_t size, int* kind) {
+    size_t length = huge_page_round_up(size);
+    
+#if defined(MAP_HUGETLB)
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+#if defined(MAP_HUGE_SHIFT)
+    flags |= 21 << MAP_HUGE_SHIFT;
+#endif
+    void* huge = mmap(NULL, length, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (huge != MAP_FAILED) {
+        if (kind) *kind = AES_SM3_BUFFER_HUGETLB;
+        return huge;
+    }
+#endif
+    
+    // 多映射2MB后裁掉首尾，得到2MB对齐的区域，透明大页才能整块使用
+    uint8_t* raw = mmap(NULL, length + AES_SM3_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        return NULL;
+    }
+    uint8_t* aligned = (uint8_t*)huge_page_round_up((uintptr_t)raw);
+    size_t head = aligned - raw;
+    size_t tail = AES_SM3_HUGE_PAGE_SIZE - head;
+    if (head > 0) {
+        munmap(raw, head);
+    }
+    if (tail > 0) {
+        munmap(aligned + length, tail);
+    }
+    
+    int used = AES_SM3_BUFFER_NORMAL;
+#if defined(MADV_HUGEPAGE)
+    if (madvise(aligned, length, MADV_HUGEPAGE) == 0) {
+        used = AES_SM3_BUFFER_THP;
+    }
+#endif
+    if (kind) *kind = used;
+    return aligned;
+}
+
+void aes_sm3_buffer_free(void* buffer, size_t size) {
+    if (buffer != NULL) {
+        munmap(buffer, huge_page_round_up(size));
+    }
+}
+
+// ============================================================================
+// 异构核心拓扑（big.LITTLE / 混合算力CPU）
+// ============================================================================
+/*
+ * 从sysfs读取每个CPU的相对算力：
+ * - /sys/devices/system/cpu/cpuN/cpu_capacity（内核归一化到1024）
+ * - 缺失时退化为 cpufreq/cpuinfo_max_freq 相对最大频率的比例
+ * - 再按 scaling_max_freq / cpuinfo_max_freq 折算频率上限
+ * 也可通过环境变量 AES_SM3_TOPOLOGY 或 aes_sm3_topology_create 注入合成拓扑，
+ * 格式为逗号分隔的 "算力" 或 "数量*算力"，CPU编号依次分配，例如 "4*1024,4*446"；
+ * 绑核时不在本进程可用CPU集合内的编号按序号映射到可用CPU上。
+ * 拓扑按算力从高到低排序，工作线程依此顺序绑核，使低并发时只占用大核。
+ */
+
+#define AES_SM3_MAX_CPUS 256
+#define AES_SM3_CAPACITY_SCALE 1024
+#define AES_SM3_STEAL_PAGES 16  // 异构分区中每次领取/窃取的页数
+
+typedef struct aes_sm3_topology {
+    int cpu_count;
+    int cpu_ids[AES_SM3_MAX_CPUS];    // 按算力降序排列
+    int capacity[AES_SM3_MAX_CPUS];   // 与cpu_ids一一对应，最大值归一化为1024
+} aes_sm3_topology_t;
+
+static long read_sysfs_long(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        return -1;
+    }
+    long value = -1;
+    if (fscanf(f, "%ld", &value) != 1) {
+        value = -1;
+    }
+    fclose(f);
+    return value;
+}
+
+// 按算力降序稳定排序并归一化
+static void topology_finalize(aes_sm3_topology_t* topo) {
+    for (int i = 1; i < topo->cpu_count; i++) {
+        int cpu = topo->cpu_ids[i];
+        int cap = topo->capacity[i];
+        int j = i - 1;
+        while (j >= 0 && topo->capacity[j] < cap) {
+            topo->cpu_ids[j + 1] = topo->cpu_ids[j];
+            topo->capacity[j + 1] = topo->capacity[j];
+            j--;
+        }
+        topo->cpu_ids[j + 1] = cpu;
+        topo->capacity[j + 1] = cap;
+    }
+    
+    int max_cap = topo->cpu_count > 0 ? topo->capacity[0] : 0;
+    for (int i = 0; i < topo->cpu_count; i++) {
+        if (max_cap <= 0 || topo->capacity[i] <= 0) {
+            topo->capacity[i] = AES_SM3_CAPACITY_SCALE;
+        } else {
+            topo->capacity[i] = (int)((long)topo->capacity[i] * AES_SM3_CAPACITY_SCALE / max_cap);
+            if (topo->capacity[i] < 1) {
+                topo->capacity[i] = 1;
+            }
+        }
+    }
+}
+
+// 解析合成拓扑描述，成功返回0
+static int topology_parse(aes_sm3_topology_t* topo, const char* desc) {
+    topo->cpu_count = 0;
+    const char* p = desc;
+    
+    while (*p != '\0') {
+        char* end;
+        long first = strtol(p, &end, 10);
+        if (end == p || first <= 0) {
+            return -1;
+        }
+        long count = 1, cap = first;
+        if (*end == '*') {
+            p = end + 1;
+            count = first;
+            cap = strtol(p, &end, 10);
+            if (end == p || cap <= 0) {
+                return -1;
+            }
+        }
+        for (long i = 0; i < count; i++) {
+            if (topo->cpu_count >= AES_SM3_MAX_CPUS) {
+                return -1;
+            }
+            topo->cpu_ids[topo->cpu_count] = topo->cpu_count;
+            topo->capacity[topo->cpu_count] = (int)cap;
+            topo->cpu_count++;
+        }
+        p = end;
+        if (*p == ',') {
+            p++;
+        } else if (*p != '\0') {
+            return -1;
+        }
+    }
+    
+    if (topo->cpu_count == 0) {
+        return -1;
+    }
+    topology_finalize(topo);
+    return 0;
+}
+
+// 从sysfs探测当前可用CPU的算力（同构或无sysfs时所有CPU算力相同）
+static int topology_detect(aes_sm3_topology_t* topo) {
+    const char* synthetic = getenv("AES_SM3_TOPOLOGY");
+    if (synthetic != NULL && topology_parse(topo, synthetic) == 0) {
+        return 0;
+    }
+    
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        int online = sysconf(_SC_NPROCESSORS_ONLN);
+        for (int i = 0; i < online && i < CPU_SETSIZE; i++) {
+            CPU_SET(i, &allowed);
+        }
+    }
+    
+    long max_freq_all = 0;
+    long max_freq[AES_SM3_MAX_CPUS];
+    long freq_limit[AES_SM3_MAX_CPUS];
+    long sysfs_cap[AES_SM3_MAX_CPUS];
+    char path[128];
+    
+    topo->cpu_count = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE && topo->cpu_count < AES_SM3_MAX_CPUS; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed)) {
+            continue;
+        }
+        int idx = topo->cpu_count++;
+        topo->cpu_ids[idx] = cpu;
+        
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpu_capacity", cpu);
+        sysfs_cap[idx] = read_sysfs_long(path);
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", cpu);
+        max_freq[idx] = read_sysfs_long(path);
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_max_freq", cpu);
+        freq_limit[idx] = read_sysfs_long(path);
+        if (max_freq[idx] > max_freq_all) {
+            max_freq_all = max_freq[idx];
+        }
+    }
+    
+    for (int i = 0; i < topo->cpu_count; i++) {
+        long cap = sysfs_cap[i];
+        if (cap <= 0) {
+            cap = (max_freq[i] > 0 && max_freq_all > 0)
+                ? max_freq[i] * AES_SM3_CAPACITY_SCALE / max_freq_all
+                : AES_SM3_CAPACITY_SCALE;
+        }
+        // 频率上限（热限制/节能策略）按比例折算
+        if (max_freq[i] > 0 && freq_limit[i] > 0 && freq_limit[i] < max_freq[i]) {
+            cap = cap * freq_limit[i] / max_freq[i];
+        }
+        topo->capacity[i] = (int)cap;
+    }
+    
+    topology_finalize(topo);
+    return topo->cpu_count > 0 ? 0 : -1;
+}
+
+// desc为NULL时从sysfs探测，否则解析合成拓扑描述；描述非法时返回NULL
+aes_sm3_topology_t* aes_sm3_topology_create(const char* desc) {
+    aes_sm3_topology_t* topo = malloc(sizeof(aes_sm3_topology_t));
+    if (topo == NULL) {
+        return NULL;
+    }
+    int ret = (desc != NULL) ? topology_parse(topo, desc) : topology_detect(topo);
+    if (ret != 0) {
+        free(topo);
+        return NULL;
+    }
+    return topo;
+}
+
+void aes_sm3_topology_destroy(aes_sm3_topology_t* topo) {
+    free(topo);
+}
+
+static aes_sm3_topology_t g_topology;
+static pthread_once_t g_topology_once = PTHREAD_ONCE_INIT;
+
+static void topology_init_once(void) {
+    if (topology_detect(&g_topology) != 0) {
+        g_topology.cpu_count = 1;
+        g_topology.cpu_ids[0] = 0;
+        g_topology.capacity[0] = AES_SM3_CAPACITY_SCALE;
+    }
+}
+
+// 进程内缓存的探测结果
+const aes_sm3_topology_t* aes_sm3_topology_get(void) {
+    pthread_once(&g_topology_once, topology_init_once);
+    return &g_topology;
+}
+
+int aes_sm3_topology_is_heterogeneous(const aes_sm3_topology_t* topo) {
+    return topo->cpu_count > 1 && topo->capacity[topo->cpu_count - 1] < topo->capacity[0];
+}
+
+// 最高算力核心的数量（延迟敏感的单页任务应只用这些核心）
+int aes_sm3_topology_big_cores(const aes_sm3_topology_t* topo) {
+    int count = 0;
+    while (count < topo->cpu_count && topo->capacity[count] == topo->capacity[0]) {
+        count++;
+    }
+    return count;
+}
+
+// 第thread_id个工作线程绑定的CPU（大核优先）
+int aes_sm3_topology_cpu_for_thread(const aes_sm3_topology_t* topo, int thread_id) {
+    return topo->cpu_ids[thread_id % topo->cpu_count];
+}
+
+// 把拓扑中的CPU编号映射到进程可用CPU集合（合成拓扑的编号可能不存在）
+static int topology_usable_cpu(const cpu_set_t* allowed, int cpu) {
+    int count = CPU_COUNT(allowed);
+    if (count == 0 || (cpu >= 0 && cpu < CPU_SETSIZE && CPU_ISSET(cpu, allowed))) {
+        return cpu;
+    }
+    int index = cpu % count;
+    for (int i = 0; i < CPU_SETSIZE; i++) {
+        if (CPU_ISSET(i, allowed) && index-- == 0) {
+            return i;
+        }
+    }
+    return cpu;
+}
+
+// 把当前线程绑定到拓扑中的一组CPU（映射到可用集合后）
+static void topology_pin_current(const int* cpus, int count) {
+    cpu_set_t allowed, cpuset;
+    CPU_ZERO(&allowed);
+    CPU_ZERO(&cpuset);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    for (int i = 0; i < count; i++) {
+        CPU_SET(topology_usable_cpu(&allowed, cpus[i]) % CPU_SETSIZE, &cpuset);
+    }
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+}
+
+// 延迟敏感的单页校验：异构平台上临时迁移到大核计算，完成后恢复原亲和性
+void aes_sm3_integrity_big_core(const uint8_t* input, uint8_t* output, int output_size) {
+    const aes_sm3_topology_t* topo = aes_sm3_topology_get();
+    cpu_set_t saved;
+    int migrate = aes_sm3_topology_is_heterogeneous(topo) &&
+                  pthread_getaffinity_np(pthread_self(), sizeof(saved), &saved) == 0;
+    if (migrate) {
+        int cpu = sched_getcpu();
+        for (int i = 0; i < aes_sm3_topology_big_cores(topo); i++) {
+            if (topo->cpu_ids[i] == cpu) {
+                migrate = 0;  // 已在大核上
+                break;
+            }
+        }
+    }
+    if (migrate) {
+        topology_pin_current(topo->cpu_ids, aes_sm3_topology_big_cores(topo));
+    }
+    
+    if (output_size == 256) {
+        aes_sm3_integrity_256bit(input, output);
+    } else {
+        aes_sm3_integrity_128bit(input, output);
+    }
+    
+    if (migrate) {
+        pthread_setaffinity_np(pthread_self(), sizeof(saved), &saved);
+    }
+}
+
+// 按算力加权切分页区间：线程i处理 [bounds[i], bounds[i+1])
+void aes_sm3_topology_partition(const aes_sm3_topology_t* topo, int block_count,
+                                int num_threads, int* bounds) {
+    long total = 0;
+    for (int i = 0; i < num_threads; i++) {
+        total += topo->capacity[i % topo->cpu_count];
+    }
+    
+    long acc = 0;
+    bounds[0] = 0;
+    for (int i = 0; i < num_threads; i++) {
+        acc += topo->capacity[i % topo->cpu_count];
+        bounds[i + 1] = (int)((long long)block_count * acc / total);
+    }
+    bounds[num_threads] = block_count;
+}
+
+// 无法创建引擎或线程时在调用线程上逐页计算
+static void parallel_fallback(const uint8_t* input, uint8_t* output, int page_count, int page_size,
+                              int output_size) {
+    page_hash_fn hash = page_hash_for_size(page_size, output_size);
+    int digest_size = output_size / 8;
+    for (int i = 0; i < page_count; i++) {
+        hash(input + (size_t)i * page_size, output + (size_t)i * digest_size);
+    }
+}
+
+// 异构并行：按算力加权的初始分区 + 领完自己分区后窃取他人剩余页
+typedef struct {
+    atomic_int next;
+    int end;
+} __attribute__((aligned(AES_SM3_CACHE_LINE))) hetero_partition_t;
+
+typedef struct {
+    hetero_partition_t* partitions;
+    const uint8_t* input;
+    uint8_t* output;
+    int num_threads;
+    int thread_id;
+    int cpu;
+    int output_size;
+#if AES_SM3_TRACE
+    uint64_t spawn_ns;  // 创建时间，用于thread_start区间
+#endif
+} hetero_worker_t;
+
+static int hetero_drain(hetero_partition_t* part, const hetero_worker_t* w) {
+    int digest_size = w->output_size / 8;
+    int processed = 0;
+    
+    for (;;) {
+        int start = atomic_fetch_add_explicit(&part->next, AES_SM3_STEAL_PAGES, memory_order_relaxed);
+        if (start >= part->end) {
+            return processed;
+        }
+        int stop = start + AES_SM3_STEAL_PAGES < part->end ? start + AES_SM3_STEAL_PAGES : part->end;
+        for (int i = start; i < stop; i++) {
+            const uint8_t* block_start = w->input + (size_t)i * 4096;
+            uint8_t* output_start = w->output + (size_t)i * digest_size;
+            if (w->output_size == 256) {
+                aes_sm3_integrity_256bit(block_start, output_start);
+            } else {
+                aes_sm3_integrity_128bit(block_start, output_start);
+            }
+        }
+        processed += stop - start;
+    }
+}
+
+static void* hetero_worker(void* arg) {
+    hetero_worker_t* w = (hetero_worker_t*)arg;
+    TRACE_THREAD_NAME("hetero-worker", w->thread_id);
+    
+    topology_pin_current(&w->cpu, 1);
+    TRACE_END(w->spawn_ns, "thread_start", w->thread_id);
+    
+    TRACE_BEGIN(own_start);
+    int pages = hetero_drain(&w->partitions[w->thread_id], w);
+    TRACE_END(own_start, "hash", pages);
+    
+    // 自己的分区完成后，从后续线程的分区窃取（大核先完成，替小核分担尾部）
+    TRACE_BEGIN(steal_start);
+    pages = 0;
+    for (int k = 1; k < w->num_threads; k++) {
+        pages += hetero_drain(&w->partitions[(w->thread_id + k) % w->num_threads], w);
+    }
+    TRACE_END(steal_start, "steal", pages);
+    (void)pages;
+    return NULL;
+}
+
+/*
+ * 按拓扑算力加权的初始分区只用于本接口。aes_sm3_parallel走共享队列的任务引擎，
+ * 线程按需领取任务，没有初始分区；异构平台上只把任务粒度缩小到AES_SM3_STEAL_PAGES，
+ * 由大核自然多领任务，不使用算力权重。
+ * 分配失败时在调用线程上逐页计算；部分线程创建失败时由调用线程处理剩余分区。
+ */
+void aes_sm3_parallel_topology(const aes_sm3_topology_t* topo, const uint8_t* input, uint8_t* output,
+                               int block_count, int num_threads, int output_size) {
+    if (num_threads > topo->cpu_count) {
+        num_threads = topo->cpu_count;
+    }
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+    
+    TRACE_BEGIN(partition_start);
+    int bounds[num_threads + 1];
+    aes_sm3_topology_partition(topo, block_count, num_threads, bounds);
+    // 分区足够大时把边界对齐到2MB，避免相邻线程共享大页
+    if (block_count / num_threads >= 2 * AES_SM3_HUGE_PAGE_PAGES) {
+        for (int i = 1; i < num_threads; i++) {
+            int b = huge_boundary_round(input, bounds[i]);
+            bounds[i] = b < bounds[i - 1] ? bounds[i - 1] : (b > block_count ? block_count : b);
+        }
+    }
+    
+    hetero_partition_t* partitions = aligned_alloc(AES_SM3_CACHE_LINE, num_threads * sizeof(hetero_partition_t));
+    hetero_worker_t* workers = malloc(num_threads * sizeof(hetero_worker_t));
+    pthread_t* threads = malloc(num_threads * sizeof(pthread_t));
+    if (partitions == NULL || workers == NULL || threads == NULL) {
+        free(partitions);
+        free(workers);
+        free(threads);
+        TRACE_END(partition_start, "partition", block_count);
+        parallel_fallback(input, output, block_count, 4096, output_size);
+        return;
+    }
+    
+    for (int i = 0; i < num_threads; i++) {
+        atomic_init(&partitions[i].next, bounds[i]);
+        partitions[i].end = bounds[i + 1];
+    }
+    TRACE_END(partition_start, "partition", block_count);
+    for (int i = 0; i < num_threads; i++) {
+        workers[i].partitions = partitions;
+        workers[i].input = input;
+        workers[i].output = output;
+        workers[i].num_threads = num_threads;
+        workers[i].thread_id = i;
+        workers[i].cpu = aes_sm3_topology_cpu_for_thread(topo, i);
+        workers[i].output_size = output_size;
+    }
+    int created = 0;
+    while (created < num_threads) {
+        TRACE_STAMP(workers[created].spawn_ns);
+        if (pthread_create(&threads[created], NULL, hetero_worker, &workers[created]) != 0) {
+            break;
+        }
+        created++;
+    }
+    // 未能创建的线程的分区由调用线程处理（已创建的线程也会来窃取）
+    if (created < num_threads) {
+        for (int k = 0; k < num_threads; k++) {
+            hetero_drain(&partitions[(created + k) % num_threads], &workers[created]);
+        }
+    }
+    TRACE_BEGIN(join_start);
+    for (int i = 0; i < created; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    TRACE_END(join_start, "join", num_threads);
+    
+    free(partitions);
+    free(workers);
+    free(threads);
+}
+
+// ============================================================================
+// 多线程并行处理
+// ============================================================================
+
+typedef struct aes_sm3_engine aes_sm3_engine_t;
+
+typedef struct {
+    aes_sm3_engine_t* engine;
+    int thread_id;
+    atomic_ullong pages_done;  // 仅由本线程写入，供自适应控制器采样
+#if AES_SM3_TRACE
+    uint64_t spawn_ns;  // 创建时间，用于thread_start区间
+#endif
+} __attribute__((aligned(AES_SM3_CACHE_LINE))) thread_data_t;
+
+struct aes_sm3_engine {
+    hash_queue_t queue;
+    pthread_t* threads;
+    thread_data_t* thread_data;
+    int num_threads;
+    
+    // 活跃线程上限：编号不小于该值的线程挂起，不参与出队
+    atomic_int active_threads __attribute__((aligned(AES_SM3_CACHE_LINE)));
+    pthread_mutex_t park_lock;
+    pthread_cond_t park_cond;
+};
+
+// 超出活跃上限的线程在此挂起，直到上限提高或引擎关闭
+static void engine_park_if_inactive(aes_sm3_engine_t* engine, int thread_id) {
+    if (thread_id < atomic_load_explicit(&engine->active_threads, memory_order_acquire)) {
+        return;
+    }
+    
+    pthread_mutex_lock(&engine->park_lock);
+    while (thread_id >= atomic_load_explicit(&engine->active_threads, memory_order_acquire) &&
+           !atomic_load_explicit(&engine->queue.shutdown, memory_order_acquire)) {
+        pthread_cond_wait(&engine->park_cond, &engine->park_lock);
+    }
+    pthread_mutex_unlock(&engine->park_lock);
+}
+
+// 工作线程：从共享队列批量取任务执行，直到队列关闭
+void* thread_worker(void* arg) {
+    thread_data_t* data = (thread_data_t*)arg;
+    hash_queue_t* queue = &data->engine->queue;
+    TRACE_THREAD_NAME("engine-worker", data->thread_id);
+    
+    // 设置线程亲和性（大核优先，活跃线程数受限时只占用大核）
+    int cpu = aes_sm3_topology_cpu_for_thread(aes_sm3_topology_get(), data->thread_id);
+    topology_pin_current(&cpu, 1);
+    TRACE_END(data->spawn_ns, "thread_start", data->thread_id);
+    
+    aes_sm3_job_t jobs[4];
+    unsigned long long pages_done = 0;
+    int n;
+    for (;;) {
+        engine_park_if_inactive(data->engine, data->thread_id);
+        
+        STAT_TIMESTAMP(idle_start);
+        TRACE_BEGIN(wait_start);
+        // 等待期间活跃上限被调低时返回-1，回到循环开头挂起
+        n = hash_queue_wait_dequeue(queue, jobs, 4, &data->engine->active_threads, data->thread_id);
+        TRACE_END(wait_start, "wait", n);
+        STAT_TIMESTAMP(busy_start);
+        STAT_IDLE(busy_start - idle_start);
+        if (n < 0) {
+            continue;
+        }
+        if (n == 0) {
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            STAT_JOB_WAIT(jobs[i], busy_start);
+            TRACE_BEGIN(job_start);
+            USDT_CYCLES_BEGIN(usdt_start, job_complete);
+            aes_sm3_job_execute(&jobs[i]);
+            USDT_PROBE2(job_complete, jobs[i].page_count, USDT_CYCLES_SINCE(usdt_start));
+            TRACE_END(job_start, "hash", jobs[i].page_count);
+            pages_done += jobs[i].page_count;
+        }
+        STAT_TIMESTAMP(busy_end);
+        STAT_BUSY(busy_end - busy_start);
+        atomic_store_explicit(&data->pages_done, pages_done, memory_order_relaxed);
+    }
+    
+    return NULL;
+}
+
+void aes_sm3_engine_destroy(aes_sm3_engine_t* engine);
+
+aes_sm3_engine_t* aes_sm3_engine_create(int num_threads, int queue_capacity, int wait_mode) {
+    int available_cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_threads > available_cores) {
+        num_threads = available_cores;
+    }
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+    
+    aes_sm3_engine_t* engine = malloc(sizeof(aes_sm3_engine_t));
+    if (engine == NULL) {
+        return NULL;
+    }
+    if (hash_queue_init(&engine->queue, queue_capacity, wait_mode) != 0) {
+        free(engine);
+        return NULL;
+    }
+    
+    engine->num_threads = num_threads;
+    engine->threads = malloc(num_threads * sizeof(pthread_t));
+    engine->thread_data = aligned_alloc(AES_SM3_CACHE_LINE, num_threads * sizeof(thread_data_t));
+    if (engine->threads == NULL || engine->thread_data == NULL) {
+        hash_queue_destroy(&engine->queue);
+        free(engine->threads);
+        free(engine->thread_data);
+        free(engine);
+        return NULL;
+    }
+    atomic_init(&engine->active_threads, num_threads);
+    pthread_mutex_init(&engine->park_lock, NULL);
+    pthread_cond_init(&engine->park_cond, NULL);
+    
+    for (int i = 0; i < num_threads; i++) {
+        engine->thread_data[i].engine = engine;
+        engine->thread_data[i].thread_id = i;
+        atomic_init(&engine->thread_data[i].pages_done, 0);
+        TRACE_STAMP(engine->thread_data[i].spawn_ns);
+        if (pthread_create(&engine->threads[i], NULL, thread_worker, &engine->thread_data[i]) != 0) {
+            // 只回收已创建的线程
+            engine->num_threads = i;
+            aes_sm3_engine_destroy(engine);
+            return NULL;
+        }
+    }
+    
+    return engine;
+}
+
+void aes_sm3_engine_destroy(aes_sm3_engine_t* engine) {
+    hash_queue_shutdown(&engine->queue);
+    pthread_mutex_lock(&engine->park_lock);
+    pthread_cond_broadcast(&engine->park_cond);
+    pthread_mutex_unlock(&engine->park_lock);
+    for (int i = 0; i < engine->num_threads; i++) {
+        pthread_join(engine->threads[i], NULL);
+    }
+    
+    pthread_mutex_destroy(&engine->park_lock);
+    pthread_cond_destroy(&engine->park_cond);
+    hash_queue_destroy(&engine->queue);
+    free(engine->threads);
+    free(engine->thread_data);
+    free(engine);
+}
+
+int aes_sm3_engine_max_threads(const aes_sm3_engine_t* engine) {
+    return engine->num_threads;
+}
+
+// 调整活跃工作线程数（1..num_threads），多余线程挂起而不销毁
+void aes_sm3_engine_set_active_threads(aes_sm3_engine_t* engine, int active) {
+    if (active < 1) {
+        active = 1;
+    }
+    if (active > engine->num_threads) {
+        active = engine->num_threads;
+    }
+    
+    pthread_mutex_lock(&engine->park_lock);
+    atomic_store_explicit(&engine->active_threads, active, memory_order_release);
+    pthread_cond_broadcast(&engine->park_cond);
+    pthread_mutex_unlock(&engine->park_lock);
+    
+    // 唤醒在队列上休眠的线程，使超出上限者转入挂起
+    hash_queue_wake(&engine->queue, 1);
+}
+
+// 从next_page开始的下一个任务的页数（不超过pages_per_job，不跨越2MB边界）
+static inline int engine_job_pages(const uint8_t* input, int next_page, int page_count, int page_size,
+                                   int pages_per_job) {
+    int pages = page_count - next_page;
+    if (pages > pages_per_job) {
+        pages = pages_per_job;
+    }
+    int boundary = pages_to_huge_boundary(input + (size_t)next_page * page_size) * 4096 / page_size;
+    if (boundary < 1) {
+        boundary = 1;
+    }
+    return pages > boundary ? boundary : pages;
+}
+
+// 提交连续页的哈希任务（可被多个生产者线程并发调用，无互斥锁）
+// 按pages_per_job切分（不跨越2MB边界）为任务批量入队；队列满时提交者直接执行一个任务，避免空等
+// hash为NULL时按页长和输出位数选择单页函数
+static void engine_submit_sized(aes_sm3_engine_t* engine, const uint8_t* input, uint8_t* output,
+                                int page_count, int page_size, int output_size, int pages_per_job,
+                                page_hash_fn hash, aes_sm3_completion_t* completion) {
+    if (pages_per_job < 1) {
+        pages_per_job = AES_SM3_JOB_PAGES * 4096 / page_size;
+    }
+    
+    // 先一次性登记全部任务，避免等待者在两批入队之间看到计数归零
+    int total_jobs = 0;
+    for (int p = 0; p < page_count; total_jobs++) {
+        p += engine_job_pages(input, p, page_count, page_size, pages_per_job);
+    }
+    atomic_fetch_add_explicit(&completion->pending, total_jobs, memory_order_relaxed);
+    
+    int digest_size = output_size / 8;
+    aes_sm3_job_t jobs[16];
+    int next_page = 0;
+    while (next_page < page_count) {
+        int n = 0;
+        while (n < 16 && next_page < page_count) {
+            int pages = engine_job_pages(input, next_page, page_count, page_size, pages_per_job);
+            jobs[n].input = input + (size_t)next_page * page_size;
+            jobs[n].output = output + (size_t)next_page * digest_size;
+            jobs[n].page_count = pages;
+            jobs[n].page_size = page_size;
+            jobs[n].output_size = output_size;
+            jobs[n].hash = hash;
+            jobs[n].completion = completion;
+            STAT_JOB_STAMP(jobs[n]);
+            next_page += pages;
+            n++;
+        }
+        USDT_PROBE2(job_submit, n, next_page - (int)((jobs[0].input - input) / page_size));
+        
+        int done = 0;
+        while (done < n) {
+            int pushed = hash_queue_enqueue_batch(&engine->queue, jobs + done, n - done);
+            if (pushed == 0) {
+                aes_sm3_job_t help;
+                if (hash_queue_dequeue_batch(&engine->queue, &help, 1) == 1) {
+                    aes_sm3_job_execute(&help);
+                } else {
+                    cpu_relax();
+                }
+            }
+            done += pushed;
+        }
+    }
+}
+
+void aes_sm3_engine_submit(aes_sm3_engine_t* engine, const uint8_t* input, uint8_t* output,
+                           int page_count, int output_size, int pages_per_job,
+                           aes_sm3_completion_t* completion) {
+    engine_submit_sized(engine, input, output, page_count, 4096, output_size, pages_per_job, NULL, completion);
+}
+
+void aes_sm3_parallel(const uint8_t* input, uint8_t* output, int block_count, 
+                      int num_threads, int output_size) {
+    if (block_count <= 0) {
+        return;
+    }
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+    
+    // 任务粒度：每线程约4个任务，兼顾负载均衡与出队开销
+    int pages_per_job = block_count / (num_threads * 4);
+    if (pages_per_job < 1) {
+        pages_per_job = 1;
+    }
+    if (pages_per_job > AES_SM3_JOB_PAGES) {
+        pages_per_job = AES_SM3_JOB_PAGES;
+    }
+    // 异构平台：工作线程按算力降序绑核，缩小任务粒度，使大核领取更多任务而小核不拖长尾部
+    if (aes_sm3_topology_is_heterogeneous(aes_sm3_topology_get()) && pages_per_job > AES_SM3_STEAL_PAGES) {
+        pages_per_job = AES_SM3_STEAL_PAGES;
+    }
+    // 取2的幂，使对齐输入上的任务恰好铺满每个2MB大页
+    while (pages_per_job & (pages_per_job - 1)) {
+        pages_per_job &= pages_per_job - 1;
+    }
+    
+    aes_sm3_engine_t* engine = aes_sm3_engine_create(num_threads, 1024, HASH_QUEUE_BLOCK);
+    aes_sm3_completion_t* completion = aes_sm3_completion_create();
+    if (engine == NULL || completion == NULL) {
+        if (engine != NULL) aes_sm3_engine_destroy(engine);
+        aes_sm3_completion_destroy(completion);
+        parallel_fallback(input, output, block_count, 4096, output_size);
+        return;
+    }
+    
+    TRACE_BEGIN(partition_start);
+    aes_sm3_engine_submit(engine, input, output, block_count, output_size, pages_per_job, completion);
+    TRACE_END(partition_start, "partition", block_count);
+    TRACE_BEGIN(join_start);
+    aes_sm3_completion_wait(completion);
+    TRACE_END(join_start, "join", num_threads);
+    
+    aes_sm3_completion_destroy(completion);
+    aes_sm3_engine_destroy(engine);
+}
+
+// 大页面尺寸的多线程并行：任务按页长折算，每个任务最多256KB
+static void parallel_sized(const uint8_t* input, uint8_t* output, int page_count, int page_size,
+                           int num_threads, int output_size) {
+    if (page_count <= 0) {
+        return;
+    }
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+    
+    int max_pages = AES_SM3_JOB_PAGES * 4096 / page_size;
+    int pages_per_job = page_count / (num_threads * 4);
+    if (pages_per_job < 1) {
+        pages_per_job = 1;
+    }
+    if (pages_per_job > max_pages) {
+        pages_per_job = max_pages;
+    }
+    while (pages_per_job & (pages_per_job - 1)) {
+        pages_per_job &= pages_per_job - 1;
+    }
+    
+    aes_sm3_engine_t* engine = aes_sm3_engine_create(num_threads, 1024, HASH_QUEUE_BLOCK);
+    aes_sm3_completion_t* completion = aes_sm3_completion_create();
+    if (engine == NULL || completion == NULL) {
+        if (engine != NULL) aes_sm3_engine_destroy(engine);
+        aes_sm3_completion_destroy(completion);
+        parallel_fallback(input, output, page_count, page_size, output_size);
+        return;
+    }
+    
+    TRACE_BEGIN(partition_start);
+    engine_submit_sized(engine, input, output, page_count, page_size, output_size, pages_per_job, NULL,
+                        completion);
+    TRACE_END(partition_start, "partition", page_count);
+    TRACE_BEGIN(join_start);
+    aes_sm3_completion_wait(completion);
+    TRACE_END(join_start, "join", num_threads);
+    
+    aes_sm3_completion_destroy(completion);
+    aes_sm3_engine_destroy(engine);
+}
+
+void aes_sm3_parallel_8k(const uint8_t* input, uint8_t* output, int page_count,
+                         int num_threads, int output_size) {
+    parallel_sized(input, output, page_count, AES_SM3_PAGE_8K, num_threads, output_size);
+}
+
+void aes_sm3_parallel_16k(const uint8_t* input, uint8_t* output, int page_count,
+                          int num_threads, int output_size) {
+    parallel_sized(input, output, page_count, AES_SM3_PAGE_16K, num_threads, output_size);
+}
+
+void aes_sm3_parallel_64k(const uint8_t* input, uint8_t* output, int page_count,
+                          int num_threads, int output_size) {
+    parallel_sized(input, output, page_count, AES_SM3_PAGE_64K, num_threads, output_size);
+}
+
+// ============================================================================
+// 自适应线程数控制（按吞吐饱和度伸缩活跃线程）
+// ============================================================================
+/*
+ * 超过内存带宽拐点后，继续增加线程只会占用核心而不提升吞吐。
+ * 控制器把输入切成测量窗口，每个窗口记录当前活跃线程数下的聚合吞吐
+ * 和每线程吞吐（滑动窗口平均），按以下规则爬坡：
+ * - 边际收益 = (T[n] - T[n-1]) / (T[n-1] / (n-1))，即第n个线程带来的
+ *   吞吐增量相当于平均单线程吞吐的比例
+ * - 边际收益不低于阈值时继续加线程，否则回退到n-1并进入稳定状态
+ * - 稳定状态下定期探测n+1和n-1，负载或带宽变化时重新收敛
+ */
+
+#define AES_SM3_ADAPT_WINDOWS 4           // 每个并发度保留的滑动窗口样本数
+#define AES_SM3_ADAPT_WINDOW_PAGES 512    // 每个活跃线程每窗口处理的页数
+#define AES_SM3_ADAPT_PROBE_INTERVAL 16   // 稳定状态下每隔多少窗口探测一次
+#define AES_SM3_ADAPT_DEFAULT_GAIN 0.25   // 默认边际收益阈值
+
+#define ADAPT_PHASE_GROW       0
+#define ADAPT_PHASE_STABLE     1
+#define ADAPT_PHASE_PROBE_UP   2
+#define ADAPT_PHASE_PROBE_DOWN 3
+
+typedef struct {
+    double samples[AES_SM3_ADAPT_WINDOWS];  // 聚合吞吐 MB/s
+    double worker_samples[AES_SM3_ADAPT_WINDOWS];  // 平均每线程吞吐 MB/s
+    int count;
+    int next;
+} adapt_level_t;
+
+typedef struct aes_sm3_adaptive {
+    aes_sm3_engine_t* engine;
+    aes_sm3_completion_t* completion;
+    adapt_level_t* levels;      // 下标为活跃线程数
+    int max_threads;
+    int chosen;                 // 当前选定的并发度
+    int trial;                  // 下一个窗口使用的并发度
+    int phase;
+    int windows_since_probe;
+    double gain_threshold;
+} aes_sm3_adaptive_t;
+
+static void adapt_record(adapt_level_t* level, double throughput, double per_worker) {
+    level->samples[level->next] = throughput;
+    level->worker_samples[level->next] = per_worker;
+    level->next = (level->next + 1) % AES_SM3_ADAPT_WINDOWS;
+    if (level->count < AES_SM3_ADAPT_WINDOWS) {
+        level->count++;
+    }
+}
+
+static double adapt_average(const adapt_level_t* level) {
+    double sum = 0.0;
+    for (int i = 0; i < level->count; i++) {
+        sum += level->samples[i];
+    }
+    return level->count > 0 ? sum / level->count : 0.0;
+}
+
+static double adapt_worker_average(const adapt_level_t* level) {
+    double sum = 0.0;
+    for (int i = 0; i < level->count; i++) {
+        sum += level->worker_samples[i];
+    }
+    return level->count > 0 ? sum / level->count : 0.0;
+}
+
+// 第n个线程的边际收益（以n-1时的平均单线程吞吐为单位）
+static double adapt_marginal_gain(const aes_sm3_adaptive_t* ctl, int n) {
+    double upper = adapt_average(&ctl->levels[n]);
+    double lower = adapt_average(&ctl->levels[n - 1]);
+    if (lower <= 0.0) {
+        return 1.0;
+    }
+    return (upper - lower) / (lower / (n - 1));
+}
+
+// 根据刚完成窗口的测量结果决定下一个窗口的并发度
+static void adapt_decide(aes_sm3_adaptive_t* ctl) {
+    int n = ctl->trial;
+    
+    switch (ctl->phase) {
+    case ADAPT_PHASE_GROW:
+        if (n > 1 && adapt_marginal_gain(ctl, n) < ctl->gain_threshold) {
+            ctl->chosen = n - 1;
+            ctl->phase = ADAPT_PHASE_STABLE;
+        } else if (n < ctl->max_threads) {
+            ctl->chosen = n;
+            ctl->trial = n + 1;
+            return;
+        } else {
+            ctl->chosen = n;
+            ctl->phase = ADAPT_PHASE_STABLE;
+        }
+        ctl->windows_since_probe = 0;
+        break;
+        
+    case ADAPT_PHASE_STABLE:
+        if (++ctl->windows_since_probe >= AES_SM3_ADAPT_PROBE_INTERVAL) {
+            ctl->windows_since_probe = 0;
+            if (ctl->chosen < ctl->max_threads) {
+                ctl->phase = ADAPT_PHASE_PROBE_UP;
+                ctl->trial = ctl->chosen + 1;
+                return;
+            } else if (ctl->chosen > 1) {
+                ctl->phase = ADAPT_PHASE_PROBE_DOWN;
+                ctl->trial = ctl->chosen - 1;
+                return;
+            }
+        }
+        break;
+        
+    case ADAPT_PHASE_PROBE_UP:
+        if (adapt_marginal_gain(ctl, n) >= ctl->gain_threshold) {
+            // 带宽余量出现，继续爬坡
+            ctl->chosen = n;
+            if (n < ctl->max_threads) {
+                ctl->phase = ADAPT_PHASE_GROW;
+                ctl->trial = n + 1;
+                return;
+            }
+            ctl->phase = ADAPT_PHASE_STABLE;
+            break;
+        }
+        if (ctl->chosen > 1) {
+            ctl->phase = ADAPT_PHASE_PROBE_DOWN;
+            ctl->trial = ctl->chosen - 1;
+            return;
+        }
+        ctl->phase = ADAPT_PHASE_STABLE;
+        break;
+        
+    case ADAPT_PHASE_PROBE_DOWN:
+        // 少一个线程也能达到接近峰值的带宽时收缩
+        if (adapt_marginal_gain(ctl, ctl->chosen) < ctl->gain_threshold) {
+            ctl->chosen = n;
+        }
+        ctl->phase = ADAPT_PHASE_STABLE;
+        break;
+    }
+    
+    ctl->trial = ctl->chosen;
+}
+
+aes_sm3_adaptive_t* aes_sm3_adaptive_create(int max_threads, double gain_threshold) {
+    aes_sm3_adaptive_t* ctl = malloc(sizeof(aes_sm3_adaptive_t));
+    if (ctl == NULL) {
+        return NULL;
+    }
+    
+    ctl->engine = aes_sm3_engine_create(max_threads, 1024, HASH_QUEUE_BLOCK);
+    ctl->completion = aes_sm3_completion_create();
+    if (ctl->engine == NULL || ctl->completion == NULL) {
+        if (ctl->engine != NULL) {
+            aes_sm3_engine_destroy(ctl->engine);
+        }
+        free(ctl->completion);
+        free(ctl);
+        return NULL;
+    }
+    
+    ctl->max_threads = aes_sm3_engine_max_threads(ctl->engine);
+    ctl->levels = calloc(ctl->max_threads + 1, sizeof(adapt_level_t));
+    if (ctl->levels == NULL) {
+        aes_sm3_engine_destroy(ctl->engine);
+        aes_sm3_completion_destroy(ctl->completion);
+        free(ctl);
+        return NULL;
+    }
+    ctl->chosen = 1;
+    ctl->trial = 1;
+    ctl->phase = ADAPT_PHASE_GROW;
+    ctl->windows_since_probe = 0;
+    ctl->gain_threshold = gain_threshold > 0.0 ? gain_threshold : AES_SM3_ADAPT_DEFAULT_GAIN;
+    return ctl;
+}
+
+void aes_sm3_adaptive_destroy(aes_sm3_adaptive_t* ctl) {
+    aes_sm3_engine_destroy(ctl->engine);
+    aes_sm3_completion_destroy(ctl->completion);
+    free(ctl->levels);
+    free(ctl);
+}
+
+// 当前选定的并发度（达到接近峰值带宽所需的最少线程数）
+int aes_sm3_adaptive_concurrency(const aes_sm3_adaptive_t* ctl) {
+    return ctl->chosen;
+}
+
+// 指定并发度下滑动窗口平均的聚合吞吐和每线程吞吐（MB/s），未测量时为0
+void aes_sm3_adaptive_throughput(const aes_sm3_adaptive_t* ctl, int threads,
+                                 double* total_mbps, double* per_worker_mbps) {
+    if (threads < 1 || threads > ctl->max_threads) {
+        *total_mbps = 0.0;
+        *per_worker_mbps = 0.0;
+        return;
+    }
+    *total_mbps = adapt_average(&ctl->levels[threads]);
+    *per_worker_mbps = adapt_worker_average(&ctl->levels[threads]);
+}
+
+// 自适应并行哈希：逐窗口提交，测量后调整活跃线程数
+void aes_sm3_adaptive_hash(aes_sm3_adaptive_t* ctl, const uint8_t* input, uint8_t* output,
+                           int block_count, int output_size) {
+    int digest_size = output_size / 8;
+    int offset = 0;
+    unsigned long long before[ctl->max_threads];
+    
+    while (offset < block_count) {
+        int active = ctl->trial;
+        int window = active * AES_SM3_ADAPT_WINDOW_PAGES;
+        if (window > block_count - offset) {
+            window = block_count - offset;
+        }
+        int pages_per_job = window / (active * 4);
+        if (pages_per_job < 1) {
+            pages_per_job = 1;
+        }
+        if (pages_per_job > AES_SM3_JOB_PAGES) {
+            pages_per_job = AES_SM3_JOB_PAGES;
+        }
+        
+        aes_sm3_engine_set_active_threads(ctl->engine, active);
+        for (int i = 0; i < active; i++) {
+            before[i] = atomic_load_explicit(&ctl->engine->thread_data[i].pages_done, memory_order_relaxed);
+        }
+        
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        aes_sm3_engine_submit(ctl->engine, input + (size_t)offset * 4096,
+                              output + (size_t)offset * digest_size,
+                              window, output_size, pages_per_job, ctl->completion);
+        aes_sm3_completion_wait(ctl->completion);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        
+        double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        offset += window;
+        
+        // 过短的尾部窗口测量噪声太大，不参与决策
+        if (window < active * AES_SM3_ADAPT_WINDOW_PAGES || elapsed <= 0.0) {
+            continue;
+        }
+        
+        // 每线程吞吐：只统计本窗口内真正处理过任务的线程
+        double worker_sum = 0.0;
+        int busy_workers = 0;
+        for (int i = 0; i < active; i++) {
+            unsigned long long done = atomic_load_explicit(&ctl->engine->thread_data[i].pages_done,
+                                                           memory_order_relaxed) - before[i];
+            if (done > 0) {
+                worker_sum += (done * 4.0 / 1024.0) / elapsed;
+                busy_workers++;
+            }
+        }
+        
+        double throughput = (window * 4.0 / 1024.0) / elapsed;
+        adapt_record(&ctl->levels[active], throughput,
+                     busy_workers > 0 ? worker_sum / busy_workers : throughput);
+        adapt_decide(ctl);
+        USDT_PROBE3(adapt_decision, active, ctl->trial, ctl->phase);
+    }
+}
+
+// ============================================================================
+// 基于soft-dirty的内存区域增量完整性快照
+// ============================================================================
+/*
+ * 周期性校验大块内存表时，只重算自上次快照以来被写过的页：
+ * 1. 读 /proc/self/pagemap，取每页的soft-dirty位（bit 55）
+ * 2. 向 /proc/self/clear_refs 写入"4"清除soft-dirty位（先清除再哈希，
+ *    哈希期间发生的写入会在下个周期被发现）
+ * 3. 用批处理内核重算脏页摘要，并只沿脏叶子向上更新Merkle树
+ * clear_refs是进程级操作，会清掉所有区域的soft-dirty位，因此清除前先为
+ * 所有已注册区域扫描pagemap并累积到各自的待处理位图中。
+ * 内核不支持soft-dirty（未启用CONFIG_MEM_SOFT_DIRTY或无权限）时退化为
+ * 每周期全量重算，Merkle树仍只更新摘要变化的叶子。
+ */
+
+#define PAGEMAP_SOFT_DIRTY (1ULL << 55)
+#define AES_SM3_PAGEMAP_CHUNK 512       // 每次pread读取的pagemap条目数
+#define AES_SM3_REHASH_BATCH 64         // 脏页重算的批处理大小
+#define AES_SM3_MERKLE_MAX_LEVELS 64
+
+typedef struct aes_sm3_monitor {
+    const uint8_t* base;
+    size_t page_count;                  // 4KB页数
+    uint8_t* digests;                   // 每页256位摘要（即Merkle树叶子层）
+    uint8_t* tree;                      // Merkle树内部节点（逐层连续存放）
+    size_t level_offset[AES_SM3_MERKLE_MAX_LEVELS];
+    size_t level_count[AES_SM3_MERKLE_MAX_LEVELS];
+    int levels;
+    uint64_t* pending;                  // 待重算页位图（受全局锁保护）
+    uint64_t* work;                     // 本次快照处理的页位图
+    size_t* dirty_index;
+    int initialized;                    // 已完成首次全量哈希（只由快照调用者访问）
+    int tracking;                       // 已参与过clear_refs，之后的写入需累积到pending（受全局锁保护）
+    struct aes_sm3_monitor* next;
+} aes_sm3_monitor_t;
+
+static pthread_mutex_t g_monitor_lock = PTHREAD_MUTEX_INITIALIZER;
+static aes_sm3_monitor_t* g_monitors = NULL;
+static pthread_once_t g_soft_dirty_once = PTHREAD_ONCE_INIT;
+static int g_soft_dirty_supported = 0;
+
+static int pagemap_read_soft_dirty(int fd, uintptr_t addr, int* dirty) {
+    long page_size = sysconf(_SC_PAGESIZE);
+    uint64_t entry;
+    if (pread(fd, &entry, sizeof(entry), (off_t)(addr / page_size) * sizeof(entry)) != sizeof(entry)) {
+        return -1;
+    }
+    *dirty = (entry & PAGEMAP_SOFT_DIRTY) != 0;
+    return 0;
+}
+
+static int clear_soft_dirty(void) {
+    int fd = open("/proc/self/clear_refs", O_WRONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    int ret = (write(fd, "4", 1) == 1) ? 0 : -1;
+    close(fd);
+    return ret;
+}
+
+// 探测soft-dirty是否真正可用：清除后应为0，写入后应为1
+static void soft_dirty_probe(void) {
+    long page_size = sysconf(_SC_PAGESIZE);
+    volatile uint8_t* probe = mmap(NULL, page_size, PROT_READ | PROT_WRITE,
+                                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (probe == MAP_FAILED) {
+        return;
+    }
+    
+    int fd = open("/proc/self/pagemap", O_RDONLY);
+    if (fd >= 0) {
+        int before = 1, after = 0;
+        probe[0] = 1;
+        if (clear_soft_dirty() == 0 &&
+            pagemap_read_soft_dirty(fd, (uintptr_t)probe, &before) == 0) {
+            probe[0] = 2;
+            if (pagemap_read_soft_dirty(fd, (uintptr_t)probe, &after) == 0) {
+                g_soft_dirty_supported = (before == 0 && after == 1);
+            }
+        }
+        close(fd);
+    }
+    munmap((void*)probe, page_size);
+}
+
+// 64字节消息的SM3（含填充块，Merkle父节点 = SM3(左 || 右)）
+static void sm3_hash_64bytes(const uint8_t* msg, uint8_t* output) {
+    uint32_t state[8];
+    uint32_t block[16];
+    memcpy(state, SM3_IV, sizeof(SM3_IV));
+    
+    const uint32_t* src = (const uint32_t*)msg;
+    for (int i = 0; i < 16; i++) {
+        block[i] = __builtin_bswap32(src[i]);
+    }
+    sm3_compress_hw(state, block);
+    
+    // 填充块：0x80后补零，最后64位为消息长度512
+    memset(block, 0, sizeof(block));
+    block[0] = 0x80000000;
+    block[15] = 512;
+    sm3_compress_hw(state, block);
+    
+    uint32_t* out32 = (uint32_t*)output;
+    for (int i = 0; i < 8; i++) {
+        out32[i] = __builtin_bswap32(state[i]);
+    }
+}
+
+static uint8_t* merkle_node(aes_sm3_monitor_t* m, int level, size_t index) {
+    if (level == 0) {
+        return m->digests + index * 32;
+    }
+    return m->tree + (m->level_offset[level] + index) * 32;
+}
+
+static void merkle_update_parent(aes_sm3_monitor_t* m, int level, size_t parent) {
+    size_t left = parent * 2;
+    uint8_t pair[64];
+    memcpy(pair, merkle_node(m, level - 1, left), 32);
+    if (left + 1 < m->level_count[level - 1]) {
+        memcpy(pair + 32, merkle_node(m, level - 1, left + 1), 32);
+        sm3_hash_64bytes(pair, merkle_node(m, level, parent));
+    } else {
+        // 奇数个节点时最后一个节点直接上提
+        memcpy(merkle_node(m, level, parent), pair, 32);
+    }
+}
+
+// 只沿已排序的脏叶子路径向上更新Merkle树
+static void merkle_update(aes_sm3_monitor_t* m, size_t* index, size_t count) {
+    for (int level = 1; level < m->levels && count > 0; level++) {
+        size_t unique = 0;
+        for (size_t i = 0; i < count; i++) {
+            size_t parent = index[i] >> 1;
+            if (unique == 0 || index[unique - 1] != parent) {
+                index[unique++] = parent;
+            }
+        }
+        count = unique;
+        for (size_t i = 0; i < count; i++) {
+            merkle_update_parent(m, level, index[i]);
+        }
+    }
+}
+
+// 扫描区域的pagemap，把soft-dirty页累积到待处理位图（调用者持有全局锁）
+static int monitor_scan_pagemap(aes_sm3_monitor_t* m, int fd) {
+    long page_size = sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)m->base;
+    uintptr_t end = start + m->page_count * 4096;
+    uintptr_t first = start / page_size;
+    uintptr_t last = (end - 1) / page_size;
+    uint64_t entries[AES_SM3_PAGEMAP_CHUNK];
+    
+    for (uintptr_t vpn = first; vpn <= last; vpn += AES_SM3_PAGEMAP_CHUNK) {
+        size_t n = last - vpn + 1;
+        if (n > AES_SM3_PAGEMAP_CHUNK) {
+            n = AES_SM3_PAGEMAP_CHUNK;
+        }
+        ssize_t bytes = pread(fd, entries, n * sizeof(uint64_t), (off_t)vpn * sizeof(uint64_t));
+        if (bytes != (ssize_t)(n * sizeof(uint64_t))) {
+            return -1;
+        }
+        
+        for (size_t i = 0; i < n; i++) {
+            if (!(entries[i] & PAGEMAP_SOFT_DIRTY)) {
+                continue;
+            }
+            // 系统页可能大于4KB（16KB/64KB内核），标记其覆盖的所有4KB页
+            uintptr_t page_start = (vpn + i) * page_size;
+            uintptr_t lo = page_start > start ? page_start : start;
+            uintptr_t hi = page_start + page_size < end ? page_start + page_size : end;
+            for (uintptr_t a = lo; a < hi; a += 4096) {
+                size_t idx = (a - start) / 4096;
+                m->pending[idx / 64] |= 1ULL << (idx % 64);
+            }
+        }
+    }
+    return 0;
+}
+
+static void monitor_mark_all(aes_sm3_monitor_t* m) {
+    size_t words = (m->page_count + 63) / 64;
+    memset(m->pending, 0xFF, words * sizeof(uint64_t));
+    if (m->page_count % 64) {
+        m->pending[words - 1] = (1ULL << (m->page_count % 64)) - 1;
+    }
+}
+
+// 监控 [base, base+length)，base须4KB对齐、length须为4096的整数倍
+aes_sm3_monitor_t* aes_sm3_monitor_create(const void* base, size_t length) {
+    if (((uintptr_t)base % 4096) != 0 || length == 0 || (length % 4096) != 0) {
+        return NULL;
+    }
+    pthread_once(&g_soft_dirty_once, soft_dirty_probe);
+    
+    aes_sm3_monitor_t* m = calloc(1, sizeof(aes_sm3_monitor_t));
+    if (m == NULL) {
+        return NULL;
+    }
+    m->base = (const uint8_t*)base;
+    m->page_count = length / 4096;
+    
+    // 计算Merkle树各层规模
+    size_t total_internal = 0;
+    size_t count = m->page_count;
+    m->level_count[0] = count;
+    m->levels = 1;
+    while (count > 1 && m->levels < AES_SM3_MERKLE_MAX_LEVELS) {
+        count = (count + 1) / 2;
+        m->level_offset[m->levels] = total_internal;
+        m->level_count[m->levels] = count;
+        total_internal += count;
+        m->levels++;
+    }
+    
+    size_t words = (m->page_count + 63) / 64;
+    m->digests = aligned_alloc(64, ((m->page_count * 32 + 63) / 64) * 64);
+    m->tree = malloc((total_internal > 0 ? total_internal : 1) * 32);
+    m->pending = calloc(words, sizeof(uint64_t));
+    m->work = calloc(words, sizeof(uint64_t));
+    m->dirty_index = malloc(m->page_count * sizeof(size_t));
+    if (m->digests == NULL || m->tree == NULL || m->pending == NULL ||
+        m->work == NULL || m->dirty_index == NULL) {
+        free(m->digests);
+        free(m->tree);
+        free(m->pending);
+        free(m->work);
+        free(m->dirty_index);
+        free(m);
+        return NULL;
+    }
+    
+    pthread_mutex_lock(&g_monitor_lock);
+    m->next = g_monitors;
+    g_monitors = m;
+    pthread_mutex_unlock(&g_monitor_lock);
+    return m;
+}
+
+void aes_sm3_monitor_destroy(aes_sm3_monitor_t* m) {
+    pthread_mutex_lock(&g_monitor_lock);
+    aes_sm3_monitor_t** link = &g_monitors;
+    while (*link != NULL && *link != m) {
+        link = &(*link)->next;
+    }
+    if (*link == m) {
+        *link = m->next;
+    }
+    pthread_mutex_unlock(&g_monitor_lock);
+    
+    free(m->digests);
+    free(m->tree);
+    free(m->pending);
+    free(m->work);
+    free(m->dirty_index);
+    free(m);
+}
+
+// 生成一次快照，返回本次重算的页数（出错返回-1）
+// 同一区域的快照不可并发调用；不同区域之间可以
+long aes_sm3_monitor_snapshot(aes_sm3_monitor_t* m) {
+    size_t words = (m->page_count + 63) / 64;
+    int full = !m->initialized || !g_soft_dirty_supported;
+    
+    pthread_mutex_lock(&g_monitor_lock);
+    if (g_soft_dirty_supported) {
+        int fd = open("/proc/self/pagemap", O_RDONLY);
+        int ok = (fd >= 0);
+        // 清除前为所有已开始追踪的区域（含仍在首次哈希中的区域）累积脏页，
+        // 避免被本次clear_refs吞掉
+        for (aes_sm3_monitor_t* it = g_monitors; ok && it != NULL; it = it->next) {
+            if (it->tracking && monitor_scan_pagemap(it, fd) != 0) {
+                ok = 0;
+            }
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        // 本区域在清除前登记为追踪中，此后其他区域的clear_refs都会先扫描它
+        m->tracking = 1;
+        if (!ok || clear_soft_dirty() != 0) {
+            full = 1;
+        }
+    }
+    if (full) {
+        monitor_mark_all(m);
+    }
+    memcpy(m->work, m->pending, words * sizeof(uint64_t));
+    memset(m->pending, 0, words * sizeof(uint64_t));
+    pthread_mutex_unlock(&g_monitor_lock);
+    
+    // 收集脏页下标（升序）
+    size_t dirty = 0;
+    for (size_t w = 0; w < words; w++) {
+        uint64_t bits = m->work[w];
+        while (bits) {
+            m->dirty_index[dirty++] = w * 64 + __builtin_ctzll(bits);
+            bits &= bits - 1;
+        }
+    }
+    
+    // 批处理内核重算脏页摘要；全量模式下只保留摘要真正变化的叶子
+    const uint8_t* inputs[AES_SM3_REHASH_BATCH];
+    uint8_t* outputs[AES_SM3_REHASH_BATCH];
+    uint8_t scratch[AES_SM3_REHASH_BATCH * 32] __attribute__((aligned(64)));
+    size_t changed = 0;
+    
+    for (size_t i = 0; i < dirty; i += AES_SM3_REHASH_BATCH) {
+        int n = (dirty - i) < AES_SM3_REHASH_BATCH ? (int)(dirty - i) : AES_SM3_REHASH_BATCH;
+        for (int k = 0; k < n; k++) {
+            inputs[k] = m->base + m->dirty_index[i + k] * 4096;
+            outputs[k] = scratch + k * 32;
+        }
+        aes_sm3_integrity_batch(inputs, outputs, n);
+        
+        for (int k = 0; k < n; k++) {
+            size_t idx = m->dirty_index[i + k];
+            uint8_t* leaf = m->digests + idx * 32;
+            if (!m->initialized || memcmp(leaf, outputs[k], 32) != 0) {
+                memcpy(leaf, outputs[k], 32);
+                m->dirty_index[changed++] = idx;
+            }
+        }
+    }
+    
+    if (!m->initialized) {
+        // 首次快照：自底向上完整建树
+        for (int level = 1; level < m->levels; level++) {
+            for (size_t p = 0; p < m->level_count[level]; p++) {
+                merkle_update_parent(m, level, p);
+            }
+        }
+        m->initialized = 1;
+    } else {
+        merkle_update(m, m->dirty_index, changed);
+    }
+    
+    return (long)dirty;
+}
+
+size_t aes_sm3_monitor_page_count(const aes_sm3_monitor_t* m) {
+    return m->page_count;
+}
+
+// 每页256位摘要数组（page_count * 32字节）
+const uint8_t* aes_sm3_monitor_digests(const aes_sm3_monitor_t* m) {
+    return m->digests;
+}
+
+void aes_sm3_monitor_root(const aes_sm3_monitor_t* m, uint8_t* root) {
+    const uint8_t* node = (m->levels == 1) ? m->digests
+                                           : m->tree + m->level_offset[m->levels - 1] * 32;
+    memcpy(root, node, 32);
+}
+
+// 内核soft-dirty追踪是否可用（不可用时每次快照全量重算）
+int aes_sm3_monitor_soft_dirty_supported(void) {
+    pthread_once(&g_soft_dirty_once, soft_dirty_probe);
+    return g_soft_dirty_supported;
+}
+
+// ============================================================================
+// 限速后台内存/文件巡检（scrub）
+// ============================================================================
+/*
+ * 后台线程循环校验已注册的内存区域或文件，发现与存储摘要不一致的页时
+ * 通过回调上报。为了不影响前台业务的尾延迟：
+ * - 工作线程以 SCHED_IDLE 调度策略运行，只使用空闲CPU
+ * - 带宽预算：令牌桶按字节限速，每批次前申请令牌
+ * - CPU预算：按本批次消耗的线程CPU时间补足休眠，使占空比不超过设定比例
+ * - 批次之间调用 sched_yield 作为让出点
+ * 预算参数为0表示不限制。
+ */
+
+#define AES_SM3_SCRUB_BATCH 16   // 每批校验的页数（64KB）
+
+typedef void (*aes_sm3_scrub_callback_t)(void* user, int region_id, size_t page_index,
+                                         const uint8_t* expected, const uint8_t* actual);
+
+typedef struct {
+    const uint8_t* base;     // 内存区域（文件区域时为NULL）
+    int fd;                  // 文件区域（内存区域时为-1）
+    size_t page_count;
+    const uint8_t* digests;  // 调用者提供的存储摘要，每页32字节
+} scrub_region_t;
+
+typedef struct aes_sm3_scrubber {
+    scrub_region_t* regions;
+    int region_count;
+    int region_capacity;
+    
+    double bandwidth_bytes;  // 每秒字节数，0表示不限
+    double cpu_fraction;     // CPU占空比上限(0,1]，0表示不限
+    double tokens;
+    struct timespec last_refill;
+    
+    aes_sm3_scrub_callback_t callback;
+    void* user;
+    
+    pthread_t thread;
+    int running;
+    atomic_int stop;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    
+    atomic_ullong pages_verified;
+    atomic_ullong mismatches;
+    atomic_ullong passes;
+} aes_sm3_scrubber_t;
+
+static double timespec_seconds(const struct timespec* ts) {
+    return ts->tv_sec + ts->tv_nsec / 1e9;
+}
+
+// 可被stop打断的休眠，返回非0表示收到停止请求
+static int scrub_sleep(aes_sm3_scrubber_t* s, double seconds) {
+    if (seconds <= 0.0) {
+        return 0;
+    }
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    double target = timespec_seconds(&deadline) + seconds;
+    deadline.tv_sec = (time_t)target;
+    deadline.tv_nsec = (long)((target - deadline.tv_sec) * 1e9);
+    
+    pthread_mutex_lock(&s->lock);
+    while (!s->stop) {
+        if (pthread_cond_timedwait(&s->cond, &s->lock, &deadline) != 0) {
+            break;
+        }
+    }
+    int stopped = s->stop;
+    pthread_mutex_unlock(&s->lock);
+    return stopped;
+}
+
+// 令牌桶：等待直到可以读取bytes字节
+static int scrub_acquire_tokens(aes_sm3_scrubber_t* s, double bytes) {
+    if (s->bandwidth_bytes <= 0.0) {
+        return 0;
+    }
+    
+    // 桶容量为4个批次，允许短时突发
+    double burst = 4.0 * AES_SM3_SCRUB_BATCH * 4096;
+    for (;;) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        s->tokens += (timespec_seconds(&now) - timespec_seconds(&s->last_refill)) * s->bandwidth_bytes;
+        s->last_refill = now;
+        if (s->tokens > burst) {
+            s->tokens = burst;
+        }
+        if (s->tokens >= bytes) {
+            s->tokens -= bytes;
+            return 0;
+        }
+        if (scrub_sleep(s, (bytes - s->tokens) / s->bandwidth_bytes)) {
+            return -1;
+        }
+    }
+}
+
+aes_sm3_scrubber_t* aes_sm3_scrubber_create(double bandwidth_mbps, double cpu_fraction,
+                                            aes_sm3_scrub_callback_t callback, void* user) {
+    aes_sm3_scrubber_t* s = calloc(1, sizeof(aes_sm3_scrubber_t));
+    if (s == NULL) {
+        return NULL;
+    }
+    
+    s->bandwidth_bytes = bandwidth_mbps > 0.0 ? bandwidth_mbps * 1024.0 * 1024.0 : 0.0;
+    s->cpu_fraction = (cpu_fraction > 0.0 && cpu_fraction < 1.0) ? cpu_fraction : 0.0;
+    s->callback = callback;
+    s->user = user;
+    clock_gettime(CLOCK_MONOTONIC, &s->last_refill);
+    
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&s->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&s->lock, NULL);
+    
+    atomic_init(&s->stop, 0);
+    atomic_init(&s->pages_verified, 0);
+    atomic_init(&s->mismatches, 0);
+    atomic_init(&s->passes, 0);
+    return s;
+}
+
+static int scrub_add_region(aes_sm3_scrubber_t* s, const uint8_t* base, int fd,
+                            size_t page_count, const uint8_t* digests) {
+    pthread_mutex_lock(&s->lock);
+    if (s->region_count == s->region_capacity) {
+        int capacity = s->region_capacity ? s->region_capacity * 2 : 8;
+        scrub_region_t* regions = realloc(s->regions, capacity * sizeof(scrub_region_t));
+        if (regions == NULL) {
+            pthread_mutex_unlock(&s->lock);
+            return -1;
+        }
+        s->regions = regions;
+        s->region_capacity = capacity;
+    }
+    
+    int id = s->region_count++;
+    s->regions[id].base = base;
+    s->regions[id].fd = fd;
+    s->regions[id].page_count = page_count;
+    s->regions[id].digests = digests;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+    return id;
+}
+
+// 注册内存区域，返回区域编号（失败返回-1）；digests须在巡检期间保持有效
+int aes_sm3_scrubber_add_memory(aes_sm3_scrubber_t* s, const void* base, size_t page_count,
+                                const uint8_t* digests) {
+    return scrub_add_region(s, (const uint8_t*)base, -1, page_count, digests);
+}
+
+// 注册文件（按4KB页校验前page_count页），返回区域编号（失败返回-1）
+int aes_sm3_scrubber_add_file(aes_sm3_scrubber_t* s, const char* path, size_t page_count,
+                              const uint8_t* digests) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    int id = scrub_add_region(s, NULL, fd, page_count, digests);
+    if (id < 0) {
+        close(fd);
+    }
+    return id;
+}
+
+// 读取前记录各页是否已在页缓存中；无法判断时视为已缓存（读完不丢弃）
+static void scrub_file_residency(int fd, size_t first, int count, unsigned char* resident) {
+    memset(resident, 1, count);
+    void* map = mmap(NULL, (size_t)count * 4096, PROT_READ, MAP_SHARED, fd, (off_t)first * 4096);
+    if (map == MAP_FAILED) {
+        return;
+    }
+    if (mincore(map, (size_t)count * 4096, resident) != 0) {
+        memset(resident, 1, count);
+    }
+    munmap(map, (size_t)count * 4096);
+}
+
+// 只丢弃本次巡检读入的页（读取前不在页缓存中的连续页段），不影响业务已缓存的数据
+static void scrub_drop_cache(int fd, size_t first, int count, const unsigned char* resident) {
+    int i = 0;
+    while (i < count) {
+        if (resident[i] & 1) {
+            i++;
+            continue;
+        }
+        int run = i;
+        while (run < count && !(resident[run] & 1)) {
+            run++;
+        }
+        posix_fadvise(fd, (off_t)(first + i) * 4096, (off_t)(run - i) * 4096, POSIX_FADV_DONTNEED);
+        i = run;
+    }
+}
+
+// 校验一个区域中的一批页，返回不一致页数（-1表示读取失败）
+static int scrub_verify_batch(aes_sm3_scrubber_t* s, int region_id, const scrub_region_t* r,
+                              size_t first, int count, uint8_t* file_buffer) {
+    const uint8_t* inputs[AES_SM3_SCRUB_BATCH];
+    uint8_t* outputs[AES_SM3_SCRUB_BATCH];
+    uint8_t actual[AES_SM3_SCRUB_BATCH * 32] __attribute__((aligned(64)));
+    
+    if (r->base != NULL) {
+        for (int i = 0; i < count; i++) {
+            inputs[i] = r->base + (first + i) * 4096;
+        }
+    } else {
+        unsigned char resident[AES_SM3_SCRUB_BATCH];
+        scrub_file_residency(r->fd, first, count, resident);
+        ssize_t want = (ssize_t)count * 4096;
+        ssize_t got = pread(r->fd, file_buffer, want, (off_t)first * 4096);
+        if (got != want) {
+            return -1;
+        }
+        // 巡检只读一遍，读完丢弃自己带入的页缓存，避免挤占业务数据
+        scrub_drop_cache(r->fd, first, count, resident);
+        for (int i = 0; i < count; i++) {
+            inputs[i] = file_buffer + i * 4096;
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        outputs[i] = actual + i * 32;
+    }
+    
+    aes_sm3_integrity_batch(inputs, outputs, count);
+    
+    int bad = 0;
+    for (int i = 0; i < count; i++) {
+        const uint8_t* expected = r->digests + (first + i) * 32;
+        if (memcmp(expected, outputs[i], 32) != 0) {
+            bad++;
+            USDT_PROBE2(verify_mismatch, AES_SM3_MISMATCH_SCRUB, first + i);
+            if (s->callback != NULL) {
+                s->callback(s->user, region_id, first + i, expected, outputs[i]);
+            }
+        }
+    }
+    return bad;
+}
+
+// 按预算完整巡检一遍所有区域，返回本遍发现的不一致页数（收到停止请求或分配失败时返回-1）
+long aes_sm3_scrubber_run_once(aes_sm3_scrubber_t* s) {
+    uint8_t* file_buffer = aligned_alloc(4096, AES_SM3_SCRUB_BATCH * 4096);
+    if (file_buffer == NULL) {
+        return -1;
+    }
+    long found = 0;
+    
+    pthread_mutex_lock(&s->lock);
+    int region_count = s->region_count;
+    pthread_mutex_unlock(&s->lock);
+    
+    for (int id = 0; id < region_count; id++) {
+        pthread_mutex_lock(&s->lock);
+        scrub_region_t region = s->regions[id];
+        pthread_mutex_unlock(&s->lock);
+        
+        for (size_t page = 0; page < region.page_count; page += AES_SM3_SCRUB_BATCH) {
+            int count = (region.page_count - page) < AES_SM3_SCRUB_BATCH
+                      ? (int)(region.page_count - page) : AES_SM3_SCRUB_BATCH;
+            
+            if (scrub_acquire_tokens(s, (double)count * 4096) != 0) {
+                free(file_buffer);
+                return -1;
+            }
+            
+            struct timespec cpu_start, cpu_end;
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_start);
+            int bad = scrub_verify_batch(s, id, &region, page, count, file_buffer);
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_end);
+            
+            if (bad < 0) {
+                break;  // 文件被截断或读取失败，跳过该区域剩余部分
+            }
+            found += bad;
+            atomic_fetch_add_explicit(&s->pages_verified, count, memory_order_relaxed);
+            atomic_fetch_add_explicit(&s->mismatches, bad, memory_order_relaxed);
+            
+            // CPU预算：本批耗时c秒，则休眠c*(1/f-1)秒
+            if (s->cpu_fraction > 0.0) {
+                double used = timespec_seconds(&cpu_end) - timespec_seconds(&cpu_start);
+                if (scrub_sleep(s, used * (1.0 / s->cpu_fraction - 1.0))) {
+                    free(file_buffer);
+                    return -1;
+                }
+            }
+            
+            // 批次间让出点
+            sched_yield();
+            if (atomic_load_explicit(&s->stop, memory_order_relaxed)) {
+                free(file_buffer);
+                return -1;
+            }
+        }
+    }
+    
+    atomic_fetch_add_explicit(&s->passes, 1, memory_order_relaxed);
+    free(file_buffer);
+    return found;
+}
+
+static void* scrubber_thread(void* arg) {
+    aes_sm3_scrubber_t* s = (aes_sm3_scrubber_t*)arg;
+    
+    // 空闲优先级：只有CPU空闲时才运行（失败时保持默认策略）
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+    
+    for (;;) {
+        pthread_mutex_lock(&s->lock);
+        while (!s->stop && s->region_count == 0) {
+            pthread_cond_wait(&s->cond, &s->lock);
+        }
+        int stop = s->stop;
+        pthread_mutex_unlock(&s->lock);
+        
+        if (stop || aes_sm3_scrubber_run_once(s) < 0) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+int aes_sm3_scrubber_start(aes_sm3_scrubber_t* s) {
+    if (s->running) {
+        return 0;
+    }
+    atomic_store_explicit(&s->stop, 0, memory_order_relaxed);
+    if (pthread_create(&s->thread, NULL, scrubber_thread, s) != 0) {
+        return -1;
+    }
+    s->running = 1;
+    return 0;
+}
+
+void aes_sm3_scrubber_stop(aes_sm3_scrubber_t* s) {
+    if (!s->running) {
+        return;
+    }
+    pthread_mutex_lock(&s->lock);
+    atomic_store_explicit(&s->stop, 1, memory_order_relaxed);
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+    pthread_join(s->thread, NULL);
+    s->running = 0;
+}
+
+void aes_sm3_scrubber_destroy(aes_sm3_scrubber_t* s) {
+    aes_sm3_scrubber_stop(s);
+    for (int i = 0; i < s->region_count; i++) {
+        if (s->regions[i].fd >= 0) {
+            close(s->regions[i].fd);
+        }
+    }
+    pthread_mutex_destroy(&s->lock);
+    pthread_cond_destroy(&s->cond);
+    free(s->regions);
+    free(s);
+}
+
+// 累计统计：已校验页数、不一致页数、完成遍数
+void aes_sm3_scrubber_stats(const aes_sm3_scrubber_t* s, unsigned long long* pages_verified,
+                            unsigned long long* mismatches, unsigned long long* passes) {
+    *pages_verified = atomic_load_explicit(&s->pages_verified, memory_order_relaxed);
+    *mismatches = atomic_load_explicit(&s->mismatches, memory_order_relaxed);
+    *passes = atomic_load_explicit(&s->passes, memory_order_relaxed);
+}
+
+// ============================================================================
+// 并行页级差异比较（镜像/快照diff）
+// ============================================================================
+/*
+ * 对两个大输入的对应4KB页做一次交织遍历：同一个循环里同时折叠两页，
+ * 并把两页的异或结果OR累积，既得到精确的“是否相同”判断，又可以顺带
+ * 输出两侧的页摘要（需要时才做SM3阶段），整个过程只受内存带宽限制。
+ * 也可以只给出一侧数据和另一侧已有的摘要清单（manifest），此时只哈希
+ * 一侧并比较摘要。变化页以合并后的区间（extent）输出。
+ */
+
+#define AES_SM3_DIFF_MAX_THREADS 64
+
+typedef struct {
+    uint64_t start;   // 起始页号
+    uint64_t count;   // 连续变化页数
+} aes_sm3_extent_t;
+
+// 交织折叠一对页，返回非0表示两页内容不同
+static inline int xor_fold_4kb_pair(const uint8_t* a, const uint8_t* b,
+                                    uint8_t* compressed_a, uint8_t* compressed_b) {
+#if defined(__ARM_FEATURE_CRYPTO) && defined(__aarch64__)
+    uint8x16_t diff = vdupq_n_u8(0);
+    for (int i = 0; i < 16; i++) {
+        const uint8_t* pa = a + i * 256;
+        const uint8_t* pb = b + i * 256;
+        uint8x16_t fa = vdupq_n_u8(0);
+        uint8x16_t fb = vdupq_n_u8(0);
+        for (int k = 0; k < 256; k += 32) {
+            uint8x16_t a0 = vld1q_u8(pa + k), a1 = vld1q_u8(pa + k + 16);
+            uint8x16_t b0 = vld1q_u8(pb + k), b1 = vld1q_u8(pb + k + 16);
+            fa = veorq_u8(fa, veorq_u8(a0, a1));
+            fb = veorq_u8(fb, veorq_u8(b0, b1));
+            diff = vorrq_u8(diff, vorrq_u8(veorq_u8(a0, b0), veorq_u8(a1, b1)));
+        }
+        vst1_u8(compressed_a + i * 8, vget_low_u8(fa));
+        vst1_u8(compressed_b + i * 8, vget_low_u8(fb));
+    }
+    return vmaxvq_u8(diff) != 0;
+#else
+    uint64_t diff = 0;
+    for (int i = 0; i < 16; i++) {
+        const uint8_t* pa = a + i * 256;
+        const uint8_t* pb = b + i * 256;
+        uint64_t fa0 = 0, fa1 = 0, fb0 = 0, fb1 = 0;
+        for (int k = 0; k < 256; k += 16) {
+            uint64_t a0, a1, b0, b1;
+            memcpy(&a0, pa + k, 8);
+            memcpy(&a1, pa + k + 8, 8);
+            memcpy(&b0, pb + k, 8);
+            memcpy(&b1, pb + k + 8, 8);
+            fa0 ^= a0; fa1 ^= a1;
+            fb0 ^= b0; fb1 ^= b1;
+            diff |= (a0 ^ b0) | (a1 ^ b1);
+        }
+        uint64_t fa = fa0 ^ fa1, fb = fb0 ^ fb1;
+        memcpy(compressed_a + i * 8, &fa, 8);
+        memcpy(compressed_b + i * 8, &fb, 8);
+    }
+    return diff != 0;
+#endif
+}
+
+typedef struct {
+    const uint8_t* a;
+    const uint8_t* b;               // 为NULL时与manifest比较
+    const uint8_t* manifest;
+    uint8_t* digests_a;             // 可选输出
+    uint8_t* digests_b;
+    uint64_t* changed;              // 变化页位图
+    size_t first_page;
+    size_t end_page;
+} diff_worker_t;
+
+static void* diff_worker(void* arg) {
+    diff_worker_t* w = (diff_worker_t*)arg;
+    uint8_t ca[128] __attribute__((aligned(64)));
+    uint8_t cb[128] __attribute__((aligned(64)));
+    uint32_t state[8];
+    
+    if (w->b != NULL) {
+        int want_digests = (w->digests_a != NULL || w->digests_b != NULL);
+        for (size_t p = w->first_page; p < w->end_page; p++) {
+            const uint8_t* pa = w->a + p * 4096;
+            const uint8_t* pb = w->b + p * 4096;
+            __builtin_prefetch(pa + 4096, 0, 0);
+            __builtin_prefetch(pb + 4096, 0, 0);
+            
+            if (xor_fold_4kb_pair(pa, pb, ca, cb)) {
+                w->changed[p / 64] |= 1ULL << (p % 64);
+            }
+            if (want_digests) {
+                if (w->digests_a != NULL) {
+                    sm3_hash_compressed(ca, state);
+                    sm3_store_state(state, w->digests_a + p * 32, 8);
+                }
+                if (w->digests_b != NULL) {
+                    sm3_hash_compressed(cb, state);
+                    sm3_store_state(state, w->digests_b + p * 32, 8);
+                }
+            }
+        }
+        return NULL;
+    }
+    
+    // 与已有manifest比较：批处理哈希一侧数据
+    const uint8_t* inputs[AES_SM3_JOB_PAGES];
+    uint8_t* outputs[AES_SM3_JOB_PAGES];
+    uint8_t scratch[AES_SM3_JOB_PAGES * 32] __attribute__((aligned(64)));
+    for (size_t p = w->first_page; p < w->end_page; p += AES_SM3_JOB_PAGES) {
+        int n = (w->end_page - p) < AES_SM3_JOB_PAGES ? (int)(w->end_page - p) : AES_SM3_JOB_PAGES;
+        for (int k = 0; k < n; k++) {
+            inputs[k] = w->a + (p + k) * 4096;
+            outputs[k] = (w->digests_a != NULL) ? w->digests_a + (p + k) * 32 : scratch + k * 32;
+        }
+        aes_sm3_integrity_batch(inputs, outputs, n);
+        for (int k = 0; k < n; k++) {
+            if (memcmp(outputs[k], w->manifest + (p + k) * 32, 32) != 0) {
+                w->changed[(p + k) / 64] |= 1ULL << ((p + k) % 64);
+            }
+        }
+    }
+    return NULL;
+}
+
+// 位图 -> 合并区间
+static long diff_bitmap_to_extents(const uint64_t* changed, size_t page_count,
+                                   aes_sm3_extent_t** extents) {
+    size_t capacity = 16;
+    long count = 0;
+    aes_sm3_extent_t* list = malloc(capacity * sizeof(aes_sm3_extent_t));
+    if (list == NULL) {
+        return -1;
+    }
+    
+    size_t words = (page_count + 63) / 64;
+    for (size_t w = 0; w < words; w++) {
+        uint64_t bits = changed[w];
+        while (bits) {
+            size_t page = w * 64 + __builtin_ctzll(bits);
+            bits &= bits - 1;
+            if (count > 0 && list[count - 1].start + list[count - 1].count == page) {
+                list[count - 1].count++;
+                continue;
+            }
+            if ((size_t)count == capacity) {
+                capacity *= 2;
+                aes_sm3_extent_t* grown = realloc(list, capacity * sizeof(aes_sm3_extent_t));
+                if (grown == NULL) {
+                    free(list);
+                    return -1;
+                }
+                list = grown;
+            }
+            list[count].start = page;
+            list[count].count = 1;
+            count++;
+        }
+    }
+    
+    *extents = list;
+    return count;
+}
+
+// 多线程执行比较，分区按64页对齐，各线程写入互不重叠的位图字
+static long diff_run(diff_worker_t* proto, size_t page_count, int num_threads,
+                     aes_sm3_extent_t** extents) {
+    size_t words = (page_count + 63) / 64;
+    uint64_t* changed = calloc(words > 0 ? words : 1, sizeof(uint64_t));
+    if (changed == NULL) {
+        return -1;
+    }
+    
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+    if (num_threads > AES_SM3_DIFF_MAX_THREADS) {
+        num_threads = AES_SM3_DIFF_MAX_THREADS;
+    }
+    if ((size_t)num_threads > words) {
+        num_threads = words > 0 ? (int)words : 1;
+    }
+    
+    pthread_t threads[AES_SM3_DIFF_MAX_THREADS];
+    diff_worker_t workers[AES_SM3_DIFF_MAX_THREADS];
+    size_t words_per_thread = words / num_threads;
+    
+    int created[AES_SM3_DIFF_MAX_THREADS] = {0};
+    for (int t = 0; t < num_threads; t++) {
+        workers[t] = *proto;
+        workers[t].changed = changed;
+        workers[t].first_page = t * words_per_thread * 64;
+        workers[t].end_page = (t == num_threads - 1) ? page_count
+                                                     : (t + 1) * words_per_thread * 64;
+        if (t > 0) {
+            created[t] = pthread_create(&threads[t], NULL, diff_worker, &workers[t]) == 0;
+        }
+    }
+    // 第0个分区以及未能创建线程的分区在调用线程上执行
+    for (int t = 0; t < num_threads; t++) {
+        if (!created[t]) {
+            diff_worker(&workers[t]);
+        }
+    }
+    for (int t = 1; t < num_threads; t++) {
+        if (created[t]) {
+            pthread_join(threads[t], NULL);
+        }
+    }
+    
+    long count = diff_bitmap_to_extents(changed, page_count, extents);
+    free(changed);
+    return count;
+}
+
+// 比较两个内存输入的page_count个4KB页，返回变化区间数（*extents由调用者free）
+// digests_a/digests_b 非NULL时顺带输出两侧的页摘要
+long aes_sm3_diff_memory(const uint8_t* a, const uint8_t* b, size_t page_count, int num_threads,
+                         uint8_t* digests_a, uint8_t* digests_b, aes_sm3_extent_t** extents) {
+    diff_worker_t proto;
+    memset(&proto, 0, sizeof(proto));
+    proto.a = a;
+    proto.b = b;
+    proto.digests_a = digests_a;
+    proto.digests_b = digests_b;
+    return diff_run(&proto, page_count, num_threads, extents);
+}
+
+// 用一侧数据与另一侧已有的页摘要清单比较（只读一遍数据）
+// 只能检出改变页摘要的变化：aarch64上页摘要不覆盖每16字节中的第8~15字节
+long aes_sm3_diff_manifest(const uint8_t* data, const uint8_t* manifest, size_t page_count,
+                           int num_threads, aes_sm3_extent_t** extents) {
+    diff_worker_t proto;
+    memset(&proto, 0, sizeof(proto));
+    proto.a = data;
+    proto.manifest = manifest;
+    return diff_run(&proto, page_count, num_threads, extents);
+}
+
+static const uint8_t* diff_map_file(const char* path, size_t* size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    off_t length = lseek(fd, 0, SEEK_END);
+    if (length < 0) {
+        close(fd);
+        return NULL;
+    }
+    *size = (size_t)length;
+    const uint8_t* data = (const uint8_t*)"";
+    if (length > 0) {
+        data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            return NULL;
+        }
+        madvise((void*)data, length, MADV_SEQUENTIAL);
+    }
+    close(fd);
+    return data;
+}
+
+// 比较两个文件（长度可以不同）：两侧都有完整4KB的页并行比较，其余页逐页比较，
+// 两侧在该页的字节数不同即视为变化（即使补零后相同），只在一侧存在的页视为变化
+long aes_sm3_diff_files(const char* path_a, const char* path_b, int num_threads,
+                        aes_sm3_extent_t** extents) {
+    size_t size_a = 0, size_b = 0;
+    const uint8_t* a = diff_map_file(path_a, &size_a);
+    const uint8_t* b = diff_map_file(path_b, &size_b);
+    if (a == NULL || b == NULL) {
+        if (a != NULL && size_a > 0) munmap((void*)a, size_a);
+        if (b != NULL && size_b > 0) munmap((void*)b, size_b);
+        return -1;
+    }
+    
+    size_t full_pages = (size_a < size_b ? size_a : size_b) / 4096;
+    size_t total_pages = ((size_a > size_b ? size_a : size_b) + 4095) / 4096;
+    
+    aes_sm3_extent_t* head = NULL;
+    long count = aes_sm3_diff_memory(a, b, full_pages, num_threads, NULL, NULL, &head);
+    
+    // 尾部页逐页补零比较
+    for (size_t p = full_pages; count >= 0 && p < total_pages; p++) {
+        uint8_t pa[4096], pb[4096];
+        size_t off = p * 4096;
+        size_t len_a = off < size_a ? (size_a - off < 4096 ? size_a - off : 4096) : 0;
+        size_t len_b = off < size_b ? (size_b - off < 4096 ? size_b - off : 4096) : 0;
+        memset(pa, 0, sizeof(pa));
+        memset(pb, 0, sizeof(pb));
+        memcpy(pa, a + off, len_a);
+        memcpy(pb, b + off, len_b);
+        if (len_a == len_b && memcmp(pa, pb, 4096) == 0) {
+            continue;
+        }
+        if (count > 0 && head[count - 1].start + head[count - 1].count == p) {
+            head[count - 1].count++;
+        } else {
+            aes_sm3_extent_t* grown = realloc(head, (count + 1) * sizeof(aes_sm3_extent_t));
+            if (grown == NULL) {
+                free(head);
+                count = -1;
+                break;
+            }
+            head = grown;
+            head[count].start = p;
+            head[count].count = 1;
+            count++;
+        }
+    }
+    
+    if (size_a > 0) munmap((void*)a, size_a);
+    if (size_b > 0) munmap((void*)b, size_b);
+    *extents = head;
+    return count;
+}
+
+// ============================================================================
+// 本地增量同步（rsync式，基于4KB页摘要清单）
+// ============================================================================
+/*
+ * 页摘要清单（manifest）文件：64字节头 + 每页32字节摘要。头中记录被描述
+ * 文件的长度和mtime，两者与实际文件不符时视为过期并重新哈希目标文件。
+ * 尾部不足4KB的页按补零计算摘要。清单摘要用覆盖全部字节的折叠
+ * （xor_fold_segment_full）计算：软件路径上与aes_sm3_integrity_256bit相同，
+ * aarch64上不会漏掉只改动每16字节中第8~15字节的页。
+ *
+ * 同步流程按块流水线化：引擎工作线程哈希源文件第k+1块的同时，调用线程
+ * 比较第k块的摘要，把不一致的连续页用copy_file_range写入目标（不支持时
+ * 回退到pwrite），并就地更新清单中对应的摘要。目标文件大部分未变化时，
+ * 代价约为读一遍源文件加少量写入。
+ */
+
+#define AES_SM3_MANIFEST_MAGIC "SM3MANF2"  // 版本2：全覆盖折叠摘要
+#define AES_SM3_SYNC_CHUNK_PAGES 1024
+
+typedef struct {
+    char magic[8];
+    uint32_t page_size;
+    uint32_t digest_size;
+    uint64_t file_size;       // 被描述文件的长度
+    uint64_t page_count;
+    int64_t mtime_ns;         // 被描述文件的mtime
+    uint8_t reserved[24];
+} aes_sm3_manifest_header_t;
+
+typedef struct {
+    int fd;                   // -1表示仅在内存中（不持久化）
+    uint8_t* map;
+    size_t map_size;
+    aes_sm3_manifest_header_t* header;
+    uint8_t* digests;
+} manifest_map_t;
+
+static int64_t file_mtime_ns(const struct stat* st) {
+    return (int64_t)st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+}
+
+// 打开（或创建）清单并映射page_capacity页的摘要区；返回清单是否与st描述的文件一致
+static int manifest_map_open(const char* path, size_t page_capacity, const struct stat* st,
+                             manifest_map_t* m) {
+    m->fd = -1;
+    m->map_size = sizeof(aes_sm3_manifest_header_t) + page_capacity * 32;
+    
+    aes_sm3_manifest_header_t old;
+    memset(&old, 0, sizeof(old));
+    if (path != NULL) {
+        m->fd = open(path, O_RDWR | O_CREAT, 0644);
+        if (m->fd < 0) {
+            return -1;
+        }
+        if (pread(m->fd, &old, sizeof(old), 0) != (ssize_t)sizeof(old)) {
+            memset(&old, 0, sizeof(old));
+        }
+        if (ftruncate(m->fd, m->map_size) != 0) {
+            close(m->fd);
+            return -1;
+        }
+        m->map = mmap(NULL, m->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, m->fd, 0);
+    } else {
+        m->map = mmap(NULL, m->map_size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    if (m->map == MAP_FAILED) {
+        if (m->fd >= 0) {
+            close(m->fd);
+        }
+        return -1;
+    }
+    m->header = (aes_sm3_manifest_header_t*)m->map;
+    m->digests = m->map + sizeof(aes_sm3_manifest_header_t);
+    
+    return memcmp(old.magic, AES_SM3_MANIFEST_MAGIC, 8) == 0 &&
+           old.page_size == 4096 && old.digest_size == 32 &&
+           old.file_size == (uint64_t)st->st_size &&
+           old.mtime_ns == file_mtime_ns(st);
+}
+
+// 写入清单头（最后一步，保证头有效时摘要区已完整）
+static void manifest_map_close(manifest_map_t* m, const struct stat* st) {
+    if (m->fd >= 0) {
+        aes_sm3_manifest_header_t header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, AES_SM3_MANIFEST_MAGIC, 8);
+        header.page_size = 4096;
+        header.digest_size = 32;
+        header.file_size = st->st_size;
+        header.page_count = (st->st_size + 4095) / 4096;
+        header.mtime_ns = file_mtime_ns(st);
+        msync(m->map, m->map_size, MS_SYNC);
+        memcpy(m->header, &header, sizeof(header));
+        msync(m->map, sizeof(header), MS_SYNC);
+        close(m->fd);
+    }
+    munmap(m->map, m->map_size);
+}
+
+// 清单使用的单页摘要（全覆盖折叠 + 2次SM3压缩）
+static void manifest_page_digest(const uint8_t* input, uint8_t* output) {
+    uint8_t compressed[128] __attribute__((aligned(64)));
+    uint32_t state[8];
+    for (int i = 0; i < 16; i++) {
+        xor_fold_segment_full(input + i * 256, compressed + i * 8);
+    }
+    sm3_hash_compressed(compressed, state);
+    sm3_store_state(state, output, 8);
+}
+
+// 计算文件中第page页的清单摘要（尾页补零）
+static void file_page_digest(const uint8_t* data, size_t size, size_t page, uint8_t* digest) {
+    size_t offset = page * 4096;
+    if (offset + 4096 <= size) {
+        manifest_page_digest(data + offset, digest);
+        return;
+    }
+    uint8_t padded[4096] __attribute__((aligned(64)));
+    memset(padded, 0, sizeof(padded));
+    memcpy(padded, data + offset, size - offset);
+    manifest_page_digest(padded, digest);
+}
+
+// 用引擎并行计算连续整页的清单摘要（引擎不可用时在调用线程上计算）
+static void manifest_hash_pages(const uint8_t* data, uint8_t* digests, size_t pages, int num_threads) {
+    aes_sm3_engine_t* engine = aes_sm3_engine_create(num_threads, 1024, HASH_QUEUE_BLOCK);
+    aes_sm3_completion_t* completion = aes_sm3_completion_create();
+    if (engine != NULL && completion != NULL) {
+        engine_submit_sized(engine, data, digests, (int)pages, 4096, 256, AES_SM3_JOB_PAGES,
+                            manifest_page_digest, completion);
+        aes_sm3_completion_wait(completion);
+    } else {
+        for (size_t i = 0; i < pages; i++) {
+            manifest_page_digest(data + i * 4096, digests + i * 32);
+        }
+    }
+    if (engine != NULL) {
+        aes_sm3_engine_destroy(engine);
+    }
+    aes_sm3_completion_destroy(completion);
+}
+
+// 哈希文件前page_count页（整页并行，尾页单独处理）
+static int manifest_hash_fd(int fd, size_t size, size_t page_count, uint8_t* digests,
+                            int num_threads) {
+    if (page_count == 0) {
+        return 0;
+    }
+    const uint8_t* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        return -1;
+    }
+    madvise((void*)data, size, MADV_SEQUENTIAL);
+    
+    size_t full_pages = size / 4096 < page_count ? size / 4096 : page_count;
+    if (full_pages > 0) {
+        manifest_hash_pages(data, digests, full_pages, num_threads);
+    }
+    if (full_pages < page_count) {
+        file_page_digest(data, size, full_pages, digests + full_pages * 32);
+    }
+    munmap((void*)data, size);
+    return 0;
+}
+
+// 为文件生成页摘要清单
+int aes_sm3_manifest_build(const char* path, const char* manifest_path, int num_threads) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    
+    size_t pages = (st.st_size + 4095) / 4096;
+    manifest_map_t m;
+    if (manifest_map_open(manifest_path, pages, &st, &m) < 0) {
+        close(fd);
+        return -1;
+    }
+    int ret = manifest_hash_fd(fd, st.st_size, pages, m.digests, num_threads);
+    close(fd);
+    if (ret == 0) {
+        manifest_map_close(&m, &st);
+    } else {
+        if (m.fd >= 0) {
+            close(m.fd);
+        }
+        munmap(m.map, m.map_size);
+    }
+    return ret;
+}
+
+// 把[first, first+count)页从源复制到目标：优先copy_file_range，失败回退pwrite
+static int sync_copy_range(int src_fd, const uint8_t* src, size_t src_size, int dst_fd,
+                           size_t first, size_t count, int* use_copy_range) {
+    size_t offset = first * 4096;
+    size_t length = count * 4096;
+    if (offset + length > src_size) {
+        length = src_size - offset;
+    }
+    
+    while (length > 0 && *use_copy_range) {
+        loff_t in_off = offset, out_off = offset;
+        ssize_t n = copy_file_range(src_fd, &in_off, dst_fd, &out_off, length, 0);
+        if (n <= 0) {
+            *use_copy_range = 0;
+            break;
+        }
+        offset += n;
+        length -= n;
+    }
+    while (length > 0) {
+        ssize_t n = pwrite(dst_fd, src + offset, length, offset);
+        if (n <= 0) {
+            return -1;
+        }
+        offset += n;
+        length -= n;
+    }
+    return 0;
+}
+
+// 比较一块源页摘要与清单，写入不一致的连续页并更新清单，返回写入页数
+static long sync_apply_chunk(int src_fd, const uint8_t* src, size_t src_size, int dst_fd,
+                             uint8_t* manifest_digests, size_t known_pages,
+                             const uint8_t* digests, size_t first, size_t count,
+                             int* use_copy_range) {
+    long written = 0;
+    size_t run_start = 0, run_len = 0;
+    
+    for (size_t i = 0; i <= count; i++) {
+        int changed = 0;
+        if (i < count) {
+            size_t page = first + i;
+            changed = page >= known_pages ||
+                      memcmp(manifest_digests + page * 32, digests + i * 32, 32) != 0;
+        }
+        if (changed) {
+            if (run_len == 0) {
+                run_start = first + i;
+            }
+            run_len++;
+            continue;
+        }
+        if (run_len > 0) {
+            if (sync_copy_range(src_fd, src, src_size, dst_fd, run_start, run_len,
+                                use_copy_range) != 0) {
+                return -1;
+            }
+            memcpy(manifest_digests + run_start * 32, digests + (run_start - first) * 32,
+                   run_len * 32);
+            written += run_len;
+            run_len = 0;
+        }
+    }
+    return written;
+}
+
+// 把源文件增量同步到目标文件，返回实际写入的页数，失败返回-1
+// manifest_path为NULL时每次重新哈希目标文件
+long aes_sm3_sync_file(const char* src_path, const char* dst_path, const char* manifest_path,
+                       int num_threads) {
+    int src_fd = open(src_path, O_RDONLY);
+    if (src_fd < 0) {
+        return -1;
+    }
+    int dst_fd = open(dst_path, O_RDWR | O_CREAT, 0644);
+    if (dst_fd < 0) {
+        close(src_fd);
+        return -1;
+    }
+    
+    long written = -1;
+    struct stat src_st, dst_st;
+    if (fstat(src_fd, &src_st) != 0 || fstat(dst_fd, &dst_st) != 0) {
+        goto out_fds;
+    }
+    
+    size_t src_size = src_st.st_size;
+    size_t src_pages = (src_size + 4095) / 4096;
+    size_t dst_pages = ((size_t)dst_st.st_size + 4095) / 4096;
+    size_t known_pages = dst_pages < src_pages ? dst_pages : src_pages;
+    
+    manifest_map_t m;
+    int valid = manifest_map_open(manifest_path, src_pages, &dst_st, &m);
+    if (valid < 0) {
+        goto out_fds;
+    }
+    if (!valid && manifest_hash_fd(dst_fd, dst_st.st_size, known_pages, m.digests,
+                                   num_threads) != 0) {
+        goto out_manifest;
+    }
+    // 长度变化：截断后的尾页与补零摘要语义一致，扩展部分一律写入
+    if ((size_t)dst_st.st_size != src_size && ftruncate(dst_fd, src_size) != 0) {
+        goto out_manifest;
+    }
+    
+    const uint8_t* src = NULL;
+    if (src_size > 0) {
+        src = mmap(NULL, src_size, PROT_READ, MAP_PRIVATE, src_fd, 0);
+        if (src == MAP_FAILED) {
+            goto out_manifest;
+        }
+        madvise((void*)src, src_size, MADV_SEQUENTIAL);
+    }
+    
+    size_t full_pages = src_size / 4096;
+    size_t chunks = (full_pages + AES_SM3_SYNC_CHUNK_PAGES - 1) / AES_SM3_SYNC_CHUNK_PAGES;
+    uint8_t* digests[2];
+    digests[0] = malloc(AES_SM3_SYNC_CHUNK_PAGES * 32);
+    digests[1] = malloc(AES_SM3_SYNC_CHUNK_PAGES * 32);
+    aes_sm3_completion_t* done[2] = { aes_sm3_completion_create(), aes_sm3_completion_create() };
+    aes_sm3_engine_t* engine = aes_sm3_engine_create(num_threads, 1024, HASH_QUEUE_BLOCK);
+    int use_copy_range = 1;
+    written = 0;
+    
+    int serial = digests[0] == NULL || digests[1] == NULL || done[0] == NULL || done[1] == NULL ||
+                 engine == NULL;
+    if (serial) {
+        // 资源不足：在调用线程上逐块哈希并写入（摘要缓冲区也分配失败时逐页进行）
+        uint8_t one[32];
+        uint8_t* buf = digests[0] != NULL ? digests[0] : (digests[1] != NULL ? digests[1] : one);
+        size_t step = buf == one ? 1 : AES_SM3_SYNC_CHUNK_PAGES;
+        for (size_t first = 0; first < full_pages && written >= 0; first += step) {
+            size_t count = full_pages - first < step ? full_pages - first : step;
+            for (size_t i = 0; i < count; i++) {
+                manifest_page_digest(src + (first + i) * 4096, buf + i * 32);
+            }
+            long n = sync_apply_chunk(src_fd, src, src_size, dst_fd, m.digests, known_pages,
+                                      buf, first, count, &use_copy_range);
+            written = n < 0 ? -1 : written + n;
+        }
+    }
+    
+    // 流水线：提交第k+1块哈希后处理第k块写入
+    for (size_t k = 0; !serial && k <= chunks && written >= 0; k++) {
+        if (k < chunks) {
+            size_t first = k * AES_SM3_SYNC_CHUNK_PAGES;
+            size_t count = full_pages - first < AES_SM3_SYNC_CHUNK_PAGES
+                               ? full_pages - first : AES_SM3_SYNC_CHUNK_PAGES;
+            engine_submit_sized(engine, src + first * 4096, digests[k & 1], (int)count, 4096, 256,
+                                AES_SM3_JOB_PAGES, manifest_page_digest, done[k & 1]);
+        }
+        if (k > 0) {
+            size_t prev = k - 1;
+            size_t first = prev * AES_SM3_SYNC_CHUNK_PAGES;
+            size_t count = full_pages - first < AES_SM3_SYNC_CHUNK_PAGES
+                               ? full_pages - first : AES_SM3_SYNC_CHUNK_PAGES;
+            aes_sm3_completion_wait(done[prev & 1]);
+            long n = sync_apply_chunk(src_fd, src, src_size, dst_fd, m.digests, known_pages,
+                                      digests[prev & 1], first, count, &use_copy_range);
+            written = n < 0 ? -1 : written + n;
+        }
+    }
+    // 等待出错时可能仍在进行的哈希任务
+    if (!serial) {
+        aes_sm3_completion_wait(done[0]);
+        aes_sm3_completion_wait(done[1]);
+    }
+    
+    if (written >= 0 && full_pages < src_pages) {
+        uint8_t tail[32];
+        file_page_digest(src, src_size, full_pages, tail);
+        long n = sync_apply_chunk(src_fd, src, src_size, dst_fd, m.digests, known_pages,
+                                  tail, full_pages, 1, &use_copy_range);
+        written = n < 0 ? -1 : written + n;
+    }
+    
+    if (engine != NULL) {
+        aes_sm3_engine_destroy(engine);
+    }
+    aes_sm3_completion_destroy(done[0]);
+    aes_sm3_completion_destroy(done[1]);
+    free(digests[0]);
+    free(digests[1]);
+    if (src != NULL) {
+        munmap((void*)src, src_size);
+    }
+    
+    // 数据落盘后再提交清单头，崩溃时清单只会过期而不会描述错误内容
+    if (written >= 0 && fdatasync(dst_fd) == 0 && fstat(dst_fd, &dst_st) == 0) {
+        manifest_map_close(&m, &dst_st);
+        goto out_fds;
+    }
+    written = -1;
+    
+out_manifest:
+    if (m.fd >= 0) {
+        close(m.fd);
+    }
+    munmap(m.map, m.map_size);
+out_fds:
+    close(src_fd);
+    close(dst_fd);
+    return written;
+}
+
+// ============================================================================
+// 带完整性帧的追加写日志（后台批量摘要 + 组提交）
+// ============================================================================
+/*
+ * 记录按4KB页成帧：首页以16字节帧头（魔数、长度、序号）开始，末页补零。
+ * 记录依次装入“组”（最多AES_SM3_LOG_GROUP_PAGES个数据页），组尾追加一个
+ * 索引页，保存组内每页的摘要以及索引页自身的校验摘要。
+ *
+ * 追加调用只复制数据，不做哈希；组写满或调用commit时封组，由后台线程
+ * 用批处理内核计算整组摘要，把所有已封组用一次pwritev写出后fdatasync
+ * （组提交）。恢复时先顺序扫描帧头定位各组，再用任务引擎多核并行校验
+ * 全部数据页，遇到第一个损坏或写入不完整的组即截止。
+ * 页摘要与清单相同，用覆盖全部字节的折叠（manifest_page_digest），
+ * aarch64上只改动每16字节中第8~15字节的损坏同样会被检出。
+ */
+
+#define AES_SM3_LOG_GROUP_PAGES 64
+#define AES_SM3_LOG_BUFFERS 8
+#define AES_SM3_LOG_RECORD_MAGIC 0x4C524543u    // "LREC"
+#define AES_SM3_LOG_INDEX_MAGIC "SM3LOGIX"
+#define AES_SM3_LOG_FRAME_HEADER 16
+#define AES_SM3_LOG_INDEX_DIGESTS 64            // 摘要区在索引页内的偏移
+
+typedef struct {
+    uint32_t magic;
+    uint32_t length;
+    uint64_t seq;
+} log_frame_header_t;
+
+typedef struct {
+    char magic[8];
+    uint32_t page_count;      // 本组数据页数
+    uint32_t record_count;
+    uint64_t first_seq;
+    uint64_t offset;          // 本组首个数据页的文件偏移（识别残留的旧索引页）
+} log_index_header_t;
+
+typedef void (*aes_sm3_log_record_callback_t)(void* user, uint64_t seq, const uint8_t* data,
+                                              size_t length);
+
+typedef struct aes_sm3_log {
+    int fd;
+    uint8_t* buffers;                                 // 每组GROUP_PAGES个数据页 + 1个索引页
+    uint64_t buffer_group[AES_SM3_LOG_BUFFERS];       // 缓冲区当前承载的组号
+    uint32_t fill_pages[AES_SM3_LOG_BUFFERS];
+    uint32_t fill_records[AES_SM3_LOG_BUFFERS];
+    uint64_t first_seq[AES_SM3_LOG_BUFFERS];
+    uint64_t group_offset[AES_SM3_LOG_BUFFERS];
+    
+    uint64_t next_seq;
+    uint64_t next_offset;
+    uint64_t sealed;          // 已封组数（当前填充组号）
+    uint64_t durable;         // 已落盘组数
+    int stop;
+    int error;
+    
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    pthread_t thread;
+} aes_sm3_log_t;
+
+static inline uint8_t* log_buffer(aes_sm3_log_t* wal, uint64_t group) {
+    return wal->buffers + (group % AES_SM3_LOG_BUFFERS) * (AES_SM3_LOG_GROUP_PAGES + 1) * 4096;
+}
+
+// 索引页自校验：对校验字段清零后的索引页计算摘要（全覆盖折叠，同数据页）
+static void log_index_checksum(const uint8_t* index_page, uint8_t* checksum) {
+    uint8_t copy[4096] __attribute__((aligned(64)));
+    memcpy(copy, index_page, 4096);
+    memset(copy + 4096 - 32, 0, 32);
+    manifest_page_digest(copy, checksum);
+}
+
+// 填充索引页：批处理计算整组摘要
+static void log_build_index(aes_sm3_log_t* wal, uint64_t group) {
+    int b = group % AES_SM3_LOG_BUFFERS;
+    uint8_t* data = log_buffer(wal, group);
+    uint8_t* index = data + (size_t)wal->fill_pages[b] * 4096;
+    
+    memset(index, 0, 4096);
+    log_index_header_t header;
+    memcpy(header.magic, AES_SM3_LOG_INDEX_MAGIC, 8);
+    header.page_count = wal->fill_pages[b];
+    header.record_count = wal->fill_records[b];
+    header.first_seq = wal->first_seq[b];
+    header.offset = wal->group_offset[b];
+    memcpy(index, &header, sizeof(header));
+    
+    // 数据页摘要用覆盖全部字节的折叠（与manifest_page_digest相同），SM3阶段批处理
+    uint8_t compressed[AES_SM3_LOG_GROUP_PAGES * 128] __attribute__((aligned(64)));
+    uint8_t* compressed_ptrs[AES_SM3_LOG_GROUP_PAGES];
+    uint8_t* outputs[AES_SM3_LOG_GROUP_PAGES];
+    for (uint32_t i = 0; i < wal->fill_pages[b]; i++) {
+        const uint8_t* page = data + (size_t)i * 4096;
+        compressed_ptrs[i] = compressed + i * 128;
+        outputs[i] = index + AES_SM3_LOG_INDEX_DIGESTS + i * 32;
+        for (int seg = 0; seg < 16; seg++) {
+            xor_fold_segment_full(page + seg * 256, compressed_ptrs[i] + seg * 8);
+        }
+    }
+    batch_sm3_hash((const uint8_t**)compressed_ptrs, outputs, wal->fill_pages[b]);
+    log_index_checksum(index, index + 4096 - 32);
+}
+
+// 写出全部iov（处理短写和EINTR），成功返回0
+static int log_pwritev_all(int fd, struct iovec* iov, int count, off_t offset) {
+    while (count > 0) {
+        ssize_t n = pwritev(fd, iov, count, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        offset += n;
+        // 跳过已完整写出的iov，调整部分写出的那一个
+        while (count > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (uint8_t*)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return 0;
+}
+
+// 后台线程：摘要已封组，一次pwritev写出并fdatasync
+static void* log_writer_thread(void* arg) {
+    aes_sm3_log_t* wal = (aes_sm3_log_t*)arg;
+    struct iovec iov[AES_SM3_LOG_BUFFERS];
+    
+    pthread_mutex_lock(&wal->lock);
+    for (;;) {
+        while (wal->durable == wal->sealed && !wal->stop) {
+            pthread_cond_wait(&wal->work_cond, &wal->lock);
+        }
+        if (wal->durable == wal->sealed) {
+            break;
+        }
+        uint64_t first = wal->durable;
+        uint64_t last = wal->sealed;
+        pthread_mutex_unlock(&wal->lock);
+        
+        for (uint64_t g = first; g < last; g++) {
+            log_build_index(wal, g);
+            iov[g - first].iov_base = log_buffer(wal, g);
+            iov[g - first].iov_len = (size_t)(wal->fill_pages[g % AES_SM3_LOG_BUFFERS] + 1) * 4096;
+        }
+        int failed = log_pwritev_all(wal->fd, iov, (int)(last - first),
+                                     wal->group_offset[first % AES_SM3_LOG_BUFFERS]) != 0 ||
+                     fdatasync(wal->fd) != 0;
+        
+        pthread_mutex_lock(&wal->lock);
+        if (failed) {
+            // 写入失败时不推进durable：等待者看到error后返回失败
+            wal->error = 1;
+            wal->stop = 1;
+            pthread_cond_broadcast(&wal->done_cond);
+            break;
+        }
+        wal->durable = last;
+        pthread_cond_broadcast(&wal->done_cond);
+    }
+    pthread_mutex_unlock(&wal->lock);
+    return NULL;
+}
+
+// 封闭当前组（需持有锁）
+static void log_seal_locked(aes_sm3_log_t* wal) {
+    int b = wal->sealed % AES_SM3_LOG_BUFFERS;
+    if (wal->buffer_group[b] != wal->sealed || wal->fill_pages[b] == 0) {
+        return;
+    }
+    wal->group_offset[b] = wal->next_offset;
+    wal->next_offset += (uint64_t)(wal->fill_pages[b] + 1) * 4096;
+    wal->sealed++;
+    pthread_cond_signal(&wal->work_cond);
+}
+
+// 追加一条记录，返回记录序号；记录超过一组容量或日志已出错时返回-1
+long long aes_sm3_log_append(aes_sm3_log_t* wal, const void* data, size_t length) {
+    uint32_t pages = (AES_SM3_LOG_FRAME_HEADER + length + 4095) / 4096;
+    if (pages > AES_SM3_LOG_GROUP_PAGES || length > UINT32_MAX) {
+        return -1;
+    }
+    
+    pthread_mutex_lock(&wal->lock);
+    int b = wal->sealed % AES_SM3_LOG_BUFFERS;
+    if (wal->buffer_group[b] == wal->sealed &&
+        wal->fill_pages[b] + pages > AES_SM3_LOG_GROUP_PAGES) {
+        log_seal_locked(wal);
+    }
+    // 缓冲区仍被尚未落盘的旧组占用时等待（反压）
+    while (wal->sealed - wal->durable >= AES_SM3_LOG_BUFFERS && !wal->error) {
+        pthread_cond_wait(&wal->done_cond, &wal->lock);
+    }
+    if (wal->error) {
+        pthread_mutex_unlock(&wal->lock);
+        return -1;
+    }
+    b = wal->sealed % AES_SM3_LOG_BUFFERS;
+    if (wal->buffer_group[b] != wal->sealed) {
+        wal->buffer_group[b] = wal->sealed;
+        wal->fill_pages[b] = 0;
+        wal->fill_records[b] = 0;
+        wal->first_seq[b] = wal->next_seq;
+    }
+    
+    uint8_t* frame = log_buffer(wal, wal->sealed) + (size_t)wal->fill_pages[b] * 4096;
+    log_frame_header_t header = { AES_SM3_LOG_RECORD_MAGIC, (uint32_t)length, wal->next_seq };
+    size_t used = AES_SM3_LOG_FRAME_HEADER + length;
+    memcpy(frame, &header, sizeof(header));
+    memcpy(frame + AES_SM3_LOG_FRAME_HEADER, data, length);
+    memset(frame + used, 0, (size_t)pages * 4096 - used);
+    
+    wal->fill_pages[b] += pages;
+    wal->fill_records[b]++;
+    long long seq = wal->next_seq++;
+    if (wal->fill_pages[b] == AES_SM3_LOG_GROUP_PAGES) {
+        log_seal_locked(wal);
+    }
+    pthread_mutex_unlock(&wal->lock);
+    return seq;
+}
+
+// 封闭当前组并等待此前追加的所有记录落盘
+int aes_sm3_log_commit(aes_sm3_log_t* wal) {
+    pthread_mutex_lock(&wal->lock);
+    log_seal_locked(wal);
+    uint64_t target = wal->sealed;
+    while (wal->durable < target && !wal->error) {
+        pthread_cond_wait(&wal->done_cond, &wal->lock);
+    }
+    int ret = wal->error ? -1 : 0;
+    pthread_mutex_unlock(&wal->lock);
+    return ret;
+}
+
+typedef struct {
+    uint64_t first_page;      // 组内首个数据页
+    uint32_t page_count;
+    uint32_t record_count;
+    uint64_t first_seq;
+} log_group_t;
+
+// 扫描帧头与索引页，定位所有结构完整的组（不校验数据摘要）
+static long log_scan_groups(const uint8_t* map, size_t page_total, log_group_t** groups) {
+    size_t capacity = 64;
+    long count = 0;
+    log_group_t* list = malloc(capacity * sizeof(log_group_t));
+    if (list == NULL) {
+        return -1;
+    }
+    
+    size_t page = 0, group_start = 0;
+    uint32_t records = 0;
+    while (page < page_total) {
+        const uint8_t* p = map + page * 4096;
+        log_frame_header_t frame;
+        memcpy(&frame, p, sizeof(frame));
+        
+        if (frame.magic == AES_SM3_LOG_RECORD_MAGIC) {
+            size_t pages = (AES_SM3_LOG_FRAME_HEADER + (size_t)frame.length + 4095) / 4096;
+            if (page + pages - group_start > AES_SM3_LOG_GROUP_PAGES || page + pages >= page_total) {
+                break;
+            }
+            page += pages;
+            records++;
+            continue;
+        }
+        
+        log_index_header_t header;
+        uint8_t checksum[32];
+        memcpy(&header, p, sizeof(header));
+        if (memcmp(header.magic, AES_SM3_LOG_INDEX_MAGIC, 8) != 0 ||
+            header.page_count != page - group_start || header.page_count == 0 ||
+            header.record_count != records || header.offset != group_start * 4096) {
+            break;
+        }
+        log_index_checksum(p, checksum);
+        if (memcmp(checksum, p + 4096 - 32, 32) != 0) {
+            break;
+        }
+        
+        if ((size_t)count == capacity) {
+            capacity *= 2;
+            log_group_t* grown = realloc(list, capacity * sizeof(log_group_t));
+            if (grown == NULL) {
+                free(list);
+                return -1;
+            }
+            list = grown;
+        }
+        list[count].first_page = group_start;
+        list[count].page_count = header.page_count;
+        list[count].record_count = header.record_count;
+        list[count].first_seq = header.first_seq;
+        count++;
+        
+        page++;
+        group_start = page;
+        records = 0;
+    }
+    
+    *groups = list;
+    return count;
+}
+
+// 恢复日志：多核并行校验全部数据页，按顺序回调完好组内的记录
+// 返回恢复的记录数；valid_bytes/next_seq（可为NULL）输出完好部分的长度与下一序号
+long aes_sm3_log_recover(const char* path, int num_threads, aes_sm3_log_record_callback_t callback,
+                         void* user, uint64_t* valid_bytes, uint64_t* next_seq) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    if (valid_bytes) *valid_bytes = 0;
+    if (next_seq) *next_seq = 0;
+    size_t page_total = st.st_size / 4096;
+    if (page_total == 0) {
+        close(fd);
+        return 0;
+    }
+    
+    const uint8_t* map = mmap(NULL, page_total * 4096, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    madvise((void*)map, page_total * 4096, MADV_SEQUENTIAL);
+    
+    log_group_t* groups = NULL;
+    long group_count = log_scan_groups(map, page_total, &groups);
+    long recovered = group_count < 0 ? -1 : 0;
+    
+    size_t data_pages = 0;
+    for (long g = 0; g < group_count; g++) {
+        data_pages += groups[g].page_count;
+    }
+    uint8_t* digests = malloc(data_pages > 0 ? data_pages * 32 : 32);
+    
+    if (group_count > 0 && digests != NULL) {
+        // 并行校验：每组的数据页是连续的，逐组提交给任务引擎
+        // 引擎或完成计数创建失败时在调用线程上校验
+        aes_sm3_engine_t* engine = aes_sm3_engine_create(num_threads, 1024, HASH_QUEUE_BLOCK);
+        aes_sm3_completion_t* completion = aes_sm3_completion_create();
+        size_t offset = 0;
+        for (long g = 0; g < group_count; g++) {
+            const uint8_t* first = map + groups[g].first_page * 4096;
+            if (engine != NULL && completion != NULL) {
+                engine_submit_sized(engine, first, digests + offset * 32, groups[g].page_count, 4096, 256,
+                                    16, manifest_page_digest, completion);
+            } else {
+                for (uint32_t i = 0; i < groups[g].page_count; i++) {
+                    manifest_page_digest(first + (size_t)i * 4096, digests + (offset + i) * 32);
+                }
+            }
+            offset += groups[g].page_count;
+        }
+        if (engine != NULL && completion != NULL) {
+            aes_sm3_completion_wait(completion);
+        }
+        aes_sm3_completion_destroy(completion);
+        if (engine != NULL) {
+            aes_sm3_engine_destroy(engine);
+        }
+        
+        offset = 0;
+        for (long g = 0; g < group_count; g++) {
+            const uint8_t* index = map + (groups[g].first_page + groups[g].page_count) * 4096;
+            if (memcmp(index + AES_SM3_LOG_INDEX_DIGESTS, digests + offset * 32,
+                       (size_t)groups[g].page_count * 32) != 0) {
+                break;
+            }
+            offset += groups[g].page_count;
+            
+            size_t page = groups[g].first_page;
+            for (uint32_t r = 0; r < groups[g].record_count; r++) {
+                log_frame_header_t frame;
+                memcpy(&frame, map + page * 4096, sizeof(frame));
+                if (callback != NULL) {
+                    callback(user, frame.seq, map + page * 4096 + AES_SM3_LOG_FRAME_HEADER,
+                             frame.length);
+                }
+                page += (AES_SM3_LOG_FRAME_HEADER + (size_t)frame.length + 4095) / 4096;
+            }
+            recovered += groups[g].record_count;
+            if (valid_bytes) *valid_bytes = (groups[g].first_page + groups[g].page_count + 1) * 4096;
+            if (next_seq) *next_seq = groups[g].first_seq + groups[g].record_count;
+        }
+    } else if (digests == NULL) {
+        recovered = -1;
+    }
+    
+    free(digests);
+    free(groups);
+    munmap((void*)map, page_total * 4096);
+    return recovered;
+}
+
+// 打开日志用于追加：先恢复，截断到最后一个完好组之后
+aes_sm3_log_t* aes_sm3_log_open(const char* path) {
+    uint64_t valid_bytes = 0, next_seq = 0;
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+    int cores = sysconf(_SC_NPROCESSORS_ONLN);
+    long recovered = aes_sm3_log_recover(path, cores, NULL, NULL, &valid_bytes, &next_seq);
+    if (recovered < 0 || ftruncate(fd, valid_bytes) != 0) {
+        close(fd);
+        return NULL;
+    }
+    
+    aes_sm3_log_t* wal = calloc(1, sizeof(aes_sm3_log_t));
+    size_t buffer_size = (size_t)AES_SM3_LOG_BUFFERS * (AES_SM3_LOG_GROUP_PAGES + 1) * 4096;
+    uint8_t* buffers = aligned_alloc(4096, buffer_size);
+    if (wal == NULL || buffers == NULL) {
+        free(wal);
+        free(buffers);
+        close(fd);
+        return NULL;
+    }
+    
+    wal->fd = fd;
+    wal->buffers = buffers;
+    for (int b = 0; b < AES_SM3_LOG_BUFFERS; b++) {
+        wal->buffer_group[b] = UINT64_MAX;
+    }
+    wal->next_seq = next_seq;
+    wal->next_offset = valid_bytes;
+    
+    pthread_mutex_init(&wal->lock, NULL);
+    pthread_cond_init(&wal->work_cond, NULL);
+    pthread_cond_init(&wal->done_cond, NULL);
+    if (pthread_create(&wal->thread, NULL, log_writer_thread, wal) != 0) {
+        pthread_mutex_destroy(&wal->lock);
+        pthread_cond_destroy(&wal->work_cond);
+        pthread_cond_destroy(&wal->done_cond);
+        free(buffers);
+        free(wal);
+        close(fd);
+        return NULL;
+    }
+    return wal;
+}
+
+// 提交剩余记录并关闭日志
+int aes_sm3_log_close(aes_sm3_log_t* wal) {
+    int ret = aes_sm3_log_commit(wal);
+    
+    pthread_mutex_lock(&wal->lock);
+    wal->stop = 1;
+    pthread_cond_signal(&wal->work_cond);
+    pthread_mutex_unlock(&wal->lock);
+    pthread_join(wal->thread, NULL);
+    
+    pthread_mutex_destroy(&wal->lock);
+    pthread_cond_destroy(&wal->work_cond);
+    pthread_cond_destroy(&wal->done_cond);
+    if (close(wal->fd) != 0) {
+        ret = -1;
+    }
+    free(wal->buffers);
+    free(wal);
+    return ret;
+}
+
+// ============================================================================
+// 校验型直读页缓存（填充时哈希）
+// ============================================================================
+/*
+ * 位于慢速存储前的用户态4KB页缓存。后备文件以只读方式映射，未命中时用
+ * 复制+哈希融合内核把页从映射装入缓存帧，同一遍读取中得到摘要并与清单
+ * 比较，一致才标记为已校验并对外可见；不一致的页不进入缓存。命中路径
+ * 不再做任何校验。
+ *
+ * 按页号分片，每个分片独立加锁，使用CLOCK算法淘汰；被pin住或正在装入的
+ * 帧不会被淘汰。装入过程不持有分片锁，其他线程访问同一页时等待装入完成。
+ * 后备文件末尾不足4KB的页按补零计算摘要（与混合长度批处理一致），帧中
+ * 超出文件的部分填零。
+ */
+
+#define AES_SM3_CACHE_MAX_SHARDS 64
+
+// aes_sm3_cache_get的状态码（成功时为1已校验/0未校验）
+#define AES_SM3_CACHE_RANGE   -1  // 页号超出后备文件
+#define AES_SM3_CACHE_CORRUPT -2  // 摘要与清单不一致
+#define AES_SM3_CACHE_BUSY    -3  // 分片内所有帧都被pin住或正在装入
+
+enum {
+    CACHE_FRAME_EMPTY = 0,
+    CACHE_FRAME_LOADING,
+    CACHE_FRAME_READY
+};
+
+typedef struct {
+    uint64_t page;
+    int32_t next;             // 哈希桶链
+    int32_t pins;
+    uint8_t state;
+    uint8_t referenced;       // CLOCK访问位
+    uint8_t verified;
+    uint8_t digest[32];
+} cache_frame_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t loaded;
+    cache_frame_t* frames;
+    int32_t* buckets;
+    uint8_t* data;
+    uint32_t frame_count;
+    uint32_t bucket_mask;
+    uint32_t clock_hand;
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long corrupt;
+} __attribute__((aligned(AES_SM3_CACHE_LINE))) cache_shard_t;
+
+typedef struct aes_sm3_cache {
+    const uint8_t* backing;
+    size_t backing_size;
+    size_t page_count;
+    const uint8_t* manifest;  // 每页32字节期望摘要，可为NULL（只计算不比较）
+    int shard_count;
+    cache_shard_t* shards;
+} aes_sm3_cache_t;
+
+static inline cache_shard_t* cache_shard_of(aes_sm3_cache_t* cache, uint64_t page) {
+    return &cache->shards[page % cache->shard_count];
+}
+
+static inline uint32_t cache_bucket(const cache_shard_t* shard, uint64_t page) {
+    return (uint32_t)((page * 0x9E3779B97F4A7C15ULL) >> 32) & shard->bucket_mask;
+}
+
+static int32_t cache_lookup(cache_shard_t* shard, uint64_t page) {
+    int32_t f = shard->buckets[cache_bucket(shard, page)];
+    while (f >= 0 && shard->frames[f].page != page) {
+        f = shard->frames[f].next;
+    }
+    return f;
+}
+
+static void cache_unlink(cache_shard_t* shard, int32_t f) {
+    int32_t* link = &shard->buckets[cache_bucket(shard, shard->frames[f].page)];
+    while (*link != f) {
+        link = &shard->frames[*link].next;
+    }
+    *link = shard->frames[f].next;
+}
+
+// CLOCK选择可淘汰帧：跳过pin住和装入中的帧，两圈内找不到则返回-1
+static int32_t cache_evict(cache_shard_t* shard) {
+    for (uint32_t scanned = 0; scanned < 2 * shard->frame_count; scanned++) {
+        uint32_t f = shard->clock_hand;
+        shard->clock_hand = (shard->clock_hand + 1) % shard->frame_count;
+        cache_frame_t* frame = &shard->frames[f];
+        
+        if (frame->state == CACHE_FRAME_EMPTY) {
+            return f;
+        }
+        if (frame->state != CACHE_FRAME_READY || frame->pins > 0) {
+            continue;
+        }
+        if (frame->referenced) {
+            frame->referenced = 0;
+            continue;
+        }
+        cache_unlink(shard, f);
+        frame->state = CACHE_FRAME_EMPTY;
+        return f;
+    }
+    return -1;
+}
+
+void aes_sm3_cache_destroy(aes_sm3_cache_t* cache) {
+    for (int s = 0; s < cache->shard_count; s++) {
+        cache_shard_t* shard = &cache->shards[s];
+        pthread_mutex_destroy(&shard->lock);
+        pthread_cond_destroy(&shard->loaded);
+        free(shard->frames);
+        free(shard->buckets);
+        free(shard->data);
+    }
+    munmap((void*)cache->backing, cache->backing_size);
+    free(cache->shards);
+    free(cache);
+}
+
+aes_sm3_cache_t* aes_sm3_cache_create(int fd, const uint8_t* manifest, size_t capacity_pages,
+                                      int shard_count) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        return NULL;
+    }
+    if (shard_count < 1) {
+        shard_count = 1;
+    }
+    if (shard_count > AES_SM3_CACHE_MAX_SHARDS) {
+        shard_count = AES_SM3_CACHE_MAX_SHARDS;
+    }
+    uint32_t frames_per_shard = (capacity_pages + shard_count - 1) / shard_count;
+    if (frames_per_shard < 1) {
+        frames_per_shard = 1;
+    }
+    
+    aes_sm3_cache_t* cache = calloc(1, sizeof(aes_sm3_cache_t));
+    if (cache == NULL) {
+        return NULL;
+    }
+    cache->backing_size = st.st_size;
+    cache->page_count = (st.st_size + 4095) / 4096;
+    cache->manifest = manifest;
+    cache->backing = mmap(NULL, cache->backing_size, PROT_READ, MAP_SHARED, fd, 0);
+    cache->shards = aligned_alloc(AES_SM3_CACHE_LINE, shard_count * sizeof(cache_shard_t));
+    if (cache->backing == MAP_FAILED || cache->shards == NULL) {
+        if (cache->backing != MAP_FAILED) {
+            munmap((void*)cache->backing, cache->backing_size);
+        }
+        free(cache->shards);
+        free(cache);
+        return NULL;
+    }
+    madvise((void*)cache->backing, cache->backing_size, MADV_RANDOM);
+    
+    uint32_t buckets = 1;
+    while (buckets < frames_per_shard * 2) {
+        buckets <<= 1;
+    }
+    for (int s = 0; s < shard_count; s++) {
+        cache_shard_t* shard = &cache->shards[s];
+        memset(shard, 0, sizeof(*shard));
+        pthread_mutex_init(&shard->lock, NULL);
+        pthread_cond_init(&shard->loaded, NULL);
+        shard->frame_count = frames_per_shard;
+        shard->bucket_mask = buckets - 1;
+        shard->frames = calloc(frames_per_shard, sizeof(cache_frame_t));
+        shard->buckets = malloc(buckets * sizeof(int32_t));
+        shard->data = aligned_alloc(4096, (size_t)frames_per_shard * 4096);
+        if (shard->buckets != NULL) {
+            memset(shard->buckets, 0xFF, buckets * sizeof(int32_t));
+        }
+        cache->shard_count = s + 1;
+        if (shard->frames == NULL || shard->buckets == NULL || shard->data == NULL) {
+            aes_sm3_cache_destroy(cache);
+            return NULL;
+        }
+    }
+    return cache;
+}
+
+// 装入一页：整页用复制+哈希融合内核，尾页只读取文件内的字节并补零
+static void cache_load_page(const aes_sm3_cache_t* cache, uint64_t page, uint8_t* data, uint8_t* digest) {
+    const uint8_t* src = cache->backing + page * 4096;
+    size_t length = cache->backing_size - page * 4096;
+    if (length >= 4096) {
+        aes_sm3_copy_integrity_256bit(data, src, digest);
+        return;
+    }
+    aes_sm3_integrity_batch_mixed(&src, &length, &digest, 1);
+    memcpy(data, src, length);
+    memset(data + length, 0, 4096 - length);
+}
+
+// 获取并pin住一页，返回缓存中的页数据，失败时返回NULL
+// status（可为NULL）成功时输出1（已与清单比对一致）或0（无清单），失败时输出AES_SM3_CACHE_*错误码
+const uint8_t* aes_sm3_cache_get(aes_sm3_cache_t* cache, uint64_t page, int* status) {
+    if (page >= cache->page_count) {
+        if (status) *status = AES_SM3_CACHE_RANGE;
+        return NULL;
+    }
+    cache_shard_t* shard = cache_shard_of(cache, page);
+    
+    pthread_mutex_lock(&shard->lock);
+    for (;;) {
+        int32_t f = cache_lookup(shard, page);
+        if (f < 0) {
+            break;
+        }
+        cache_frame_t* frame = &shard->frames[f];
+        if (frame->state == CACHE_FRAME_READY) {
+            frame->pins++;
+            frame->referenced = 1;
+            shard->hits++;
+            if (status) *status = frame->verified;
+            pthread_mutex_unlock(&shard->lock);
+            return shard->data + (size_t)f * 4096;
+        }
+        // 其他线程正在装入：等待后重新查找（装入失败时该帧已被移除）
+        pthread_cond_wait(&shard->loaded, &shard->lock);
+    }
+    
+    int32_t f = cache_evict(shard);
+    if (f < 0) {
+        pthread_mutex_unlock(&shard->lock);
+        if (status) *status = AES_SM3_CACHE_BUSY;
+        return NULL;
+    }
+    cache_frame_t* frame = &shard->frames[f];
+    uint32_t b = cache_bucket(shard, page);
+    frame->page = page;
+    frame->next = shard->buckets[b];
+    frame->pins = 1;
+    frame->state = CACHE_FRAME_LOADING;
+    shard->buckets[b] = f;
+    shard->misses++;
+    pthread_mutex_unlock(&shard->lock);
+    
+    // 装入：一遍完成复制与摘要计算
+    uint8_t* data = shard->data + (size_t)f * 4096;
+    cache_load_page(cache, page, data, frame->digest);
+    int ok = (cache->manifest == NULL) ||
+             memcmp(frame->digest, cache->manifest + page * 32, 32) == 0;
+    
+    pthread_mutex_lock(&shard->lock);
+    if (ok) {
+        frame->state = CACHE_FRAME_READY;
+        frame->referenced = 1;
+        frame->verified = (cache->manifest != NULL);
+    } else {
+        cache_unlink(shard, f);
+        frame->state = CACHE_FRAME_EMPTY;
+        frame->pins = 0;
+        shard->corrupt++;
+        USDT_PROBE2(verify_mismatch, AES_SM3_MISMATCH_CACHE, page);
+    }
+    pthread_cond_broadcast(&shard->loaded);
+    pthread_mutex_unlock(&shard->lock);
+    
+    if (!ok) {
+        if (status) *status = AES_SM3_CACHE_CORRUPT;
+        return NULL;
+    }
+    if (status) *status = frame->verified;
+    return data;
+}
+
+// 解除aes_sm3_cache_get对页的pin
+void aes_sm3_cache_release(aes_sm3_cache_t* cache, uint64_t page) {
+    cache_shard_t* shard = cache_shard_of(cache, page);
+    pthread_mutex_lock(&shard->lock);
+    int32_t f = cache_lookup(shard, page);
+    if (f >= 0 && shard->frames[f].pins > 0) {
+        shard->frames[f].pins--;
+    }
+    pthread_mutex_unlock(&shard->lock);
+}
+
+void aes_sm3_cache_stats(aes_sm3_cache_t* cache, unsigned long long* hits,
+                         unsigned long long* misses, unsigned long long* corrupt) {
+    *hits = *misses = *corrupt = 0;
+    for (int s = 0; s < cache->shard_count; s++) {
+        cache_shard_t* shard = &cache->shards[s];
+        pthread_mutex_lock(&shard->lock);
+        *hits += shard->hits;
+        *misses += shard->misses;
+        *corrupt += shard->corrupt;
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+
+// ============================================================================
+// 数据库页校验（4KB页存储引擎的校验和垫片）
+// ============================================================================
+/*
+ * 面向4KB页的嵌入式数据库（SQLite式VFS、B树引擎）：每页末尾保留16字节
+ * 尾区存放128位摘要。摘要覆盖尾区清零后的整页：用覆盖全部字节的折叠
+ * （xor_fold_segment_full）后直接从折叠结果中抵消尾区的贡献，只遍历一次
+ * 数据、不需要复制页。软件折叠路径上与“清零尾区后调用
+ * aes_sm3_integrity_128bit”结果一致；aarch64上额外覆盖每16字节的第8~15字节。
+ *
+ * 写入时就地填写尾区再交给底层I/O；读取后校验，多页读取先批量折叠，
+ * 再走批处理SM3阶段。底层I/O以回调表给出，便于接入现有VFS。
+ */
+
+#define AES_SM3_PAGE_TRAILER 16
+#define AES_SM3_PAGE_PAYLOAD (4096 - AES_SM3_PAGE_TRAILER)
+#define AES_SM3_PAGE_EIO -1
+#define AES_SM3_PAGE_CORRUPT -2
+
+typedef struct {
+    int (*read)(void* ctx, void* buf, size_t length, uint64_t offset);
+    int (*write)(void* ctx, const void* buf, size_t length, uint64_t offset);
+    void* ctx;
+} aes_sm3_page_io_t;
+
+typedef struct aes_sm3_pagestore {
+    aes_sm3_page_io_t io;
+    atomic_ullong checksum_failures;
+} aes_sm3_pagestore_t;
+
+// 全覆盖折叠整页并抵消尾区贡献（等价于尾区清零后折叠）
+static inline void page_fold_untrailed(const uint8_t* page, uint8_t* compressed) {
+    const uint8_t* trailer = page + AES_SM3_PAGE_PAYLOAD;
+    for (int i = 0; i < 16; i++) {
+        xor_fold_segment_full(page + i * 256, compressed + i * 8);
+    }
+    for (int k = 0; k < 8; k++) {
+        compressed[120 + k] ^= trailer[k] ^ trailer[8 + k];
+    }
+}
+
+// 计算页摘要并写入尾区
+void aes_sm3_page_seal(uint8_t* page) {
+    uint8_t compressed[128] __attribute__((aligned(64)));
+    uint32_t state[8];
+    page_fold_untrailed(page, compressed);
+    sm3_hash_compressed(compressed, state);
+    sm3_store_state(state, page + AES_SM3_PAGE_PAYLOAD, 4);
+}
+
+// 批量校验count个页，返回损坏页数；first_bad（可为NULL）输出第一个损坏页的下标
+int aes_sm3_page_verify_batch(const uint8_t** pages, int count, int* first_bad) {
+    uint8_t compressed[AES_SM3_JOB_PAGES * 128] __attribute__((aligned(64)));
+    uint8_t digests[AES_SM3_JOB_PAGES * 32] __attribute__((aligned(64)));
+    uint8_t* compressed_ptrs[AES_SM3_JOB_PAGES];
+    uint8_t* digest_ptrs[AES_SM3_JOB_PAGES];
+    int bad = 0;
+    
+    if (first_bad) *first_bad = -1;
+    for (int base = 0; base < count; base += AES_SM3_JOB_PAGES) {
+        int n = count - base < AES_SM3_JOB_PAGES ? count - base : AES_SM3_JOB_PAGES;
+        for (int i = 0; i < n; i++) {
+            if (i + 1 < n) {
+                __builtin_prefetch(pages[base + i + 1], 0, 3);
+            }
+            compressed_ptrs[i] = compressed + i * 128;
+            digest_ptrs[i] = digests + i * 32;
+            page_fold_untrailed(pages[base + i], compressed_ptrs[i]);
+        }
+        batch_sm3_hash((const uint8_t**)compressed_ptrs, digest_ptrs, n);
+        
+        for (int i = 0; i < n; i++) {
+            if (memcmp(digest_ptrs[i], pages[base + i] + AES_SM3_PAGE_PAYLOAD,
+                       AES_SM3_PAGE_TRAILER) != 0) {
+                if (bad == 0 && first_bad) *first_bad = base + i;
+                bad++;
+            }
+        }
+    }
+    return bad;
+}
+
+// 校验单页，一致返回1
+int aes_sm3_page_verify(const uint8_t* page) {
+    return aes_sm3_page_verify_batch(&page, 1, NULL) == 0;
+}
+
+static int pagestore_fd_read(void* ctx, void* buf, size_t length, uint64_t offset) {
+    int fd = (int)(intptr_t)ctx;
+    size_t done = 0;
+    while (done < length) {
+        ssize_t n = pread(fd, (uint8_t*)buf + done, length - done, offset + done);
+        if (n <= 0) {
+            return -1;
+        }
+        done += n;
+    }
+    return 0;
+}
+
+static int pagestore_fd_write(void* ctx, const void* buf, size_t length, uint64_t offset) {
+    int fd = (int)(intptr_t)ctx;
+    size_t done = 0;
+    while (done < length) {
+        ssize_t n = pwrite(fd, (const uint8_t*)buf + done, length - done, offset + done);
+        if (n <= 0) {
+            return -1;
+        }
+        done += n;
+    }
+    return 0;
+}
+
+aes_sm3_pagestore_t* aes_sm3_pagestore_create(const aes_sm3_page_io_t* io) {
+    aes_sm3_pagestore_t* ps = malloc(sizeof(aes_sm3_pagestore_t));
+    if (ps != NULL) {
+        ps->io = *io;
+        atomic_init(&ps->checksum_failures, 0);
+    }
+    return ps;
+}
+
+// 以文件描述符为底层I/O（pread/pwrite）
+aes_sm3_pagestore_t* aes_sm3_pagestore_open_fd(int fd) {
+    aes_sm3_page_io_t io = { pagestore_fd_read, pagestore_fd_write, (void*)(intptr_t)fd };
+    return aes_sm3_pagestore_create(&io);
+}
+
+void aes_sm3_pagestore_destroy(aes_sm3_pagestore_t* ps) {
+    free(ps);
+}
+
+// 填写尾区后写入一页（page会被就地修改）
+int aes_sm3_pagestore_write(aes_sm3_pagestore_t* ps, uint64_t page_no, uint8_t* page) {
+    aes_sm3_page_seal(page);
+    return ps->io.write(ps->io.ctx, page, 4096, page_no * 4096) == 0 ? 0 : AES_SM3_PAGE_EIO;
+}
+
+// 读取从page_no开始的count个连续页并批量校验
+// 返回0成功，AES_SM3_PAGE_EIO读失败，AES_SM3_PAGE_CORRUPT校验失败（bad_page输出首个损坏页号）
+int aes_sm3_pagestore_read(aes_sm3_pagestore_t* ps, uint64_t page_no, int count, uint8_t* buf,
+                           uint64_t* bad_page) {
+    if (ps->io.read(ps->io.ctx, buf, (size_t)count * 4096, page_no * 4096) != 0) {
+        return AES_SM3_PAGE_EIO;
+    }
+    
+    const uint8_t* stack_pages[AES_SM3_JOB_PAGES];
+    for (int base = 0; base < count; base += AES_SM3_JOB_PAGES) {
+        int n = count - base < AES_SM3_JOB_PAGES ? count - base : AES_SM3_JOB_PAGES;
+        for (int i = 0; i < n; i++) {
+            stack_pages[i] = buf + (size_t)(base + i) * 4096;
+        }
+        int first_bad;
+        if (aes_sm3_page_verify_batch(stack_pages, n, &first_bad) > 0) {
+            atomic_fetch_add_explicit(&ps->checksum_failures, 1, memory_order_relaxed);
+            USDT_PROBE2(verify_mismatch, AES_SM3_MISMATCH_PAGE, page_no + base + first_bad);
+            if (bad_page) *bad_page = page_no + base + first_bad;
+            return AES_SM3_PAGE_CORRUPT;
+        }
+    }
+    return 0;
+}
+
+unsigned long long aes_sm3_pagestore_checksum_failures(const aes_sm3_pagestore_t* ps) {
+    return atomic_load_explicit(&ps->checksum_failures, memory_order_relaxed);
+}
+
+// 合成B树负载基准：内存后备存储，比较裸读写与带校验垫片的每秒操作数
+// 3层树（根、64个内部页、8192个叶页）；每个操作为一次点查（3次单页读），
+// 每4个操作更新一次叶页，每8个操作做一次16个叶页的范围扫描（一次多页读）
+typedef struct {
+    uint8_t* base;
+} btree_mem_store_t;
+
+static int btree_mem_read(void* ctx, void* buf, size_t length, uint64_t offset) {
+    memcpy(buf, ((btree_mem_store_t*)ctx)->base + offset, length);
+    return 0;
+}
+
+static int btree_mem_write(void* ctx, const void* buf, size_t length, uint64_t offset) {
+    memcpy(((btree_mem_store_t*)ctx)->base + offset, buf, length);
+    return 0;
+}
+
+static double btree_workload(aes_sm3_pagestore_t* ps, const aes_sm3_page_io_t* raw, int ops,
+                             uint8_t* scratch) {
+    const uint64_t internal_first = 1, leaf_first = 65, leaf_count = 8192;
+    unsigned int rng = 12345;
+    struct timespec start, end;
+    
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int op = 0; op < ops; op++) {
+        rng = rng * 1103515245u + 12345u;
+        uint64_t leaf = (rng >> 4) % leaf_count;
+        uint64_t path[3] = { 0, internal_first + leaf / 128, leaf_first + leaf };
+        
+        for (int level = 0; level < 3; level++) {
+            if (ps != NULL) {
+                aes_sm3_pagestore_read(ps, path[level], 1, scratch, NULL);
+            } else {
+                raw->read(raw->ctx, scratch, 4096, path[level] * 4096);
+            }
+        }
+        if (op % 4 == 0) {
+            scratch[op % AES_SM3_PAGE_PAYLOAD] ^= 0x01;
+            if (ps != NULL) {
+                aes_sm3_pagestore_write(ps, path[2], scratch);
+            } else {
+                raw->write(raw->ctx, scratch, 4096, path[2] * 4096);
+            }
+        }
+        if (op % 8 == 0) {
+            uint64_t first = leaf_first + (leaf < leaf_count - 16 ? leaf : leaf_count - 16);
+            if (ps != NULL) {
+                aes_sm3_pagestore_read(ps, first, 16, scratch, NULL);
+            } else {
+                raw->read(raw->ctx, scratch, 16 * 4096, first * 4096);
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return ops / ((end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+}
+
+void aes_sm3_pagestore_benchmark(void) {
+    const size_t page_total = 1 + 64 + 8192;
+    const int ops = 200000;
+    btree_mem_store_t store;
+    store.base = aligned_alloc(4096, page_total * 4096);
+    uint8_t* scratch = aligned_alloc(4096, 16 * 4096);
+    if (store.base == NULL || scratch == NULL) {
+        free(store.base);
+        free(scratch);
+        return;
+    }
+    for (size_t i = 0; i < page_total * 4096; i++) {
+        store.base[i] = (uint8_t)(i * 29 + i / 4096);
+    }
+    
+    aes_sm3_page_io_t io = { btree_mem_read, btree_mem_write, &store };
+    aes_sm3_pagestore_t* ps = aes_sm3_pagestore_create(&io);
+    
+    double raw_ops = btree_workload(NULL, &io, ops, scratch);
+    // 裸写入的页没有尾区摘要，校验前统一填写
+    for (size_t p = 0; p < page_total; p++) {
+        aes_sm3_page_seal(store.base + p * 4096);
+    }
+    double checked_ops = btree_workload(ps, &io, ops, scratch);
+    
+    printf("合成B树负载 (%zu页, %d次操作: 点查/更新/16页范围扫描):\n", page_total, ops);
+    printf("  无校验:   %.0f ops/s\n", raw_ops);
+    printf("  页校验:   %.0f ops/s (开销 %.1f%%)\n", checked_ops,
+           (raw_ops / checked_ops - 1.0) * 100.0);
+    printf("  校验失败: %llu\n", aes_sm3_pagestore_checksum_failures(ps));
+    
+    aes_sm3_pagestore_destroy(ps);
+    free(store.base);
+    free(scratch);
+}
+
+// ============================================================================
+// 管道流式校验（stdin -> stdout 透传，摘要写入旁路描述符）
+// ============================================================================
+/*
+ * 命令行在管道中使用时（producer | aes_sm3_integrity - | consumer），数据原样
+ * 透传到stdout，每个4KB页（末尾不足一页补零）的摘要以“页号 十六进制摘要”
+ * 文本行写入旁路描述符。按输入输出类型选择路径，尽量只读一遍内存：
+ * - stdin为普通文件：mmap后直接哈希，stdout为管道时vmsplice映射页，
+ *   否则sendfile，数据不经过用户态复制
+ * - stdin和stdout均为管道：tee()在内核中复制管道缓冲区给stdout，
+ *   再read()一次用于哈希
+ * - 其他情况：read()到环形缓冲区，哈希后write()透传。不使用vmsplice：
+ *   未带SPLICE_F_GIFT的vmsplice只引用用户页，环形缓冲区复用时管道中尚未
+ *   被下游读走的数据会被覆盖
+ */
+
+#define AES_SM3_STREAM_CHUNK (64 * 4096)
+#define AES_SM3_STREAM_WINDOW (64UL * 1024 * 1024)
+
+typedef struct {
+    int digest_fd;
+    uint64_t page_index;
+    size_t out_len;
+    char out[16384];
+} stream_digest_t;
+
+static int stream_flush(stream_digest_t* sd) {
+    size_t done = 0;
+    while (done < sd->out_len) {
+        ssize_t n = write(sd->digest_fd, sd->out + done, sd->out_len - done);
+        if (n <= 0) {
+            return -1;
+        }
+        done += n;
+    }
+    sd->out_len = 0;
+    return 0;
+}
+
+static int stream_emit(stream_digest_t* sd, const uint8_t* digest) {
+    static const char hex[] = "0123456789abcdef";
+    if (sd->out_len + 96 > sizeof(sd->out) && stream_flush(sd) != 0) {
+        return -1;
+    }
+    char* p = sd->out + sd->out_len;
+    p += sprintf(p, "%llu ", (unsigned long long)sd->page_index++);
+    for (int i = 0; i < 32; i++) {
+        *p++ = hex[digest[i] >> 4];
+        *p++ = hex[digest[i] & 0xF];
+    }
+    *p++ = '\n';
+    sd->out_len = p - sd->out;
+    return 0;
+}
+
+// 哈希连续的整页并输出摘要
+static int stream_hash_pages(stream_digest_t* sd, const uint8_t* data, size_t pages) {
+    const uint8_t* inputs[AES_SM3_JOB_PAGES];
+    uint8_t* outputs[AES_SM3_JOB_PAGES];
+    uint8_t digests[AES_SM3_JOB_PAGES * 32];
+    
+    for (size_t base = 0; base < pages; base += AES_SM3_JOB_PAGES) {
+        int n = pages - base < AES_SM3_JOB_PAGES ? (int)(pages - base) : AES_SM3_JOB_PAGES;
+        for (int i = 0; i < n; i++) {
+            inputs[i] = data + (base + i) * 4096;
+            outputs[i] = digests + i * 32;
+        }
+        aes_sm3_integrity_batch(inputs, outputs, n);
+        for (int i = 0; i < n; i++) {
+            if (stream_emit(sd, outputs[i]) != 0) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+// 流末尾不足一页的数据按补零哈希
+static int stream_hash_tail(stream_digest_t* sd, const uint8_t* data, size_t length) {
+    if (length == 0) {
+        return 0;
+    }
+    uint8_t digest[32];
+    uint8_t* output = digest;
+    aes_sm3_integrity_batch_mixed(&data, &length, &output, 1);
+    return stream_emit(sd, digest);
+}
+
+static int stream_write_all(int fd, const uint8_t* data, size_t length, int out_is_pipe) {
+    while (length > 0) {
+        ssize_t n;
+        if (out_is_pipe) {
+            struct iovec iov = { (void*)data, length };
+            n = vmsplice(fd, &iov, 1, 0);
+        } else {
+            n = write(fd, data, length);
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        data += n;
+        length -= n;
+    }
+    return 0;
+}
+
+// stdin为普通文件：分窗口mmap，哈希后vmsplice/sendfile透传
+static long long stream_from_file(int in_fd, int out_fd, int out_is_pipe, stream_digest_t* sd) {
+    struct stat st;
+    off_t start = lseek(in_fd, 0, SEEK_CUR);
+    if (fstat(in_fd, &st) != 0 || start < 0 || (start & 4095) != 0) {
+        return -1;
+    }
+    
+    long long total = 0;
+    for (off_t offset = start; offset < st.st_size; offset += AES_SM3_STREAM_WINDOW) {
+        size_t length = st.st_size - offset < (off_t)AES_SM3_STREAM_WINDOW
+                            ? (size_t)(st.st_size - offset) : AES_SM3_STREAM_WINDOW;
+        const uint8_t* map = mmap(NULL, length, PROT_READ, MAP_SHARED, in_fd, offset);
+        if (map == MAP_FAILED) {
+            return -1;
+        }
+        madvise((void*)map, length, MADV_SEQUENTIAL);
+        
+        int failed = stream_hash_pages(sd, map, length / 4096) != 0 ||
+                     stream_hash_tail(sd, map + (length & ~4095UL), length & 4095) != 0;
+        if (!failed && out_is_pipe) {
+            failed = stream_write_all(out_fd, map, length, 1) != 0;
+        } else if (!failed) {
+            off_t pos = offset;
+            size_t left = length;
+            while (left > 0) {
+                ssize_t n = sendfile(out_fd, in_fd, &pos, left);
+                if (n <= 0) {
+                    // sendfile不可用时退回普通写
+                    failed = stream_write_all(out_fd, map + (length - left), left, 0) != 0;
+                    break;
+                }
+                left -= n;
+            }
+        }
+        munmap((void*)map, length);
+        if (failed) {
+            return -1;
+        }
+        total += length;
+    }
+    return total;
+}
+
+// 通用路径：read到环形缓冲区，整页即哈希，数据按读到的粒度透传
+// use_tee时数据已由tee()送往stdout，这里只负责消费和哈希
+static long long stream_from_pipe(int in_fd, int out_fd, int use_tee, stream_digest_t* sd) {
+    size_t ring_size = 4 * 1024 * 1024;
+    uint8_t* ring = aligned_alloc(4096, ring_size);
+    if (ring == NULL) {
+        return -1;
+    }
+    
+    long long total = 0;
+    size_t pos = 0, hashed = 0;
+    int failed = 0;
+    for (;;) {
+        size_t want = ring_size - pos < AES_SM3_STREAM_CHUNK ? ring_size - pos : AES_SM3_STREAM_CHUNK;
+        if (use_tee) {
+            ssize_t dup = tee(in_fd, out_fd, want, 0);
+            if (dup < 0) {
+                failed = 1;
+                break;
+            }
+            want = dup;
+            if (dup == 0) {
+                break;
+            }
+        }
+        
+        size_t got = 0;
+        while (got < want) {
+            ssize_t n = read(in_fd, ring + pos + got, want - got);
+            if (n <= 0) {
+                failed = (n < 0) || use_tee;
+                break;
+            }
+            got += n;
+            if (!use_tee) {
+                break;  // 非tee模式读到多少处理多少，不额外等待
+            }
+        }
+        if (failed || got == 0) {
+            break;
+        }
+        if (!use_tee && stream_write_all(out_fd, ring + pos, got, 0) != 0) {
+            failed = 1;
+            break;
+        }
+        pos += got;
+        total += got;
+        
+        size_t pages = (pos - hashed) / 4096;
+        if (pages > 0 && stream_hash_pages(sd, ring + hashed, pages) != 0) {
+            failed = 1;
+            break;
+        }
+        hashed += pages * 4096;
+        if (pos == ring_size) {
+            pos = hashed = 0;
+        }
+    }
+    if (!failed) {
+        failed = stream_hash_tail(sd, ring + hashed, pos - hashed) != 0;
+    }
+    free(ring);
+    return failed ? -1 : total;
+}
+
+// 把in_fd的数据原样透传到out_fd，同时把每页摘要写入digest_fd
+// 返回透传的字节数，失败返回-1
+long long aes_sm3_stream_tee(int in_fd, int out_fd, int digest_fd) {
+    struct stat in_st, out_st;
+    if (fstat(in_fd, &in_st) != 0 || fstat(out_fd, &out_st) != 0) {
+        return -1;
+    }
+    int out_is_pipe = S_ISFIFO(out_st.st_mode);
+    
+    stream_digest_t* sd = malloc(sizeof(stream_digest_t));
+    if (sd == NULL) {
+        return -1;
+    }
+    sd->digest_fd = digest_fd;
+    sd->page_index = 0;
+    sd->out_len = 0;
+    
+    long long total = -1;
+    if (S_ISREG(in_st.st_mode)) {
+        total = stream_from_file(in_fd, out_fd, out_is_pipe, sd);
+    }
+    if (total < 0 && sd->page_index == 0) {
+        int use_tee = S_ISFIFO(in_st.st_mode) && out_is_pipe;
+        total = stream_from_pipe(in_fd, out_fd, use_tee, sd);
+    }
+    if (stream_flush(sd) != 0) {
+        total = -1;
+    }
+    free(sd);
+    return total;
+}
+
+// ============================================================================
+// 大页效果基准（dTLB缺失与吞吐对比）
+// ============================================================================
+
+// 打开当前进程（含之后创建的线程）的硬件计数器，不可用时返回-1
+static int perf_counter_open(uint32_t type, uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static long long perf_counter_read(int fd) {
+    long long value = 0;
+    if (fd < 0 || read(fd, &value, sizeof(value)) != sizeof(value)) {
+        return -1;
+    }
+    return value;
+}
+
+typedef struct {
+    double mbps;
+    long long tlb_misses;
+} hugepage_result_t;
+
+// kernel: 0 = hyper单块, 1 = 批处理, 2 = 多线程并行
+static hugepage_result_t hugepage_run(const uint8_t* buffer, uint8_t* output, int pages,
+                                      int kernel, int num_threads) {
+    hugepage_result_t r;
+    int fd = perf_counter_open(PERF_TYPE_HW_CACHE,
+                               PERF_COUNT_HW_CACHE_DTLB |
+                               (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                               (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    struct timespec start, end;
+    
+    if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (kernel == 0) {
+        for (int i = 0; i < pages; i++) {
+            aes_sm3_integrity_256bit_hyper(buffer + (size_t)i * 4096, output + (size_t)i * 32);
+        }
+    } else if (kernel == 1) {
+        const uint8_t* inputs[AES_SM3_JOB_PAGES];
+        uint8_t* outputs[AES_SM3_JOB_PAGES];
+        for (int base = 0; base < pages; base += AES_SM3_JOB_PAGES) {
+            int n = pages - base < AES_SM3_JOB_PAGES ? pages - base : AES_SM3_JOB_PAGES;
+            for (int i = 0; i < n; i++) {
+                inputs[i] = buffer + (size_t)(base + i) * 4096;
+                outputs[i] = output + (size_t)(base + i) * 32;
+            }
+            aes_sm3_integrity_batch(inputs, outputs, n);
+        }
+    } else {
+        aes_sm3_parallel(buffer, output, pages, num_threads, 256);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+    
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    r.mbps = pages * 4.0 / 1024.0 / elapsed;
+    r.tlb_misses = perf_counter_read(fd);
+    if (fd >= 0) {
+        close(fd);
+    }
+    return r;
+}
+
+void aes_sm3_hugepage_benchmark(void) {
+    const size_t size = 256UL * 1024 * 1024;
+    const int pages = size / 4096;
+    int num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int kind = AES_SM3_BUFFER_NORMAL;
+    
+    // 基线：普通4KB页，显式关闭透明大页
+    uint8_t* normal = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    uint8_t* huge = aes_sm3_buffer_alloc(size, &kind);
+    uint8_t* output = malloc((size_t)pages * 32);
+    if (normal == MAP_FAILED || huge == NULL || output == NULL) {
+        printf("缓冲区分配失败，跳过大页测试\n");
+        if (normal != MAP_FAILED) munmap(normal, size);
+        aes_sm3_buffer_free(huge, size);
+        free(output);
+        return;
+    }
+#if defined(MADV_NOHUGEPAGE)
+    madvise(normal, size, MADV_NOHUGEPAGE);
+#endif
+    memset(normal, 0x3C, size);
+    memset(huge, 0x3C, size);
+    
+    static const char* kind_names[] = { "普通页", "透明大页(THP)", "显式大页(HUGETLB)" };
+    static const char* kernel_names[] = { "hyper单块", "批处理", "多线程并行" };
+    printf("缓冲区: %zu MB, 大页分配结果: %s\n\n", size >> 20, kind_names[kind]);
+    printf("%-12s %14s %14s %16s %16s\n", "内核", "4KB页 MB/s", "大页 MB/s", "4KB页dTLB缺失", "大页dTLB缺失");
+    
+    for (int kernel = 0; kernel < 3; kernel++) {
+        hugepage_result_t a = hugepage_run(normal, output, pages, kernel, num_threads);
+        hugepage_result_t b = hugepage_run(huge, output, pages, kernel, num_threads);
+        if (a.tlb_misses >= 0 && b.tlb_misses >= 0) {
+            printf("%-12s %14.2f %14.2f %16lld %16lld\n", kernel_names[kernel],
+                   a.mbps, b.mbps, a.tlb_misses, b.tlb_misses);
+        } else {
+            printf("%-12s %14.2f %14.2f %16s %16s\n", kernel_names[kernel],
+                   a.mbps, b.mbps, "不可用", "不可用");
+        }
+    }
+    
+    munmap(normal, size);
+    aes_sm3_buffer_free(huge, size);
+    free(output);
+}
+
+// ============================================================================
+// 非临时（流式）加载折叠内核
+// ============================================================================
+/*
+ * 巡检、文件哈希等负载对每页只读一次，普通加载配合高时间局部性预取会把
+ * 同机其他服务的热数据挤出末级缓存。流式模式改用非临时提示：
+ * - ARM：prfm pldl1strm 提前预取，ldnp 成对加载（提示数据不必保留）
+ * - x86：prefetchnta 提前预取（MOVNTDQA 仅对写合并内存有效，普通内存上
+ *   与普通加载相同，因此不采用）
+ * 结果与普通模式完全一致，模式可逐次调用选择。
+ */
+
+#define AES_SM3_LOAD_TEMPORAL 0
+#define AES_SM3_LOAD_STREAMING 1
+#define AES_SM3_STREAM_PREFETCH_AHEAD 1024
+
+#if defined(__ARM_FEATURE_CRYPTO) && defined(__aarch64__)
+static inline void ldnp_q(const uint8_t* p, uint8x16_t* a, uint8x16_t* b) {
+    __asm__ volatile("ldnp %q0, %q1, [%2]" : "=w"(*a), "=w"(*b) : "r"(p) : "memory");
+}
+#endif
+
+// 流式折叠：4KB -> 128B，与xor_fold_4kb结果一致
+static inline void xor_fold_4kb_stream(const uint8_t* input, uint8_t* compressed) {
+    for (int i = 0; i < 16; i++) {
+        const uint8_t* block = input + i * 256;
+        const uint8_t* ahead = block + AES_SM3_STREAM_PREFETCH_AHEAD;
+#if defined(__ARM_FEATURE_CRYPTO) && defined(__aarch64__)
+        if (i < 12) {
+            __asm__ volatile("prfm pldl1strm, [%0]\n\t"
+                             "prfm pldl1strm, [%0, #64]\n\t"
+                             "prfm pldl1strm, [%0, #128]\n\t"
+                             "prfm pldl1strm, [%0, #192]" :: "r"(ahead));
+        }
+        uint8x16_t v[16];
+        for (int k = 0; k < 8; k++) {
+            ldnp_q(block + k * 32, &v[2 * k], &v[2 * k + 1]);
+        }
+        uint8x16_t x0 = veorq_u8(veorq_u8(v[0], v[1]), veorq_u8(v[2], v[3]));
+        uint8x16_t x1 = veorq_u8(veorq_u8(v[4], v[5]), veorq_u8(v[6], v[7]));
+        uint8x16_t x2 = veorq_u8(veorq_u8(v[8], v[9]), veorq_u8(v[10], v[11]));
+        uint8x16_t x3 = veorq_u8(veorq_u8(v[12], v[13]), veorq_u8(v[14], v[15]));
+        vst1_u8(compressed + i * 8, vget_low_u8(veorq_u8(veorq_u8(x0, x1), veorq_u8(x2, x3))));
+#else
+        if (i < 12) {
+            for (int line = 0; line < 256; line += 64) {
+                __builtin_prefetch(ahead + line, 0, 0);
+            }
+        }
+        xor_fold_segment(block, compressed + i * 8);
+#endif
+    }
+}
+
+// 单页哈希，mode选择普通/流式加载
+void aes_sm3_integrity_256bit_mode(const uint8_t* input, uint8_t* output, int mode) {
+    if (mode != AES_SM3_LOAD_STREAMING) {
+        aes_sm3_integrity_256bit(input, output);
+        return;
+    }
+    uint8_t compressed[128] __attribute__((aligned(64)));
+    uint32_t state[8];
+    STAT_KERNEL(AES_SM3_KERNEL_STREAMING, 1);
+    xor_fold_4kb_stream(input, compressed);
+    sm3_hash_compressed(compressed, state);
+    sm3_store_state(state, output, 8);
+}
+
+// 流式加载的批处理：对后续页使用非临时预取
+static void integrity_batch_stream(const uint8_t** inputs, uint8_t** outputs, int batch_size, int words) {
+    uint8_t compressed[AES_SM3_JOB_PAGES * 128] __attribute__((aligned(64)));
+    uint8_t* compressed_ptrs[AES_SM3_JOB_PAGES];
+    
+    for (int base = 0; base < batch_size; base += AES_SM3_JOB_PAGES) {
+        int n = batch_size - base < AES_SM3_JOB_PAGES ? batch_size - base : AES_SM3_JOB_PAGES;
+        TRACE_BEGIN(fold_start);
+        for (int i = 0; i < n; i++) {
+            if (base + i + 1 < batch_size) {
+                __builtin_prefetch(inputs[base + i + 1], 0, 0);
+            }
+            compressed_ptrs[i] = compressed + i * 128;
+            xor_fold_4kb_stream(inputs[base + i], compressed_ptrs[i]);
+        }
+        TRACE_END(fold_start, "fold", n);
+        TRACE_BEGIN(sm3_start);
+        batch_sm3_hash_words((const uint8_t**)compressed_ptrs, outputs + base, n, words);
+        TRACE_END(sm3_start, "sm3", n);
+    }
+}
+
+// 批处理哈希，mode选择普通/流式加载
+void aes_sm3_integrity_batch_mode(const uint8_t** inputs, uint8_t** outputs, int batch_size,
+                                  int mode) {
+    if (mode != AES_SM3_LOAD_STREAMING) {
+        aes_sm3_integrity_batch(inputs, outputs, batch_size);
+        return;
+    }
+    STAT_KERNEL(AES_SM3_KERNEL_STREAMING, batch_size);
+    STAT_BATCH(batch_size);
+    USDT_PROBE2(batch_start, AES_SM3_KERNEL_STREAMING, batch_size);
+    USDT_CYCLES_BEGIN(usdt_start, batch_end);
+    integrity_batch_stream(inputs, outputs, batch_size, 8);
+    USDT_PROBE3(batch_end, AES_SM3_KERNEL_STREAMING, batch_size, USDT_CYCLES_SINCE(usdt_start));
+}
+
+// 128位输出的批处理哈希，摘要以16字节步长紧密写入output
+void aes_sm3_integrity_batch_mode_128bit(const uint8_t** inputs, uint8_t* output, int batch_size,
+                                         int mode) {
+    if (mode != AES_SM3_LOAD_STREAMING) {
+        aes_sm3_integrity_batch_128bit(inputs, output, batch_size);
+        return;
+    }
+    STAT_KERNEL(AES_SM3_KERNEL_STREAMING, batch_size);
+    STAT_BATCH(batch_size);
+    USDT_PROBE2(batch_start, AES_SM3_KERNEL_STREAMING, batch_size);
+    USDT_CYCLES_BEGIN(usdt_start, batch_end);
+    batch_packed_128(integrity_batch_stream, inputs, output, batch_size);
+    USDT_PROBE3(batch_end, AES_SM3_KERNEL_STREAMING, batch_size, USDT_CYCLES_SINCE(usdt_start));
+}
+
+// 邻居进程：在约半个末级缓存大小的工作集上做随机指针追逐，统计每遍耗时
+typedef struct {
+    atomic_int stop;
+    atomic_int ready;
+    atomic_ullong passes;
+    atomic_ullong nanoseconds;
+} llc_neighbour_t;
+
+static void llc_neighbour_run(llc_neighbour_t* shared, size_t working_set) {
+    size_t lines = working_set / 64;
+    uint64_t* ring = aligned_alloc(64, lines * 64);
+    if (ring == NULL) {
+        _exit(1);
+    }
+    // 随机单环排列，避免硬件预取
+    for (size_t i = 0; i < lines; i++) {
+        ring[i * 8] = i;
+    }
+    unsigned int rng = 7;
+    for (size_t i = lines - 1; i > 0; i--) {
+        rng = rng * 1103515245u + 12345u;
+        size_t j = (rng >> 4) % i;
+        uint64_t t = ring[i * 8]; ring[i * 8] = ring[j * 8]; ring[j * 8] = t;
+    }
+    uint64_t* order = malloc(lines * sizeof(uint64_t));
+    if (order == NULL) {
+        _exit(1);
+    }
+    for (size_t i = 0; i < lines; i++) {
+        order[i] = ring[i * 8];
+    }
+    for (size_t i = 0; i < lines; i++) {
+        ring[order[i] * 8] = order[(i + 1) % lines];
+    }
+    free(order);
+    
+    atomic_store(&shared->ready, 1);
+    uint64_t cursor = 0;
+    while (!atomic_load_explicit(&shared->stop, memory_order_relaxed)) {
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (size_t i = 0; i < lines; i++) {
+            cursor = ring[cursor * 8];
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        atomic_fetch_add(&shared->nanoseconds,
+                         (end.tv_sec - start.tv_sec) * 1000000000ULL + end.tv_nsec - start.tv_nsec);
+        atomic_fetch_add(&shared->passes, 1);
+    }
+    _exit(cursor == UINT64_MAX);
+}
+
+// 在邻居运行期间执行一轮哈希（mode < 0 表示哈希进程空闲），返回哈希吞吐，
+// neighbour_ns输出邻居每遍平均耗时
+static double llc_pollution_round(llc_neighbour_t* shared, const uint8_t* buffer, uint8_t* output,
+                                  int pages, int mode, double* neighbour_ns) {
+    const uint8_t* inputs[AES_SM3_JOB_PAGES];
+    uint8_t* outputs[AES_SM3_JOB_PAGES];
+    struct timespec start, end;
+    
+    atomic_store(&shared->passes, 0);
+    atomic_store(&shared->nanoseconds, 0);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (mode < 0) {
+        usleep(200000);
+    } else {
+        for (int base = 0; base < pages; base += AES_SM3_JOB_PAGES) {
+            int n = pages - base < AES_SM3_JOB_PAGES ? pages - base : AES_SM3_JOB_PAGES;
+            for (int i = 0; i < n; i++) {
+                inputs[i] = buffer + (size_t)(base + i) * 4096;
+                outputs[i] = output + (size_t)i * 32;
+            }
+            aes_sm3_integrity_batch_mode(inputs, outputs, n, mode);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    
+    unsigned long long passes = atomic_load(&shared->passes);
+    *neighbour_ns = passes > 0 ? (double)atomic_load(&shared->nanoseconds) / passes : 0.0;
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    return pages * 4.0 / 1024.0 / elapsed;
+}
+
+void aes_sm3_streaming_benchmark(void) {
+    long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (llc <= 0) {
+        llc = 8L * 1024 * 1024;
+    }
+    // 邻居工作集取末级缓存的一半，上限16MB，保证测量窗口内能完成多遍
+    size_t working_set = llc / 2 < 16L * 1024 * 1024 ? llc / 2 : 16L * 1024 * 1024;
+    const int pages = 65536;  // 256MB，远大于末级缓存
+    
+    uint8_t* buffer = aes_sm3_buffer_alloc((size_t)pages * 4096, NULL);
+    uint8_t* output = malloc(AES_SM3_JOB_PAGES * 32);
+    llc_neighbour_t* shared = mmap(NULL, sizeof(llc_neighbour_t), PROT_READ | PROT_WRITE,
+                                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (buffer == NULL || output == NULL || shared == MAP_FAILED) {
+        printf("缓冲区分配失败，跳过流式加载测试\n");
+        aes_sm3_buffer_free(buffer, (size_t)pages * 4096);
+        free(output);
+        return;
+    }
+    memset(buffer, 0x6B, (size_t)pages * 4096);
+    memset(shared, 0, sizeof(*shared));
+    
+    pid_t child = fork();
+    if (child == 0) {
+        llc_neighbour_run(shared, working_set);
+    }
+    // 邻居初始化失败会直接退出，等待就绪时同时检查其是否已结束
+    int neighbour_failed = 0;
+    while (child > 0 && !atomic_load(&shared->ready)) {
+        if (waitpid(child, NULL, WNOHANG) == child) {
+            neighbour_failed = 1;
+            break;
+        }
+        usleep(1000);
+    }
+    
+    if (neighbour_failed) {
+        printf("邻居进程初始化失败，跳过流式加载测试\n");
+    } else if (child > 0) {
+        double idle_ns, temporal_ns, streaming_ns;
+        llc_pollution_round(shared, buffer, output, pages, -1, &idle_ns);
+        double temporal = llc_pollution_round(shared, buffer, output, pages,
+                                              AES_SM3_LOAD_TEMPORAL, &temporal_ns);
+        double streaming = llc_pollution_round(shared, buffer, output, pages,
+                                               AES_SM3_LOAD_STREAMING, &streaming_ns);
+        
+        printf("邻居进程工作集: %zu KB（末级缓存 %ld KB），哈希数据: %d MB\n",
+               working_set >> 10, llc >> 10, pages / 256);
+        if (idle_ns <= 0.0 || temporal_ns <= 0.0 || streaming_ns <= 0.0) {
+            printf("  测量窗口内邻居未完成遍历（CPU不足），缓存污染结果不可用\n");
+        }
+        printf("  邻居空闲基线:   %.0f ns/遍\n", idle_ns);
+        printf("  普通加载:       哈希 %.2f MB/s, 邻居 %.0f ns/遍 (%.2fx)\n",
+               temporal, temporal_ns, idle_ns > 0 ? temporal_ns / idle_ns : 0.0);
+        printf("  流式加载:       哈希 %.2f MB/s, 邻居 %.0f ns/遍 (%.2fx)\n",
+               streaming, streaming_ns, idle_ns > 0 ? streaming_ns / idle_ns : 0.0);
+        
+        atomic_store(&shared->stop, 1);
+        waitpid(child, NULL, 0);
+    } else {
+        printf("无法创建邻居进程，跳过流式加载测试\n");
+    }
+    
+    munmap(shared, sizeof(llc_neighbour_t));
+    aes_sm3_buffer_free(buffer, (size_t)pages * 4096);
+    free(output);
+}
+
+// ============================================================================
+// 运行时统计：快照、合并与Prometheus导出
+// ============================================================================
+/*
+ * 计数块登记在全局链表中，只有登记、线程退出和快照会取锁。
+ * 快照读取的是各线程计数的近似一致视图：单个计数不会撕裂，
+ * 但不同计数之间可能相差正在执行中的几次更新。
+ * 导出器按固定周期把快照写成Prometheus文本格式（先写临时文件再rename），
+ * 可直接交给node_exporter的textfile收集器。
+ */
+
+#define AES_SM3_STATS_EXPORT_THREADS 256
+
+#if AES_SM3_STATS
+static pthread_mutex_t g_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static stats_block_t* g_stats_threads = NULL;
+static unsigned long long g_stats_retired[AES_SM3_STAT_FIELDS];  // 已退出线程的累计
+static stats_block_t g_stats_fallback;  // 计数块分配失败的线程共用，可能丢失少量计数
+static pthread_key_t g_stats_key;
+static pthread_once_t g_stats_once = PTHREAD_ONCE_INIT;
+static int g_stats_next_id = 0;
+
+static void stats_read_block(stats_block_t* block, unsigned long long* out) {
+    for (size_t i = 0; i < AES_SM3_STAT_FIELDS; i++) {
+        out[i] = atomic_load_explicit(&block->counters[i], memory_order_relaxed);
+    }
+}
+
+// 线程退出：计数并入退役累计后释放计数块
+static void stats_thread_exit(void* arg) {
+    stats_block_t* block = (stats_block_t*)arg;
+    unsigned long long counters[AES_SM3_STAT_FIELDS];
+    
+    pthread_mutex_lock(&g_stats_lock);
+    for (stats_block_t** pp = &g_stats_threads; *pp != NULL; pp = &(*pp)->next) {
+        if (*pp == block) {
+            *pp = block->next;
+            break;
+        }
+    }
+    stats_read_block(block, counters);
+    for (size_t i = 0; i < AES_SM3_STAT_FIELDS; i++) {
+        g_stats_retired[i] += counters[i];
+    }
+    pthread_mutex_unlock(&g_stats_lock);
+    
+    tls_stats = NULL;
+    free(block);
+}
+
+static void stats_key_init(void) {
+    pthread_key_create(&g_stats_key, stats_thread_exit);
+}
+
+static stats_block_t* stats_register(void) {
+    pthread_once(&g_stats_once, stats_key_init);
+    
+    stats_block_t* block = aligned_alloc(AES_SM3_CACHE_LINE, sizeof(stats_block_t));
+    if (block == NULL) {
+        tls_stats = &g_stats_fallback;
+        return tls_stats;
+    }
+    for (size_t i = 0; i < AES_SM3_STAT_FIELDS; i++) {
+        atomic_init(&block->counters[i], 0);
+    }
+    
+    pthread_mutex_lock(&g_stats_lock);
+    block->thread_id = g_stats_next_id++;
+    block->next = g_stats_threads;
+    g_stats_threads = block;
+    pthread_mutex_unlock(&g_stats_lock);
+    
+    pthread_setspecific(g_stats_key, block);
+    tls_stats = block;
+    return block;
+}
+#endif
+
+int aes_sm3_stats_enabled(void) {
+    return AES_SM3_STATS;
+}
+
+void aes_sm3_stats_merge(aes_sm3_stats_t* dst, const aes_sm3_stats_t* src) {
+    unsigned long long* d = (unsigned long long*)dst;
+    const unsigned long long* s = (const unsigned long long*)src;
+    for (size_t i = 0; i < AES_SM3_STAT_FIELDS; i++) {
+        d[i] += s[i];
+    }
+}
+
+// 同一次加锁内读取合计与退役部分（retired含已退出线程和共用的后备计数块）
+static int stats_collect(aes_sm3_stats_t* total, aes_sm3_stats_t* retired, aes_sm3_stats_t* per_thread,
+                         int* thread_ids, int max_threads) {
+    if (total != NULL) {
+        memset(total, 0, sizeof(aes_sm3_stats_t));
+    }
+    if (retired != NULL) {
+        memset(retired, 0, sizeof(aes_sm3_stats_t));
+    }
+#if AES_SM3_STATS
+    aes_sm3_stats_t sum;
+    aes_sm3_stats_t current;
+    int count = 0;
+    
+    pthread_mutex_lock(&g_stats_lock);
+    memcpy(&sum, g_stats_retired, sizeof(sum));
+    stats_read_block(&g_stats_fallback, (unsigned long long*)&current);
+    aes_sm3_stats_merge(&sum, &current);
+    if (retired != NULL) {
+        *retired = sum;
+    }
+    for (stats_block_t* block = g_stats_threads; block != NULL; block = block->next) {
+        stats_read_block(block, (unsigned long long*)&current);
+        aes_sm3_stats_merge(&sum, &current);
+        if (count < max_threads) {
+            if (per_thread != NULL) {
+                per_thread[count] = current;
+            }
+            if (thread_ids != NULL) {
+                thread_ids[count] = block->thread_id;
+            }
+        }
+        count++;
+    }
+    pthread_mutex_unlock(&g_stats_lock);
+    
+    if (total != NULL) {
+        *total = sum;
+    }
+    return count;
+#else
+    (void)per_thread;
+    (void)thread_ids;
+    (void)max_threads;
+    return 0;
+#endif
+}
+
+/*
+ * 读取当前统计：total为所有线程（含已退出线程）的合计，per_thread/thread_ids
+ * 最多填写max_threads个存活线程，均可为NULL。返回存活线程数。
+ */
+int aes_sm3_stats_snapshot(aes_sm3_stats_t* total, aes_sm3_stats_t* per_thread,
+                           int* thread_ids, int max_threads) {
+    return stats_collect(total, NULL, per_thread, thread_ids, max_threads);
+}
+
+static void stats_write_histogram(FILE* f, const char* name, const char* help,
+                                  const unsigned long long* hist, const double* bounds,
+                                  int buckets, double sum, unsigned long long count) {
+    unsigned long long cumulative = 0;
+    fprintf(f, "# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+    for (int b = 0; b < buckets - 1; b++) {
+        cumulative += hist[b];
+        fprintf(f, "%s_bucket{le=\"%.9g\"} %llu\n", name, bounds[b], cumulative);
+    }
+    cumulative += hist[buckets - 1];
+    fprintf(f, "%s_bucket{le=\"+Inf\"} %llu\n", name, cumulative);
+    fprintf(f, "%s_sum %.9g\n%s_count %llu\n", name, sum, name, count);
+}
+
+static void stats_write_worker(FILE* f, const char* label, const aes_sm3_stats_t* st) {
+    if (st->busy_ns + st->idle_ns == 0) {
+        return;  // 非工作线程
+    }
+    fprintf(f, "aes_sm3_worker_busy_seconds_total{thread=\"%s\"} %.9f\n", label, st->busy_ns / 1e9);
+    fprintf(f, "aes_sm3_worker_idle_seconds_total{thread=\"%s\"} %.9f\n", label, st->idle_ns / 1e9);
+}
+
+// 把当前快照以Prometheus文本格式原子地写入path，成功返回0
+int aes_sm3_stats_write_prometheus(const char* path) {
+    static const char* const kernel_names[AES_SM3_STAT_KERNELS] = {
+        "256bit", "hyper", "batch", "streaming", "copy", "sector", "large",
+        "extreme", "ultra", "mega", "super",
+        "batch_no_prefetch", "batch_super_prefetch", "batch_pipeline_prefetch"
+    };
+    aes_sm3_stats_t total;
+    aes_sm3_stats_t* threads = malloc(AES_SM3_STATS_EXPORT_THREADS * sizeof(aes_sm3_stats_t));
+    int* ids = malloc(AES_SM3_STATS_EXPORT_THREADS * sizeof(int));
+    size_t path_len = strlen(path);
+    char* tmp_path = malloc(path_len + 8);
+    if (threads == NULL || ids == NULL || tmp_path == NULL) {
+        free(threads);
+        free(ids);
+        free(tmp_path);
+        return -1;
+    }
+    snprintf(tmp_path, path_len + 8, "%s.tmp", path);
+    
+    aes_sm3_stats_t retired;
+    int live = stats_collect(&total, &retired, threads, ids, AES_SM3_STATS_EXPORT_THREADS);
+    int count = live < AES_SM3_STATS_EXPORT_THREADS ? live : AES_SM3_STATS_EXPORT_THREADS;
+    
+    FILE* f = fopen(tmp_path, "w");
+    if (f == NULL) {
+        free(threads);
+        free(ids);
+        free(tmp_path);
+        return -1;
+    }
+    
+    fprintf(f, "# HELP aes_sm3_kernel_calls_total Calls per hashing kernel entry point.\n");
+    fprintf(f, "# TYPE aes_sm3_kernel_calls_total counter\n");
+    for (int k = 0; k < AES_SM3_STAT_KERNELS; k++) {
+        fprintf(f, "aes_sm3_kernel_calls_total{kernel=\"%s\"} %llu\n", kernel_names[k], total.kernel_calls[k]);
+    }
+    fprintf(f, "# HELP aes_sm3_kernel_pages_total 4KB pages hashed per kernel entry point.\n");
+    fprintf(f, "# TYPE aes_sm3_kernel_pages_total counter\n");
+    for (int k = 0; k < AES_SM3_STAT_KERNELS; k++) {
+        fprintf(f, "aes_sm3_kernel_pages_total{kernel=\"%s\"} %llu\n", kernel_names[k], total.kernel_pages[k]);
+    }
+    
+    double batch_bounds[AES_SM3_STAT_BATCH_BUCKETS];
+    for (int b = 0; b < AES_SM3_STAT_BATCH_BUCKETS; b++) {
+        batch_bounds[b] = (double)((2ULL << b) - 1);
+    }
+    stats_write_histogram(f, "aes_sm3_batch_pages", "Pages per batch call.",
+                          total.batch_hist, batch_bounds, AES_SM3_STAT_BATCH_BUCKETS,
+                          (double)total.batch_pages, total.batch_calls);
+    
+    double wait_bounds[AES_SM3_STAT_WAIT_BUCKETS];
+    for (int b = 0; b < AES_SM3_STAT_WAIT_BUCKETS; b++) {
+        wait_bounds[b] = (256.0 * (1ULL << b)) / 1e9;
+    }
+    stats_write_histogram(f, "aes_sm3_queue_wait_seconds", "Time jobs spent in the engine queue.",
+                          total.wait_hist, wait_bounds, AES_SM3_STAT_WAIT_BUCKETS,
+                          total.wait_ns / 1e9, total.jobs);
+    
+    // 工作线程利用率：存活线程逐个输出（超出上限的存活线程合并为other），已退出线程合并为retired
+    fprintf(f, "# HELP aes_sm3_worker_busy_seconds_total Time workers spent executing jobs.\n");
+    fprintf(f, "# TYPE aes_sm3_worker_busy_seconds_total counter\n");
+    fprintf(f, "# HELP aes_sm3_worker_idle_seconds_total Time workers spent waiting for jobs.\n");
+    fprintf(f, "# TYPE aes_sm3_worker_idle_seconds_total counter\n");
+    aes_sm3_stats_t other = total;
+    other.busy_ns -= retired.busy_ns;
+    other.idle_ns -= retired.idle_ns;
+    for (int i = 0; i < count; i++) {
+        char label[16];
+        snprintf(label, sizeof(label), "%d", ids[i]);
+        stats_write_worker(f, label, &threads[i]);
+        other.busy_ns -= threads[i].busy_ns;
+        other.idle_ns -= threads[i].idle_ns;
+    }
+    if (live > count) {
+        stats_write_worker(f, "other", &other);
+    }
+    stats_write_worker(f, "retired", &retired);
+    
+    int ok = !ferror(f);
+    ok &= fclose(f) == 0;
+    if (ok && rename(tmp_path, path) != 0) {
+        ok = 0;
+    }
+    if (!ok) {
+        unlink(tmp_path);
+    }
+    free(threads);
+    free(ids);
+    free(tmp_path);
+    return ok ? 0 : -1;
+}
+
+typedef struct aes_sm3_stats_exporter {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int stop;
+    int interval_ms;
+    char* path;
+} aes_sm3_stats_exporter_t;
+
+static void* stats_exporter_thread(void* arg) {
+    aes_sm3_stats_exporter_t* e = (aes_sm3_stats_exporter_t*)arg;
+    
+    pthread_mutex_lock(&e->lock);
+    while (!e->stop) {
+        pthread_mutex_unlock(&e->lock);
+        aes_sm3_stats_write_prometheus(e->path);
+        
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += e->interval_ms / 1000;
+        deadline.tv_nsec += (long)(e->interval_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        
+        pthread_mutex_lock(&e->lock);
+        while (!e->stop) {
+            if (pthread_cond_timedwait(&e->cond, &e->lock, &deadline) != 0) {
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&e->lock);
+    
+    // 停止前再写一次，保证文件反映最终计数
+    aes_sm3_stats_write_prometheus(e->path);
+    return NULL;
+}
+
+// 启动后台导出线程，每interval_ms毫秒写一次path
+aes_sm3_stats_exporter_t* aes_sm3_stats_exporter_start(const char* path, int interval_ms) {
+    aes_sm3_stats_exporter_t* e = calloc(1, sizeof(aes_sm3_stats_exporter_t));
+    if (e == NULL) {
+        return NULL;
+    }
+    e->path = strdup(path);
+    if (e->path == NULL) {
+        free(e);
+        return NULL;
+    }
+    e->interval_ms = interval_ms > 0 ? interval_ms : 1000;
+    
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&e->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&e->lock, NULL);
+    
+    if (pthread_create(&e->thread, NULL, stats_exporter_thread, e) != 0) {
+        pthread_cond_destroy(&e->cond);
+        pthread_mutex_destroy(&e->lock);
+        free(e->path);
+        free(e);
+        return NULL;
+    }
+    return e;
+}
+
+void aes_sm3_stats_exporter_stop(aes_sm3_stats_exporter_t* e) {
+    if (e == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&e->lock);
+    e->stop = 1;
+    pthread_cond_broadcast(&e->cond);
+    pthread_mutex_unlock(&e->lock);
+    pthread_join(e->thread, NULL);
+    
+    pthread_cond_destroy(&e->cond);
+    pthread_mutex_destroy(&e->lock);
+    free(e->path);
+    free(e);
+}
+
+// ============================================================================
+// 时间线追踪：每线程环形缓冲区与Chrome trace导出
+// ============================================================================
+/*
+ * 每个线程第一次记录区间时取得一个环形缓冲区，只有所属线程写入，写满后
+ * 覆盖最旧的区间。线程退出后缓冲区保留（内容仍可导出），并可被之后新建的
+ * 线程复用，缓冲区数量因此只取决于同时存在的线程数。
+ * 导出的JSON可直接在chrome://tracing或Perfetto中打开，每个缓冲区对应一行。
+ */
+
+#define AES_SM3_TRACE_DEFAULT_SPANS 4096
+
+#if AES_SM3_TRACE
+typedef struct {
+    const char* name;
+    uint64_t start_ns;
+    uint64_t end_ns;
+    int arg;
+} trace_span_t;
+
+typedef struct trace_ring {
+    trace_span_t* spans;
+    size_t mask;
+    atomic_ullong head;     // 已写入的区间总数，只由所属线程推进
+    unsigned long long base;  // aes_sm3_trace_start时的head，之前的区间不导出
+    int tid;
+    int live;
+    char name[32];
+    struct trace_ring* next;
+} trace_ring_t;
+
+static pthread_mutex_t g_trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static trace_ring_t* g_trace_rings = NULL;
+static size_t g_trace_capacity = AES_SM3_TRACE_DEFAULT_SPANS;
+static pthread_key_t g_trace_key;
+static pthread_once_t g_trace_once = PTHREAD_ONCE_INIT;
+static __thread trace_ring_t* tls_trace;
+static __thread int tls_trace_failed;
+
+static void trace_thread_exit(void* arg) {
+    trace_ring_t* ring = (trace_ring_t*)arg;
+    pthread_mutex_lock(&g_trace_lock);
+    ring->live = 0;
+    pthread_mutex_unlock(&g_trace_lock);
+    tls_trace = NULL;
+}
+
+static void trace_key_init(void) {
+    pthread_key_create(&g_trace_key, trace_thread_exit);
+}
+
+static trace_ring_t* trace_register(void) {
+    pthread_once(&g_trace_once, trace_key_init);
+    
+    // 只复用区间已全部在base之前的退出线程缓冲区，避免旧线程的区间被导出到新线程名下
+    pthread_mutex_lock(&g_trace_lock);
+    trace_ring_t* ring = g_trace_rings;
+    while (ring != NULL &&
+           (ring->live || atomic_load_explicit(&ring->head, memory_order_relaxed) != ring->base)) {
+        ring = ring->next;
+    }
+    if (ring != NULL) {
+        atomic_store_explicit(&ring->head, 0, memory_order_relaxed);
+        ring->base = 0;
+    } else {
+        ring = calloc(1, sizeof(trace_ring_t));
+        trace_span_t* spans = ring ? malloc(g_trace_capacity * sizeof(trace_span_t)) : NULL;
+        if (spans == NULL) {
+            free(ring);
+            pthread_mutex_unlock(&g_trace_lock);
+            tls_trace_failed = 1;
+            return NULL;
+        }
+        ring->spans = spans;
+        ring->mask = g_trace_capacity - 1;
+        atomic_init(&ring->head, 0);
+        ring->tid = 1;
+        for (trace_ring_t* r = g_trace_rings; r != NULL; r = r->next) {
+            if (r->tid >= ring->tid) {
+                ring->tid = r->tid + 1;
+            }
+        }
+        ring->next = g_trace_rings;
+        g_trace_rings = ring;
+    }
+    ring->live = 1;
+    if (tls_trace_name[0] != 0) {
+        memcpy(ring->name, tls_trace_name, sizeof(ring->name));
+    } else {
+        snprintf(ring->name, sizeof(ring->name), "thread-%d", ring->tid);
+    }
+    pthread_mutex_unlock(&g_trace_lock);
+    
+    pthread_setspecific(g_trace_key, ring);
+    tls_trace = ring;
+    return ring;
+}
+
+static void trace_record(const char* name, uint64_t start_ns, uint64_t end_ns, int arg) {
+    trace_ring_t* ring = tls_trace;
+    if (__builtin_expect(ring == NULL, 0)) {
+        if (tls_trace_failed || (ring = trace_register()) == NULL) {
+            return;
+        }
+    }
+    unsigned long long head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    trace_span_t* span = &ring->spans[head & ring->mask];
+    span->name = name;
+    span->start_ns = start_ns;
+    span->end_ns = end_ns;
+    span->arg = arg;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+#endif
+
+/*
+ * 开始记录：spans_per_thread向上取2的幂，只作用于之后新建的缓冲区；
+ * 已有缓冲区中此前的区间不再导出。追踪未编译时返回-1。
+ */
+int aes_sm3_trace_start(size_t spans_per_thread) {
+#if AES_SM3_TRACE
+    size_t capacity = 64;
+    while (capacity < spans_per_thread) {
+        capacity <<= 1;
+    }
+    pthread_mutex_lock(&g_trace_lock);
+    if (spans_per_thread > 0) {
+        g_trace_capacity = capacity;
+    }
+    for (trace_ring_t* ring = g_trace_rings; ring != NULL; ring = ring->next) {
+        ring->base = atomic_load_explicit(&ring->head, memory_order_acquire);
+    }
+    pthread_mutex_unlock(&g_trace_lock);
+    atomic_store_explicit(&g_trace_enabled, 1, memory_order_release);
+    return 0;
+#else
+    (void)spans_per_thread;
+    return -1;
+#endif
+}
+
+void aes_sm3_trace_stop(void) {
+#if AES_SM3_TRACE
+    atomic_store_explicit(&g_trace_enabled, 0, memory_order_release);
+#endif
+}
+
+/*
+ * 把所有缓冲区导出为Chrome trace-event JSON（"X"完整事件，时间单位微秒）。
+ * 应在被追踪的调用返回之后导出；仍在写入的线程的最新区间可能不完整。
+ * 返回导出的区间数，失败返回-1。
+ */
+long aes_sm3_trace_dump(const char* path) {
+#if AES_SM3_TRACE
+    FILE* f = fopen(path, "w");
+    if (f == NULL) {
+        return -1;
+    }
+    int pid = (int)getpid();
+    long count = 0;
+    int first = 1;
+    
+    fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    pthread_mutex_lock(&g_trace_lock);
+    for (trace_ring_t* ring = g_trace_rings; ring != NULL; ring = ring->next) {
+        unsigned long long head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        unsigned long long begin = ring->base;
+        if (head - begin > ring->mask + 1) {
+            begin = head - (ring->mask + 1);
+        }
+        fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", pid, ring->tid, ring->name);
+        first = 0;
+        for (unsigned long long i = begin; i < head; i++) {
+            const trace_span_t* span = &ring->spans[i & ring->mask];
+            fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"aes_sm3\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+                       "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"n\":%d}}",
+                    span->name, pid, ring->tid, span->start_ns / 1e3,
+                    (span->end_ns - span->start_ns) / 1e3, span->arg);
+            count++;
+        }
+    }
+    pthread_mutex_unlock(&g_trace_lock);
+    fprintf(f, "\n]}\n");
+    
+    int ok = !ferror(f);
+    ok &= fclose(f) == 0;
+    return ok ? count : -1;
+#else
+    (void)path;
+    return -1;
+#endif
+}
+
+// ============================================================================
+// 能耗基准（RAPL/powercap）
+// ============================================================================
+/*
+ * 在每个内核运行前后读取能量计数器，报告吞吐和每GB能耗。计数器来源：
+ * - /sys/class/powercap/<zone>/energy_uj：x86 RAPL，只取顶层package域
+ *   （子域core/dram已包含在package中，mmio域与package重复）
+ * - /sys/class/hwmon/hwmonN/energyM_input：部分ARM服务器经SCMI/hwmon提供
+ * 计数器是整个插槽的能耗，包含空闲核心，因此同时给出空闲功耗基线。
+ * 没有计数器或无权限读取（energy_uj通常仅root可读）时显示"不可用"。
+ */
+
+#define AES_SM3_ENERGY_MAX_DOMAINS 8
+#define AES_SM3_ENERGY_MIN_SECONDS 0.5   // 每个内核至少运行时长，远大于RAPL约1ms的更新周期
+#define AES_SM3_ENERGY_PAGES 4096        // 16MB工作集
+
+typedef struct {
+    int count;
+    const char* kind;
+    char paths[AES_SM3_ENERGY_MAX_DOMAINS][256];
+    unsigned long long range_uj[AES_SM3_ENERGY_MAX_DOMAINS];  // 回绕范围，0表示未知
+} energy_source_t;
+
+static int read_ull_file(const char* path, unsigned long long* value) {
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        return -1;
+    }
+    int ok = fscanf(f, "%llu", value) == 1;
+    fclose(f);
+    return ok ? 0 : -1;
+}
+
+static void energy_source_open(energy_source_t* src) {
+    glob_t g;
+    unsigned long long value;
+    src->count = 0;
+    src->kind = NULL;
+    
+    if (glob("/sys/class/powercap/*/energy_uj", 0, NULL, &g) == 0) {
+        for (size_t i = 0; i < g.gl_pathc && src->count < AES_SM3_ENERGY_MAX_DOMAINS; i++) {
+            const char* zone = strrchr(g.gl_pathv[i], '/');
+            const char* dir = g.gl_pathv[i] + strlen("/sys/class/powercap/");
+            size_t dir_len = zone - dir;
+            int colons = 0;
+            for (size_t k = 0; k < dir_len; k++) {
+                colons += dir[k] == ':';
+            }
+            if (colons != 1 || strncmp(dir, "intel-rapl-mmio", 15) == 0 ||
+                read_ull_file(g.gl_pathv[i], &value) != 0) {
+                continue;
+            }
+            char range_path[256];
+            snprintf(range_path, sizeof(range_path), "%.*s/max_energy_range_uj",
+                     (int)(zone - g.gl_pathv[i]), g.gl_pathv[i]);
+            snprintf(src->paths[src->count], sizeof(src->paths[0]), "%s", g.gl_pathv[i]);
+            if (read_ull_file(range_path, &src->range_uj[src->count]) != 0) {
+                src->range_uj[src->count] = 0;
+            }
+            src->count++;
+        }
+        globfree(&g);
+        if (src->count > 0) {
+            src->kind = "RAPL";
+            return;
+        }
+    }
+    
+    if (glob("/sys/class/hwmon/hwmon*/energy*_input", 0, NULL, &g) == 0) {
+        for (size_t i = 0; i < g.gl_pathc && src->count < AES_SM3_ENERGY_MAX_DOMAINS; i++) {
+            if (read_ull_file(g.gl_pathv[i], &value) == 0) {
+                snprintf(src->paths[src->count], sizeof(src->paths[0]), "%s", g.gl_pathv[i]);
+                src->range_uj[src->count] = 0;
+                src->count++;
+            }
+        }
+        globfree(&g);
+        if (src->count > 0) {
+            src->kind = "hwmon";
+        }
+    }
+}
+
+static int energy_sample(const energy_source_t* src, unsigned long long* values) {
+    for (int i = 0; i < src->count; i++) {
+        if (read_ull_file(src->paths[i], &values[i]) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// 两次采样之间的总能耗（焦耳），无法处理的回绕返回负数
+static double energy_joules(const energy_source_t* src, const unsigned long long* before,
+                            const unsigned long long* after) {
+    double total = 0.0;
+    for (int i = 0; i < src->count; i++) {
+        if (after[i] >= before[i]) {
+            total += (double)(after[i] - before[i]);
+        } else if (src->range_uj[i] > 0) {
+            total += (double)(after[i] + src->range_uj[i] - before[i]);
+        } else {
+            return -1.0;
+        }
+    }
+    return total / 1e6;
+}
+
+static void energy_run_kernel(int kernel, const uint8_t* buffer, uint8_t* output, int pages) {
+    switch (kernel) {
+    case 0:
+        for (int i = 0; i < pages; i++) {
+            aes_sm3_integrity_256bit(buffer + (size_t)i * 4096, output + (size_t)i * 32);
+        }
+        break;
+    case 1:
+        for (int i = 0; i < pages; i++) {
+            aes_sm3_integrity_256bit_super(buffer + (size_t)i * 4096, output + (size_t)i * 32);
+        }
+        break;
+    case 2:
+        for (int i = 0; i < pages; i++) {
+            aes_sm3_integrity_256bit_hyper(buffer + (size_t)i * 4096, output + (size_t)i * 32);
+        }
+        break;
+    case 3: {
+        const uint8_t* inputs[AES_SM3_JOB_PAGES];
+        uint8_t* outputs[AES_SM3_JOB_PAGES];
+        for (int base = 0; base < pages; base += AES_SM3_JOB_PAGES) {
+            int n = pages - base < AES_SM3_JOB_PAGES ? pages - base : AES_SM3_JOB_PAGES;
+            for (int i = 0; i < n; i++) {
+                inputs[i] = buffer + (size_t)(base + i) * 4096;
+                outputs[i] = output + (size_t)(base + i) * 32;
+            }
+            aes_sm3_integrity_batch(inputs, outputs, n);
+        }
+        break;
+    }
+    default:
+        aes_sm3_parallel(buffer, output, pages, sysconf(_SC_NPROCESSORS_ONLN), 256);
+        break;
+    }
+}
+
+void aes_sm3_energy_benchmark(void) {
+    static const char* kernel_names[] = { "256bit", "super", "hyper", "批处理", "多线程并行" };
+    const int pages = AES_SM3_ENERGY_PAGES;
+    uint8_t* buffer = aligned_alloc(4096, (size_t)pages * 4096);
+    uint8_t* output = malloc((size_t)pages * 32);
+    if (buffer == NULL || output == NULL) {
+        printf("缓冲区分配失败，跳过能耗测试\n");
+        free(buffer);
+        free(output);
+        return;
+    }
+    for (size_t i = 0; i < (size_t)pages * 4096; i++) {
+        buffer[i] = (uint8_t)(i * 131 + 7);
+    }
+    
+    energy_source_t src;
+    unsigned long long before[AES_SM3_ENERGY_MAX_DOMAINS], after[AES_SM3_ENERGY_MAX_DOMAINS];
+    energy_source_open(&src);
+    struct timespec start, end;
+    
+    if (src.count > 0) {
+        printf("能量计数器: %s, %d个域\n", src.kind, src.count);
+        // 空闲基线：同样时长的休眠
+        energy_sample(&src, before);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        usleep((useconds_t)(AES_SM3_ENERGY_MIN_SECONDS * 1e6));
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        energy_sample(&src, after);
+        double idle_j = energy_joules(&src, before, after);
+        double idle_s = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        if (idle_j >= 0.0) {
+            printf("空闲功耗: %.2f W\n", idle_j / idle_s);
+        }
+    } else {
+        printf("能量计数器: 不可用（无powercap/hwmon能量接口或无读取权限）\n");
+    }
+    printf("\n%-12s %12s %12s %12s\n", "内核", "MB/s", "J/GB", "平均功率W");
+    
+    for (int kernel = 0; kernel < 5; kernel++) {
+        energy_run_kernel(kernel, buffer, output, pages);  // 预热
+        
+        int have_energy = src.count > 0 && energy_sample(&src, before) == 0;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        long passes = 0;
+        double elapsed;
+        do {
+            energy_run_kernel(kernel, buffer, output, pages);
+            passes++;
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        } while (elapsed < AES_SM3_ENERGY_MIN_SECONDS);
+        have_energy = have_energy && energy_sample(&src, after) == 0;
+        
+        double gigabytes = passes * (double)pages * 4096 / (1024.0 * 1024.0 * 1024.0);
+        double mbps = gigabytes * 1024.0 / elapsed;
+        double joules = have_energy ? energy_joules(&src, before, after) : -1.0;
+        if (joules >= 0.0) {
+            printf("%-12s %12.2f %12.3f %12.2f\n", kernel_names[kernel], mbps,
+                   joules / gigabytes, joules / elapsed);
+        } else {
+            printf("%-12s %12.2f %12s %12s\n", kernel_names[kernel], mbps, "不可用", "不可用");
+        }
+    }
+    
+    free(buffer);
+    free(output);
+}
+
+// ============================================================================
+// 指令缓存占用基准
+// ============================================================================
+/*
+ * 完全展开的变体（_hyper展开256次加载、sm3_compress_hw_inline_full展开64轮）
+ * 代码体积大，并被内联进多个调用者，生产环境中会与业务代码争用指令缓存。
+ * - 代码大小取自 /proc/self/exe 的ELF64符号表（需未剥离符号），同名的
+ *   .constprop/.isra克隆一并计入；没有独立符号的辅助函数显示"已内联"
+ * - 抖动负载是运行时生成的一段代码：每个64字节缓存行只有一条跳到下一行
+ *   的分支，执行一遍即让指定大小的代码流过指令缓存和分支预测器
+ * - 每处理一页执行一次抖动代码，只对内核调用本身计时（计时开销各列相同）
+ * 抖动大小可由环境变量 AES_SM3_ICACHE_THRASH_KB 指定，默认测0/32/128/512KB。
+ */
+
+#define AES_SM3_ICACHE_PAGES 256   // 1MB数据，驻留L2，突出指令侧开销
+#define AES_SM3_ICACHE_ROUNDS 16
+#define AES_SM3_ICACHE_MAX_SIZES 4
+
+typedef void (*icache_thrash_fn)(void);
+typedef void (*icache_kernel_fn)(const uint8_t* input, uint8_t* output);
+
+typedef struct {
+    const char* name;
+    unsigned long size;
+    int copies;
+} icache_symbol_t;
+
+// 生成bytes大小的抖动代码，不支持的架构或禁止可执行映射时返回NULL
+static icache_thrash_fn icache_thrash_create(size_t bytes) {
+#if defined(__aarch64__) || defined(__x86_64__)
+    size_t lines = bytes / 64;
+    if (lines == 0) {
+        return NULL;
+    }
+    uint8_t* code = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) {
+        return NULL;
+    }
+    for (size_t i = 0; i < lines; i++) {
+        uint8_t* line = code + i * 64;
+        int last = (i == lines - 1);
+#if defined(__aarch64__)
+        uint32_t* insn = (uint32_t*)line;
+        for (int k = 0; k < 16; k++) {
+            insn[k] = 0xd503201f;                      // nop
+        }
+        insn[0] = last ? 0xd65f03c0 : 0x14000010;      // ret / b .+64
+#else
+        memset(line, 0x90, 64);                        // nop
+        if (last) {
+            line[0] = 0xc3;                            // ret
+        } else {
+            line[0] = 0xeb;                            // jmp .+64
+            line[1] = 0x3e;
+        }
+#endif
+    }
+    if (mprotect(code, bytes, PROT_READ | PROT_EXEC) != 0) {
+        munmap(code, bytes);
+        return NULL;
+    }
+    __builtin___clear_cache((char*)code, (char*)code + bytes);
+    return (icache_thrash_fn)(uintptr_t)code;
+#else
+    (void)bytes;
+    return NULL;
+#endif
+}
+
+static void icache_thrash_destroy(icache_thrash_fn fn, size_t bytes) {
+    if (fn != NULL) {
+        munmap((void*)(uintptr_t)fn, bytes);
+    }
+}
+
+// 从可执行文件的符号表累计各函数（含编译器克隆）的代码大小
+static int icache_symbol_sizes(icache_symbol_t* symbols, int count) {
+    int fd = open("/proc/self/exe", O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Elf64_Ehdr)) {
+        close(fd);
+        return -1;
+    }
+    const uint8_t* image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) {
+        return -1;
+    }
+    
+    int found = -1;
+    const Elf64_Ehdr* eh = (const Elf64_Ehdr*)image;
+    if (memcmp(eh->e_ident, ELFMAG, SELFMAG) == 0 && eh->e_ident[EI_CLASS] == ELFCLASS64 &&
+        eh->e_shoff + (size_t)eh->e_shnum * sizeof(Elf64_Shdr) <= (size_t)st.st_size) {
+        const Elf64_Shdr* sections = (const Elf64_Shdr*)(image + eh->e_shoff);
+        for (int i = 0; i < eh->e_shnum; i++) {
+            if (sections[i].sh_type != SHT_SYMTAB || sections[i].sh_link >= eh->e_shnum) {
+                continue;
+            }
+            const Elf64_Sym* syms = (const Elf64_Sym*)(image + sections[i].sh_offset);
+            size_t sym_count = sections[i].sh_size / sizeof(Elf64_Sym);
+            const char* names = (const char*)(image + sections[sections[i].sh_link].sh_offset);
+            found = 0;
+            for (size_t k = 0; k < sym_count; k++) {
+                if (ELF64_ST_TYPE(syms[k].st_info) != STT_FUNC) {
+                    continue;
+                }
+                const char* name = names + syms[k].st_name;
+                for (int j = 0; j < count; j++) {
+                    size_t len = strlen(symbols[j].name);
+                    if (strncmp(name, symbols[j].name, len) == 0 &&
+                        (name[len] == '\0' || name[len] == '.')) {
+                        symbols[j].size += syms[k].st_size;
+                        symbols[j].copies++;
+                        found++;
+                    }
+                }
+            }
+        }
+    }
+    munmap((void*)image, st.st_size);
+    return found;
+}
+
+// 抖动与内核交替执行时内核的吞吐（MB/s）：只对内核调用本身计时
+static double icache_run(icache_kernel_fn kernel, icache_thrash_fn thrash,
+                         const uint8_t* buffer, uint8_t* output) {
+    const int pages = AES_SM3_ICACHE_PAGES;
+    uint64_t kernel_ns = 0;
+    
+    for (int r = 0; r < AES_SM3_ICACHE_ROUNDS; r++) {
+        for (int i = 0; i < pages; i++) {
+            if (thrash != NULL) {
+                thrash();
+            }
+            uint64_t start = monotonic_ns();
+            kernel(buffer + (size_t)i * 4096, output + (size_t)i * 32);
+            kernel_ns += monotonic_ns() - start;
+        }
+    }
+    return (double)AES_SM3_ICACHE_ROUNDS * pages * 4.0 / 1024.0 / (kernel_ns / 1e9);
+}
+
+void aes_sm3_icache_benchmark(void) {
+    static const struct {
+        const char* name;
+        icache_kernel_fn fn;
+    } kernels[] = {
+        { "aes_sm3_integrity_256bit", aes_sm3_integrity_256bit },
+        { "aes_sm3_integrity_256bit_extreme", aes_sm3_integrity_256bit_extreme },
+        { "aes_sm3_integrity_256bit_ultra", aes_sm3_integrity_256bit_ultra },
+        { "aes_sm3_integrity_256bit_mega", aes_sm3_integrity_256bit_mega },
+        { "aes_sm3_integrity_256bit_super", aes_sm3_integrity_256bit_super },
+        { "aes_sm3_integrity_256bit_hyper", aes_sm3_integrity_256bit_hyper },
+    };
+    const int kernel_count = sizeof(kernels) / sizeof(kernels[0]);
+    static const char* helpers[] = { "sm3_compress_hw_inline_full", "sm3_compress_hw" };
+    const int helper_count = sizeof(helpers) / sizeof(helpers[0]);
+    
+    // 代码大小
+    icache_symbol_t symbols[8];
+    for (int i = 0; i < kernel_count + helper_count; i++) {
+        symbols[i].name = i < kernel_count ? kernels[i].name : helpers[i - kernel_count];
+        symbols[i].size = 0;
+        symbols[i].copies = 0;
+    }
+    int have_symbols = icache_symbol_sizes(symbols, kernel_count + helper_count) >= 0;
+    if (!have_symbols) {
+        printf("符号表不可用（可执行文件已剥离或非ELF64），代码大小不显示\n");
+    }
+    for (int i = kernel_count; i < kernel_count + helper_count; i++) {
+        if (!have_symbols) {
+            break;
+        }
+        if (symbols[i].copies == 0) {
+            printf("%s: 已内联\n", symbols[i].name);
+        } else {
+            printf("%s: %lu 字节（%d 份独立副本）\n", symbols[i].name, symbols[i].size, symbols[i].copies);
+        }
+    }
+    
+    // 抖动大小
+    size_t sizes[AES_SM3_ICACHE_MAX_SIZES] = { 0, 32 * 1024, 128 * 1024, 512 * 1024 };
+    int size_count = AES_SM3_ICACHE_MAX_SIZES;
+    const char* env = getenv("AES_SM3_ICACHE_THRASH_KB");
+    if (env != NULL && atol(env) > 0) {
+        sizes[0] = 0;
+        sizes[1] = (size_t)atol(env) * 1024;
+        size_count = 2;
+    }
+    icache_thrash_fn thrash[AES_SM3_ICACHE_MAX_SIZES];
+    for (int t = 0; t < size_count; t++) {
+        thrash[t] = sizes[t] ? icache_thrash_create(sizes[t]) : NULL;
+    }
+    
+    uint8_t* buffer = aligned_alloc(4096, (size_t)AES_SM3_ICACHE_PAGES * 4096);
+    uint8_t* output = malloc((size_t)AES_SM3_ICACHE_PAGES * 32);
+    if (buffer == NULL || output == NULL) {
+        printf("缓冲区分配失败，跳过指令缓存测试\n");
+        free(buffer);
+        free(output);
+        for (int t = 0; t < size_count; t++) {
+            icache_thrash_destroy(thrash[t], sizes[t]);
+        }
+        return;
+    }
+    for (size_t i = 0; i < (size_t)AES_SM3_ICACHE_PAGES * 4096; i++) {
+        buffer[i] = (uint8_t)(i * 97 + 11);
+    }
+    
+    printf("\n%-34s %10s", "内核", "代码字节");
+    for (int t = 0; t < size_count; t++) {
+        char label[32];
+        snprintf(label, sizeof(label), "抖动%zuKB MB/s", sizes[t] / 1024);
+        printf(" %16s", label);
+    }
+    printf("\n");
+    
+    for (int k = 0; k < kernel_count; k++) {
+        printf("%-34s", kernels[k].name);
+        if (have_symbols && symbols[k].copies > 0) {
+            printf(" %10lu", symbols[k].size);
+        } else {
+            printf(" %10s", "不可用");
+        }
+        kernels[k].fn(buffer, output);  // 预热
+        for (int t = 0; t < size_count; t++) {
+            if (sizes[t] != 0 && thrash[t] == NULL) {
+                printf(" %16s", "不可用");
+                continue;
+            }
+            printf(" %16.2f", icache_run(kernels[k].fn, thrash[t], buffer, output));
+        }
+        printf("\n");
+    }
+    
+    for (int t = 0; t < size_count; t++) {
+        icache_thrash_destroy(thrash[t], sizes[t]);
+    }
+    free(buffer);
+    free(output);
+}
+
+// ============================================================================
+// 冷启动：显式初始化与首次调用延迟
+// ============================================================================
+/*
+ * 库默认惰性初始化：拓扑探测、自动调优缓存、每线程统计块都在第一次用到时完成，代码页和
+ * 常量表在第一次调用内核时缺页换入。短命的CLI进程和刚fork的worker会把
+ * 这些开销算进第一个摘要。aes_sm3_init可以提前完成：
+ * - 在fork服务器中于fork前调用，子进程继承已探测的拓扑和已换入的代码页
+ * - 设置环境变量 AES_SM3_EAGER_INIT=1 时在加载时自动调用（不改代码）
+ * 冷启动基准用fork/exec重新执行本程序（--first-digest子模式），测量从创建
+ * 进程到第一个摘要完成的时间，以及第一次/第二次调用内核的延迟；有权限时
+ * 每次启动前丢弃页缓存，使可执行文件的代码页从磁盘读入。
+ */
+
+#define AES_SM3_INIT_TOPOLOGY 0x1   // 探测CPU拓扑（并行接口首次调用时需要）
+#define AES_SM3_INIT_PREFAULT 0x2   // 调用各内核一次，换入代码页和常量表
+#define AES_SM3_INIT_THREAD   0x4   // 为调用线程登记统计块
+#define AES_SM3_INIT_AUTOTUNE 0x8   // 载入自动调优缓存
+#define AES_SM3_INIT_ALL      0xF
+
+#define AES_SM3_COLDSTART_RUNS 5
+#define AES_SM3_COLDSTART_KERNELS 4
+
+void aes_sm3_init(int flags) {
+    if (flags & AES_SM3_INIT_TOPOLOGY) {
+        aes_sm3_topology_get();
+    }
+    if (flags & AES_SM3_INIT_AUTOTUNE) {
+        aes_sm3_autotune_tile(AES_SM3_TUNE_BATCH);
+    }
+    if (flags & AES_SM3_INIT_PREFAULT) {
+        static uint8_t page[4096] __attribute__((aligned(64)));
+        uint8_t digest[32];
+        const uint8_t* inputs[1] = { page };
+        uint8_t* outputs[1] = { digest };
+        aes_sm3_integrity_256bit(page, digest);
+        aes_sm3_integrity_256bit_hyper(page, digest);
+        aes_sm3_integrity_batch(inputs, outputs, 1);
+    }
+#if AES_SM3_STATS
+    if ((flags & AES_SM3_INIT_THREAD) && tls_stats == NULL) {
+        stats_register();
+    }
+#endif
+}
+
+__attribute__((constructor)) static void aes_sm3_init_from_env(void) {
+    const char* eager = getenv("AES_SM3_EAGER_INIT");
+    if (eager != NULL && eager[0] != '\0' && strcmp(eager, "0") != 0) {
+        aes_sm3_init(AES_SM3_INIT_ALL);
+    }
+}
+
+static void coldstart_run_kernel(int kernel, const uint8_t* pages, uint8_t* digests) {
+    const uint8_t* inputs[8];
+    uint8_t* outputs[8];
+    switch (kernel) {
+    case 0:
+        aes_sm3_integrity_256bit(pages, digests);
+        break;
+    case 1:
+        aes_sm3_integrity_256bit_hyper(pages, digests);
+        break;
+    case 2:
+        for (int i = 0; i < 8; i++) {
+            inputs[i] = pages + (size_t)i * 4096;
+            outputs[i] = digests + i * 32;
+        }
+        aes_sm3_integrity_batch(inputs, outputs, 8);
+        break;
+    default:
+        aes_sm3_parallel(pages, digests, 64, sysconf(_SC_NPROCESSORS_ONLN), 256);
+        break;
+    }
+}
+
+// 冷启动子进程：计算第一个和第二个摘要，把三个时间点写入result_fd
+int aes_sm3_coldstart_child(int kernel, int eager, int result_fd) {
+    if (eager) {
+        aes_sm3_init(AES_SM3_INIT_ALL);
+    }
+    uint8_t* pages = aligned_alloc(4096, 64 * 4096);
+    uint8_t* digests = malloc(64 * 32);
+    if (pages == NULL || digests == NULL) {
+        return 1;
+    }
+    memset(pages, 0x5A, 64 * 4096);
+    
+    uint64_t t[3];
+    t[0] = monotonic_ns();
+    coldstart_run_kernel(kernel, pages, digests);
+    t[1] = monotonic_ns();
+    coldstart_run_kernel(kernel, pages, digests);
+    t[2] = monotonic_ns();
+    
+    int ok = write(result_fd, t, sizeof(t)) == (ssize_t)sizeof(t);
+    free(pages);
+    free(digests);
+    return ok ? 0 : 1;
+}
+
+typedef struct {
+    double start_to_digest_us;
+    double first_call_us;
+    double second_call_us;
+} coldstart_result_t;
+
+static int coldstart_drop_caches(void) {
+    sync();
+    int fd = open("/proc/sys/vm/drop_caches", O_WRONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    int ok = write(fd, "1", 1) == 1;
+    close(fd);
+    return ok ? 0 : -1;
+}
+
+static int coldstart_spawn(int kernel, int eager, int drop, coldstart_result_t* r) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return -1;
+    }
+    if (drop) {
+        coldstart_drop_caches();
+    }
+    
+    uint64_t spawn_ns = monotonic_ns();
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        char kernel_arg[16], eager_arg[16], fd_arg[16];
+        close(fds[0]);
+        snprintf(kernel_arg, sizeof(kernel_arg), "%d", kernel);
+        snprintf(eager_arg, sizeof(eager_arg), "%d", eager);
+        snprintf(fd_arg, sizeof(fd_arg), "%d", fds[1]);
+        if (!eager) {
+            unsetenv("AES_SM3_EAGER_INIT");  // 惰性组不受父进程环境影响
+        }
+        execl("/proc/self/exe", "aes_sm3_integrity", "--first-digest",
+              kernel_arg, eager_arg, fd_arg, (char*)NULL);
+        _exit(127);
+    }
+    
+    close(fds[1]);
+    uint64_t t[3];
+    ssize_t got = read(fds[0], t, sizeof(t));
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (got != (ssize_t)sizeof(t) || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        return -1;
+    }
+    
+    r->start_to_digest_us = (t[1] - spawn_ns) / 1e3;
+    r->first_call_us = (t[1] - t[0]) / 1e3;
+    r->second_call_us = (t[2] - t[1]) / 1e3;
+    return 0;
+}
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+void aes_sm3_coldstart_benchmark(void) {
+    static const char* kernel_names[AES_SM3_COLDSTART_KERNELS] = {
+        "256bit", "hyper", "批处理(8页)", "多线程并行(64页)"
+    };
+    int drop = access("/proc/sys/vm/drop_caches", W_OK) == 0;
+    printf("页缓存丢弃: %s\n", drop ? "允许（每次启动前丢弃）" : "无权限（可执行文件保持在页缓存中）");
+    printf("每项取%d次新进程的中位数\n\n", AES_SM3_COLDSTART_RUNS);
+    printf("%-18s %6s %18s %14s %14s\n", "内核", "初始化", "启动到首摘要(us)", "首次调用(us)", "第二次(us)");
+    
+    for (int kernel = 0; kernel < AES_SM3_COLDSTART_KERNELS; kernel++) {
+        for (int eager = 0; eager < 2; eager++) {
+            double start[AES_SM3_COLDSTART_RUNS], first[AES_SM3_COLDSTART_RUNS];
+            double second[AES_SM3_COLDSTART_RUNS];
+            int runs = 0;
+            for (int i = 0; i < AES_SM3_COLDSTART_RUNS; i++) {
+                coldstart_result_t r;
+                if (coldstart_spawn(kernel, eager, drop, &r) == 0) {
+                    start[runs] = r.start_to_digest_us;
+                    first[runs] = r.first_call_us;
+                    second[runs] = r.second_call_us;
+                    runs++;
+                }
+            }
+            if (runs == 0) {
+                printf("%-18s %6s %18s %14s %14s\n", kernel_names[kernel], eager ? "预先" : "惰性",
+                       "不可用", "不可用", "不可用");
+                continue;
+            }
+            qsort(start, runs, sizeof(double), compare_double);
+            qsort(first, runs, sizeof(double), compare_double);
+            qsort(second, runs, sizeof(double), compare_double);
+            printf("%-18s %6s %18.1f %14.1f %14.1f\n", kernel_names[kernel], eager ? "预先" : "惰性",
+                   start[runs / 2], first[runs / 2], second[runs / 2]);
+        }
+    }
+}
+
+// ============================================================================
+// 批大小扫描与分块拐点
+// ============================================================================
+/*
+ * 对每个批处理族扫描1到4096页的批大小（2的幂），取达到峰值吞吐95%的
+ * 最小批大小作为拐点：更大的批次不再提速，只会让中间结果溢出L1/L2。
+ * 拐点写入自动调优缓存作为分块大小；设置了AES_SM3_AUTOTUNE_CACHE时同时
+ * 保存到该文件，之后的进程启动即可使用。
+ * 扫描直接调用未分块的内核，不受当前分块设置影响。
+ */
+
+#define AES_SM3_SWEEP_MAX_BATCH 4096
+#define AES_SM3_SWEEP_POINTS 13          // 1, 2, 4, ..., 4096
+#define AES_SM3_SWEEP_PAGES 16384        // 每个点处理64MB
+#define AES_SM3_SWEEP_REPEATS 2          // 每个点取最好成绩
+#define AES_SM3_KNEE_FRACTION 0.95
+
+typedef void (*sweep_batch_fn)(const uint8_t** inputs, uint8_t** outputs, int batch_size);
+
+static void integrity_batch_tile_no_prefetch(const uint8_t** inputs, uint8_t** outputs, int batch_size);
+static void integrity_batch_tile_super_prefetch(const uint8_t** inputs, uint8_t** outputs, int batch_size);
+static void integrity_batch_tile_pipeline_prefetch(const uint8_t** inputs, uint8_t** outputs, int batch_size);
+
+static double sweep_point(sweep_batch_fn fn, const uint8_t** inputs, uint8_t** outputs,
+                          int buffer_pages, int batch) {
+    double best = 0.0;
+    for (int rep = 0; rep < AES_SM3_SWEEP_REPEATS; rep++) {
+        struct timespec start, end;
+        int done = 0;
+        int base = 0;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        while (done < AES_SM3_SWEEP_PAGES) {
+            if (base + batch > buffer_pages) {
+                base = 0;
+            }
+            fn(inputs + base, outputs + base, batch);
+            base += batch;
+            done += batch;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        double mbps = done * 4.0 / 1024.0 / elapsed;
+        if (mbps > best) {
+            best = mbps;
+        }
+    }
+    return best;
+}
 
-void sha256_4kb(const uint8_t* input, uint8_t* output) {
-    uint32_t state[8] = {
-        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
-        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+// 达到峰值吞吐AES_SM3_KNEE_FRACTION的最小批大小
+static int sweep_knee(const double* mbps, int points) {
+    double peak = 0.0;
+    for (int i = 0; i < points; i++) {
+        if (mbps[i] > peak) {
+            peak = mbps[i];
+        }
+    }
+    for (int i = 0; i < points; i++) {
+        if (mbps[i] >= peak * AES_SM3_KNEE_FRACTION) {
+            return 1 << i;
+        }
+    }
+    return 1 << (points - 1);
+}
+
+void aes_sm3_batch_sweep_benchmark(void) {
+    const sweep_batch_fn families[AES_SM3_TUNE_FAMILIES] = {
+        integrity_batch_tile,
+        integrity_batch_tile_no_prefetch,
+        integrity_batch_tile_super_prefetch,
+        integrity_batch_tile_pipeline_prefetch,
     };
+    const int buffer_pages = AES_SM3_SWEEP_MAX_BATCH;
+    uint8_t* buffer = aligned_alloc(4096, (size_t)buffer_pages * 4096);
+    uint8_t* digests = malloc((size_t)buffer_pages * 32);
+    const uint8_t** inputs = malloc(buffer_pages * sizeof(uint8_t*));
+    uint8_t** outputs = malloc(buffer_pages * sizeof(uint8_t*));
+    if (buffer == NULL || digests == NULL || inputs == NULL || outputs == NULL) {
+        printf("缓冲区分配失败，跳过批大小扫描\n");
+        free(buffer);
+        free(digests);
+        free(inputs);
+        free(outputs);
+        return;
+    }
+    for (size_t i = 0; i < (size_t)buffer_pages * 4096; i++) {
+        buffer[i] = (uint8_t)(i * 73 + 19);
+    }
+    for (int i = 0; i < buffer_pages; i++) {
+        inputs[i] = buffer + (size_t)i * 4096;
+        outputs[i] = digests + (size_t)i * 32;
+    }
     
-    // 循环展开：每次处理4个块
-    for (int i = 0; i < 64; i += 4) {
-        sha256_compress(state, input + i * 64);
-        sha256_compress(state, input + (i+1) * 64);
-        sha256_compress(state, input + (i+2) * 64);
-        sha256_compress(state, input + (i+3) * 64);
+    double mbps[AES_SM3_TUNE_FAMILIES][AES_SM3_SWEEP_POINTS];
+    printf("%8s", "批大小");
+    for (int f = 0; f < AES_SM3_TUNE_FAMILIES; f++) {
+        printf(" %18s", autotune_family_names[f]);
+    }
+    printf("\n");
+    for (int point = 0; point < AES_SM3_SWEEP_POINTS; point++) {
+        int batch = 1 << point;
+        printf("%8d", batch);
+        for (int f = 0; f < AES_SM3_TUNE_FAMILIES; f++) {
+            mbps[f][point] = sweep_point(families[f], inputs, outputs, buffer_pages, batch);
+            printf(" %18.2f", mbps[f][point]);
+        }
+        printf("\n");
     }
     
-    // 直接输出（减少循环）
-    uint32_t* out32 = (uint32_t*)output;
-    out32[0] = __builtin_bswap32(state[0]);
-    out32[1] = __builtin_bswap32(state[1]);
-    out32[2] = __builtin_bswap32(state[2]);
-    out32[3] = __builtin_bswap32(state[3]);
-    out32[4] = __builtin_bswap32(state[4]);
-    out32[5] = __builtin_bswap32(state[5]);
-    out32[6] = __builtin_bswap32(state[6]);
-    out32[7] = __builtin_bswap32(state[7]);
+    printf("\n拐点（达到峰值%.0f%%的最小批大小）:\n", AES_SM3_KNEE_FRACTION * 100);
+    for (int f = 0; f < AES_SM3_TUNE_FAMILIES; f++) {
+        int knee = sweep_knee(mbps[f], AES_SM3_SWEEP_POINTS);
+        aes_sm3_autotune_set_tile(f, knee);
+        printf("  %-18s %5d页（%6.2f MB/s）\n", autotune_family_names[f], knee,
+               mbps[f][__builtin_ctz(knee)]);
+    }
+    const char* cache = getenv("AES_SM3_AUTOTUNE_CACHE");
+    if (cache != NULL && cache[0] != '\0') {
+        printf("自动调优缓存: %s %s\n", cache, aes_sm3_autotune_save(cache) == 0 ? "已保存" : "保存失败");
+    }
+    
+    free(buffer);
+    free(digests);
+    free(inputs);
+    free(outputs);
 }
 
 // ============================================================================
-// 纯SM3实现（用于对比）
+// 512字节扇区标签（8路多缓冲SM3）
 // ============================================================================
+/*
+ * 面向按512字节扇区校验的块层（T10-PI式）：每个扇区的两个256字节段
+ * 用覆盖全部字节的xor_fold_segment_full折叠为16字节（软件路径上与整页
+ * 折叠结果中对应的16字节相同），加上SM3填充正好一个消息块，一次压缩后
+ * 取状态的前64或128位作为标签。
+ * 一页的8个扇区放在同一次8路多缓冲SM3压缩（sm3_compress_x8）中，
+ * 逐扇区标签的代价接近逐页摘要。
+ */
 
-void sm3_4kb(const uint8_t* input, uint8_t* output) {
-    uint32_t state[8];
-    memcpy(state, SM3_IV, sizeof(SM3_IV));
-    
-    // 循环展开：每次处理2个块
-    for (int i = 0; i < 64; i += 2) {
-        uint32_t block[16];
-        
-        // 第一个块
-        const uint32_t* src = (const uint32_t*)(input + i * 64);
-        for (int j = 0; j < 16; j++) {
-            block[j] = __builtin_bswap32(src[j]);
+#define AES_SM3_SECTOR_SIZE 512
+
+// 折叠最多8个连续扇区并计算标签状态（不足8个的路补零，结果丢弃）
+static inline void sector_group_state(const uint8_t* input, int sectors,
+                                      uint32_t state[8][AES_SM3_MB_LANES]) {
+    uint32_t W[68][AES_SM3_MB_LANES];
+    
+    for (int l = 0; l < AES_SM3_MB_LANES; l++) {
+        uint8_t folded[16] = {0};
+        if (l < sectors) {
+            const uint8_t* sector = input + (size_t)l * AES_SM3_SECTOR_SIZE;
+            xor_fold_segment_full(sector, folded);
+            xor_fold_segment_full(sector + 256, folded + 8);
         }
-        sm3_compress_hw(state, block);
-        
-        // 第二个块
-        src = (const uint32_t*)(input + (i+1) * 64);
-        for (int j = 0; j < 16; j++) {
-            block[j] = __builtin_bswap32(src[j]);
+        for (int i = 0; i < 4; i++) {
+            uint32_t w;
+            memcpy(&w, folded + i * 4, 4);
+            W[i][l] = __builtin_bswap32(w);
         }
-        sm3_compress_hw(state, block);
+        // SM3填充：0x80，补零，最后64位为消息位长128
+        W[4][l] = 0x80000000;
+        for (int i = 5; i < 15; i++) {
+            W[i][l] = 0;
+        }
+        W[15][l] = 128;
+        for (int i = 0; i < 8; i++) {
+            state[i][l] = SM3_IV[i];
+        }
+    }
+    sm3_compress_x8(state, W);
+}
+
+static inline int sector_tag_words(int tag_bits) {
+    return tag_bits == 64 ? 2 : tag_bits == 128 ? 4 : 0;
+}
+
+// 计算sector_count个512字节扇区的标签，按tag_bits/8字节紧密排列写入tags
+// tag_bits须为64或128，否则返回-1
+int aes_sm3_sector_tags(const uint8_t* input, size_t sector_count, uint8_t* tags, int tag_bits) {
+    int words = sector_tag_words(tag_bits);
+    if (words == 0) {
+        return -1;
+    }
+    STAT_KERNEL(AES_SM3_KERNEL_SECTOR, (sector_count + AES_SM3_MB_LANES - 1) / AES_SM3_MB_LANES);
+    
+    uint32_t state[8][AES_SM3_MB_LANES];
+    for (size_t base = 0; base < sector_count; base += AES_SM3_MB_LANES) {
+        int n = sector_count - base < AES_SM3_MB_LANES ? (int)(sector_count - base)
+                                                           : AES_SM3_MB_LANES;
+        sector_group_state(input + base * AES_SM3_SECTOR_SIZE, n, state);
+        for (int l = 0; l < n; l++) {
+            uint8_t* out = tags + (base + l) * (size_t)(words * 4);
+            for (int i = 0; i < words; i++) {
+                uint32_t w = __builtin_bswap32(state[i][l]);
+                memcpy(out + i * 4, &w, 4);
+            }
+        }
+    }
+    return 0;
+}
+
+// 校验扇区标签，返回不一致的扇区数（tag_bits非法返回-1）
+// first_bad（可为NULL）输出第一个不一致扇区的下标，全部一致时为-1
+long aes_sm3_sector_verify(const uint8_t* input, size_t sector_count, const uint8_t* tags,
+                           int tag_bits, long* first_bad) {
+    int words = sector_tag_words(tag_bits);
+    long bad = 0;
+    if (first_bad) *first_bad = -1;
+    if (words == 0) {
+        return -1;
+    }
+    STAT_KERNEL(AES_SM3_KERNEL_SECTOR, (sector_count + AES_SM3_MB_LANES - 1) / AES_SM3_MB_LANES);
+    
+    uint32_t state[8][AES_SM3_MB_LANES];
+    for (size_t base = 0; base < sector_count; base += AES_SM3_MB_LANES) {
+        int n = sector_count - base < AES_SM3_MB_LANES ? (int)(sector_count - base)
+                                                           : AES_SM3_MB_LANES;
+        sector_group_state(input + base * AES_SM3_SECTOR_SIZE, n, state);
+        for (int l = 0; l < n; l++) {
+            const uint8_t* expected = tags + (base + l) * (size_t)(words * 4);
+            int same = 1;
+            for (int i = 0; i < words; i++) {
+                uint32_t w = __builtin_bswap32(state[i][l]);
+                same &= memcmp(expected + i * 4, &w, 4) == 0;
+            }
+            if (!same) {
+                if (bad == 0 && first_bad) *first_bad = (long)(base + l);
+                bad++;
+            }
+        }
+    }
+    return bad;
+}
+
+// 逐页摘要与逐扇区标签的吞吐对比；逐扇区单路压缩作为多缓冲的基线
+#define AES_SM3_SECTOR_BENCH_PAGES 4096  // 16MB
+#define AES_SM3_SECTOR_BENCH_ROUNDS 8
+
+void aes_sm3_sector_benchmark(void) {
+    const size_t pages = AES_SM3_SECTOR_BENCH_PAGES;
+    const size_t sectors = pages * (4096 / AES_SM3_SECTOR_SIZE);
+    uint8_t* buffer = aligned_alloc(4096, pages * 4096);
+    uint8_t* digests = malloc(pages * 32);
+    uint8_t* tags = malloc(sectors * 16);
+    const uint8_t** inputs = malloc(pages * sizeof(uint8_t*));
+    uint8_t** outputs = malloc(pages * sizeof(uint8_t*));
+    if (buffer == NULL || digests == NULL || tags == NULL || inputs == NULL || outputs == NULL) {
+        printf("缓冲区分配失败，跳过扇区标签测试\n");
+        free(buffer);
+        free(digests);
+        free(tags);
+        free(inputs);
+        free(outputs);
+        return;
+    }
+    for (size_t i = 0; i < pages * 4096; i++) {
+        buffer[i] = (uint8_t)(i * 29 + 7);
+    }
+    for (size_t i = 0; i < pages; i++) {
+        inputs[i] = buffer + i * 4096;
+        outputs[i] = digests + i * 32;
     }
     
-    // 直接输出（减少循环）
-    uint32_t* out32 = (uint32_t*)output;
-    out32[0] = __builtin_bswap32(state[0]);
-    out32[1] = __builtin_bswap32(state[1]);
-    out32[2] = __builtin_bswap32(state[2]);
-    out32[3] = __builtin_bswap32(state[3]);
-    out32[4] = __builtin_bswap32(state[4]);
-    out32[5] = __builtin_bswap32(state[5]);
-    out32[6] = __builtin_bswap32(state[6]);
-    out32[7] = __builtin_bswap32(state[7]);
+    static const char* names[] = { "逐页256位（批处理）", "扇区64位标签", "扇区128位标签", "扇区128位（单路）" };
+    double mbps[4];
+    for (int variant = 0; variant < 4; variant++) {
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int round = 0; round < AES_SM3_SECTOR_BENCH_ROUNDS; round++) {
+            if (variant == 0) {
+                aes_sm3_integrity_batch(inputs, outputs, (int)pages);
+            } else if (variant == 1 || variant == 2) {
+                aes_sm3_sector_tags(buffer, sectors, tags, variant == 1 ? 64 : 128);
+            } else {
+                for (size_t s = 0; s < sectors; s++) {
+                    const uint8_t* sector = buffer + s * AES_SM3_SECTOR_SIZE;
+                    uint8_t folded[16];
+                    uint32_t block[16] = {0};
+                    uint32_t state[8];
+                    xor_fold_segment_full(sector, folded);
+                    xor_fold_segment_full(sector + 256, folded + 8);
+                    for (int i = 0; i < 4; i++) {
+                        uint32_t w;
+                        memcpy(&w, folded + i * 4, 4);
+                        block[i] = __builtin_bswap32(w);
+                    }
+                    block[4] = 0x80000000;
+                    block[15] = 128;
+                    memcpy(state, SM3_IV, sizeof(SM3_IV));
+                    sm3_compress_hw(state, block);
+                    sm3_store_state(state, tags + s * 16, 4);
+                }
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        mbps[variant] = pages * 4.0 / 1024.0 * AES_SM3_SECTOR_BENCH_ROUNDS / elapsed;
+    }
+    
+    printf("%-24s %12s %12s\n", "方式", "MB/s", "相对逐页");
+    for (int variant = 0; variant < 4; variant++) {
+        printf("%-24s %12.2f %11.2fx\n", names[variant], mbps[variant], mbps[variant] / mbps[0]);
+    }
+    
+    free(buffer);
+    free(digests);
+    free(tags);
+    free(inputs);
+    free(outputs);
 }
 
 // ============================================================================
-// 多线程并行处理
+// 页长特化基准
 // ============================================================================
 
-typedef struct {
-    const uint8_t* input;
-    uint8_t* output;
-    int thread_id;
-    int num_threads;
-    int block_count;
-    int output_size;  // 128 or 256
-    pthread_barrier_t* barrier;
-} thread_data_t;
+#define AES_SM3_PAGE_BENCH_BYTES (32u << 20)
+#define AES_SM3_PAGE_BENCH_ROUNDS 4
 
-void* thread_worker(void* arg) {
-    thread_data_t* data = (thread_data_t*)arg;
-    
-    // 设置线程亲和性
-    cpu_set_t cpuset;
-    CPU_ZERO(&cpuset);
-    CPU_SET(data->thread_id % CPU_SETSIZE, &cpuset);
-    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
-    
-    int blocks_per_thread = data->block_count / data->num_threads;
-    int start_block = data->thread_id * blocks_per_thread;
-    int end_block = (data->thread_id == data->num_threads - 1) ? 
-                   data->block_count : start_block + blocks_per_thread;
+typedef void (*sized_batch_fn)(const uint8_t** inputs, uint8_t** outputs, int batch_size);
+typedef void (*sized_parallel_fn)(const uint8_t* input, uint8_t* output, int page_count,
+                                  int num_threads, int output_size);
+
+// 每种页长的单页、批处理、多线程并行吞吐，以及同样数据按4KB分段批处理的吞吐
+void aes_sm3_page_size_benchmark(void) {
+    static const int sizes[] = { 4096, AES_SM3_PAGE_8K, AES_SM3_PAGE_16K, AES_SM3_PAGE_64K };
+    static const page_hash_fn singles[] = {
+        aes_sm3_integrity_256bit, aes_sm3_integrity_8k_256bit,
+        aes_sm3_integrity_16k_256bit, aes_sm3_integrity_64k_256bit,
+    };
+    static const sized_batch_fn batches[] = {
+        aes_sm3_integrity_batch, aes_sm3_integrity_batch_8k,
+        aes_sm3_integrity_batch_16k, aes_sm3_integrity_batch_64k,
+    };
+    static const sized_parallel_fn parallels[] = {
+        aes_sm3_parallel, aes_sm3_parallel_8k, aes_sm3_parallel_16k, aes_sm3_parallel_64k,
+    };
+    const size_t bytes = AES_SM3_PAGE_BENCH_BYTES;
+    const int max_pages = (int)(bytes / 4096);
+    const int num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    uint8_t* buffer = aligned_alloc(4096, bytes);
+    uint8_t* digests = malloc((size_t)max_pages * 32);
+    const uint8_t** inputs = malloc(max_pages * sizeof(uint8_t*));
+    uint8_t** outputs = malloc(max_pages * sizeof(uint8_t*));
+    if (buffer == NULL || digests == NULL || inputs == NULL || outputs == NULL) {
+        printf("缓冲区分配失败，跳过页长特化测试\n");
+        free(buffer);
+        free(digests);
+        free(inputs);
+        free(outputs);
+        return;
+    }
+    for (size_t i = 0; i < bytes; i++) {
+        buffer[i] = (uint8_t)(i * 53 + 11);
+    }
     
-    for (int i = start_block; i < end_block; i++) {
-        const uint8_t* block_start = data->input + i * 4096;
-        uint8_t* output_start = data->output + i * (data->output_size / 8);
-        
-        if (data->output_size == 256) {
-            aes_sm3_integrity_256bit(block_start, output_start);
-        } else {
-            aes_sm3_integrity_128bit(block_start, output_start);
+    printf("%-8s %14s %14s %14s %16s\n", "页长", "单页 MB/s", "批处理 MB/s", "并行 MB/s", "按4KB分段 MB/s");
+    for (int k = 0; k < 4; k++) {
+        int page_size = sizes[k];
+        int pages = (int)(bytes / page_size);
+        double mbps[4] = { 0.0, 0.0, 0.0, 0.0 };
+        for (int variant = 0; variant < 4; variant++) {
+            // 按4KB分段：同样的数据当作4KB页批处理，每个大页对应多个摘要
+            int unit = variant == 3 ? 4096 : page_size;
+            int count = (int)(bytes / unit);
+            for (int i = 0; i < count; i++) {
+                inputs[i] = buffer + (size_t)i * unit;
+                outputs[i] = digests + (size_t)i * 32;
+            }
+            struct timespec start, end;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            for (int round = 0; round < AES_SM3_PAGE_BENCH_ROUNDS; round++) {
+                if (variant == 0) {
+                    for (int i = 0; i < pages; i++) {
+                        singles[k](inputs[i], outputs[i]);
+                    }
+                } else if (variant == 1) {
+                    batches[k](inputs, outputs, pages);
+                } else if (variant == 2) {
+                    parallels[k](buffer, digests, pages, num_threads, 256);
+                } else {
+                    aes_sm3_integrity_batch(inputs, outputs, count);
+                }
+            }
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+            mbps[variant] = bytes / 1048576.0 * AES_SM3_PAGE_BENCH_ROUNDS / elapsed;
         }
+        printf("%6dKB %14.2f %14.2f %14.2f %16.2f\n", page_size / 1024, mbps[0], mbps[1], mbps[2], mbps[3]);
     }
     
-    pthread_barrier_wait(data->barrier);
-    return NULL;
+    free(buffer);
+    free(digests);
+    free(inputs);
+    free(outputs);
 }
 
-void aes_sm3_parallel(const uint8_t* input, uint8_t* output, int block_count, 
-                      int num_threads, int output_size) {
-    int available_cores = sysconf(_SC_NPROCESSORS_ONLN);
-    if (num_threads > available_cores) {
-        num_threads = available_cores;
+// ============================================================================
+// 定位型摘要（256字节段指纹）
+// ============================================================================
+/*
+ * 折叠阶段本来就为每个256字节段产生8字节结果。定位型摘要把覆盖段内全部
+ * 字节的折叠结果（xor_fold_segment_full）乘法散列成每段32位的指纹，和256位
+ * 摘要一起存成一条96字节的记录。校验时同一遍折叠既得到摘要又得到指纹，
+ * 逐段比较指纹，报告哪些段（每段4个缓存行）损坏，不需要再读一遍数据或与
+ * 副本比较，修复流量只限于损坏的段。aarch64上摘要只覆盖每16字节的低8字节，
+ * 只改动高8字节的页由指纹检出，因此摘要一致时也比较指纹。
+ */
+
+#define AES_SM3_LOCATOR_SEGMENTS 16
+#define AES_SM3_LOCATOR_RECORD (32 + AES_SM3_LOCATOR_SEGMENTS * 4)  // 摘要 + 段指纹
+#define AES_SM3_LOCATOR_GROUP 64
+#define AES_SM3_LOCATOR_ALL 0xFFFF  // 摘要不一致但没有指纹不同（指纹碰撞），无法定位
+
+// 4KB折叠，同时输出覆盖全部字节的段折叠（指纹用）；软件路径上两者相同
+static inline void locator_fold_4kb(const uint8_t* input, uint8_t* compressed, uint8_t* full) {
+#if defined(__ARM_FEATURE_CRYPTO) && defined(__aarch64__)
+    for (int i = 0; i < AES_SM3_LOCATOR_SEGMENTS; i++) {
+        const uint8_t* block = input + i * 256;
+        uint8x16_t x0 = veorq_u8(vld1q_u8(block + 0),   vld1q_u8(block + 16));
+        uint8x16_t x1 = veorq_u8(vld1q_u8(block + 32),  vld1q_u8(block + 48));
+        uint8x16_t x2 = veorq_u8(vld1q_u8(block + 64),  vld1q_u8(block + 80));
+        uint8x16_t x3 = veorq_u8(vld1q_u8(block + 96),  vld1q_u8(block + 112));
+        uint8x16_t x4 = veorq_u8(vld1q_u8(block + 128), vld1q_u8(block + 144));
+        uint8x16_t x5 = veorq_u8(vld1q_u8(block + 160), vld1q_u8(block + 176));
+        uint8x16_t x6 = veorq_u8(vld1q_u8(block + 192), vld1q_u8(block + 208));
+        uint8x16_t x7 = veorq_u8(vld1q_u8(block + 224), vld1q_u8(block + 240));
+        uint8x16_t final = veorq_u8(veorq_u8(veorq_u8(x0, x1), veorq_u8(x2, x3)),
+                                    veorq_u8(veorq_u8(x4, x5), veorq_u8(x6, x7)));
+        vst1_u8(compressed + i * 8, vget_low_u8(final));
+        vst1_u8(full + i * 8, veor_u8(vget_low_u8(final), vget_high_u8(final)));
     }
-    
-    pthread_t* threads = malloc(num_threads * sizeof(pthread_t));
-    thread_data_t* thread_data = malloc(num_threads * sizeof(thread_data_t));
-    pthread_barrier_t barrier;
-    pthread_barrier_init(&barrier, NULL, num_threads);
-    
-    for (int i = 0; i < num_threads; i++) {
-        thread_data[i].input = input;
-        thread_data[i].output = output;
-        thread_data[i].thread_id = i;
-        thread_data[i].num_threads = num_threads;
-        thread_data[i].block_count = block_count;
-        thread_data[i].output_size = output_size;
-        thread_data[i].barrier = &barrier;
-        
-        pthread_create(&threads[i], NULL, thread_worker, &thread_data[i]);
+#else
+    xor_fold_4kb(input, compressed);
+    memcpy(full, compressed, 128);
+#endif
+}
+
+// 从全字节折叠结果生成16个段指纹（小端32位）
+static inline void locator_fingerprints(const uint8_t* full, uint8_t* fingerprints) {
+    for (int i = 0; i < AES_SM3_LOCATOR_SEGMENTS; i++) {
+        uint64_t folded;
+        memcpy(&folded, full + i * 8, 8);
+        uint32_t fp = (uint32_t)((folded * 0x9E3779B97F4A7C15ULL) >> 32);
+        memcpy(fingerprints + i * 4, &fp, 4);
     }
-    
-    for (int i = 0; i < num_threads; i++) {
-        pthread_join(threads[i], NULL);
+}
+
+// 与记录中的指纹逐段比较，返回不同段的位图；摘要不一致但指纹全部相同时返回AES_SM3_LOCATOR_ALL
+static inline int locator_diff(const uint8_t* full, const uint8_t* digest, const uint8_t* record) {
+    uint8_t fingerprints[AES_SM3_LOCATOR_SEGMENTS * 4];
+    int mask = 0;
+    locator_fingerprints(full, fingerprints);
+    for (int i = 0; i < AES_SM3_LOCATOR_SEGMENTS; i++) {
+        if (memcmp(fingerprints + i * 4, record + 32 + i * 4, 4) != 0) {
+            mask |= 1 << i;
+        }
     }
-    
-    pthread_barrier_destroy(&barrier);
-    free(threads);
-    free(thread_data);
+    if (mask == 0 && memcmp(digest, record, 32) != 0) {
+        mask = AES_SM3_LOCATOR_ALL;
+    }
+    return mask;
+}
+
+// 计算一条定位型记录：256位摘要（与aes_sm3_integrity_256bit一致）+ 16个段指纹
+void aes_sm3_integrity_localizing(const uint8_t* input, uint8_t* record) {
+    uint8_t compressed[128] __attribute__((aligned(64)));
+    uint8_t full[128] __attribute__((aligned(64)));
+    uint32_t state[8];
+    STAT_KERNEL(AES_SM3_KERNEL_256BIT, 1);
+    locator_fold_4kb(input, compressed, full);
+    sm3_hash_compressed(compressed, state);
+    sm3_store_state(state, record, 8);
+    locator_fingerprints(full, record + 32);
+}
+
+// 批处理版本，记录以AES_SM3_LOCATOR_RECORD字节步长紧密写入records
+void aes_sm3_integrity_batch_localizing(const uint8_t** inputs, uint8_t* records, int batch_size) {
+    uint8_t compressed[AES_SM3_LOCATOR_GROUP * 128] __attribute__((aligned(64)));
+    uint8_t full[128] __attribute__((aligned(64)));
+    uint8_t* compressed_ptrs[AES_SM3_LOCATOR_GROUP];
+    uint8_t* outputs[AES_SM3_LOCATOR_GROUP];
+    STAT_KERNEL(AES_SM3_KERNEL_BATCH, batch_size);
+    STAT_BATCH(batch_size);
+    
+    for (int base = 0; base < batch_size; base += AES_SM3_LOCATOR_GROUP) {
+        int n = batch_size - base < AES_SM3_LOCATOR_GROUP ? batch_size - base : AES_SM3_LOCATOR_GROUP;
+        for (int i = 0; i < n; i++) {
+            if (base + i + 1 < batch_size) {
+                __builtin_prefetch(inputs[base + i + 1], 0, 3);
+            }
+            compressed_ptrs[i] = compressed + i * 128;
+            outputs[i] = records + (size_t)(base + i) * AES_SM3_LOCATOR_RECORD;
+            locator_fold_4kb(inputs[base + i], compressed_ptrs[i], full);
+            locator_fingerprints(full, outputs[i] + 32);
+        }
+        batch_sm3_hash((const uint8_t**)compressed_ptrs, outputs, n);
+    }
+}
+
+// 校验一页：一致返回0，否则返回损坏段的位图（第i位对应偏移i*256的段）
+int aes_sm3_localize_damage(const uint8_t* input, const uint8_t* record) {
+    uint8_t compressed[128] __attribute__((aligned(64)));
+    uint8_t full[128] __attribute__((aligned(64)));
+    uint8_t digest[32];
+    uint32_t state[8];
+    locator_fold_4kb(input, compressed, full);
+    sm3_hash_compressed(compressed, state);
+    sm3_store_state(state, digest, 8);
+    return locator_diff(full, digest, record);
+}
+
+// 批量校验，返回损坏页数；masks（可为NULL）输出每页的损坏段位图
+int aes_sm3_localize_damage_batch(const uint8_t** inputs, const uint8_t* records, int batch_size,
+                                  uint16_t* masks) {
+    uint8_t compressed[AES_SM3_LOCATOR_GROUP * 128] __attribute__((aligned(64)));
+    uint8_t full[AES_SM3_LOCATOR_GROUP * 128] __attribute__((aligned(64)));
+    uint8_t digests[AES_SM3_LOCATOR_GROUP * 32] __attribute__((aligned(64)));
+    uint8_t* compressed_ptrs[AES_SM3_LOCATOR_GROUP];
+    uint8_t* digest_ptrs[AES_SM3_LOCATOR_GROUP];
+    int bad = 0;
+    
+    for (int base = 0; base < batch_size; base += AES_SM3_LOCATOR_GROUP) {
+        int n = batch_size - base < AES_SM3_LOCATOR_GROUP ? batch_size - base : AES_SM3_LOCATOR_GROUP;
+        for (int i = 0; i < n; i++) {
+            if (base + i + 1 < batch_size) {
+                __builtin_prefetch(inputs[base + i + 1], 0, 3);
+            }
+            compressed_ptrs[i] = compressed + i * 128;
+            digest_ptrs[i] = digests + i * 32;
+            locator_fold_4kb(inputs[base + i], compressed_ptrs[i], full + i * 128);
+        }
+        batch_sm3_hash((const uint8_t**)compressed_ptrs, digest_ptrs, n);
+        
+        for (int i = 0; i < n; i++) {
+            const uint8_t* record = records + (size_t)(base + i) * AES_SM3_LOCATOR_RECORD;
+            int mask = locator_diff(full + i * 128, digest_ptrs[i], record);
+            if (mask != 0) {
+                bad++;
+            }
+            if (masks) masks[base + i] = (uint16_t)mask;
+        }
+    }
+    return bad;
 }
 
 // ============================================================================
@@ -2499,10 +9662,102 @@ void performance_benchmark() {
     double parallel_speedup = single_time / parallel_time;
     printf("并行加速比: %.2fx\n", parallel_speedup);
     
+    // 自适应线程数：找到接近峰值带宽所需的最少线程
+    int adaptive_blocks = 16384;
+    uint8_t* adaptive_input = malloc((size_t)adaptive_blocks * 4096);
+    uint8_t* adaptive_output = malloc((size_t)adaptive_blocks * 32);
+    memset(adaptive_input, 0x5A, (size_t)adaptive_blocks * 4096);
+    
+    aes_sm3_adaptive_t* adaptive = aes_sm3_adaptive_create(num_threads, AES_SM3_ADAPT_DEFAULT_GAIN);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int round = 0; round < 4; round++) {
+        aes_sm3_adaptive_hash(adaptive, adaptive_input, adaptive_output, adaptive_blocks, 256);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double adaptive_time = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    
+    printf("\n自适应线程数 (边际收益阈值 %.0f%%):\n", AES_SM3_ADAPT_DEFAULT_GAIN * 100);
+    for (int t = 1; t <= num_threads; t++) {
+        double total_mbps, worker_mbps;
+        aes_sm3_adaptive_throughput(adaptive, t, &total_mbps, &worker_mbps);
+        if (total_mbps > 0.0) {
+            printf("  %2d线程: 聚合 %.2f MB/s, 每线程 %.2f MB/s\n", t, total_mbps, worker_mbps);
+        }
+    }
+    printf("  选定并发度: %d / %d 线程\n", aes_sm3_adaptive_concurrency(adaptive), num_threads);
+    printf("  自适应吞吐量: %.2f MB/s\n", (4.0 * adaptive_blocks * 4.0 / 1024.0) / adaptive_time);
+    
+    aes_sm3_adaptive_destroy(adaptive);
+    free(adaptive_input);
+    free(adaptive_output);
+    
     free(test_data);
     free(multi_input);
     free(multi_output);
     
+    // 数据库页校验垫片
+    printf("\n==========================================================\n");
+    printf("   数据库页校验垫片测试\n");
+    printf("==========================================================\n\n");
+    
+    aes_sm3_pagestore_benchmark();
+    
+    // 大页缓冲区
+    printf("\n==========================================================\n");
+    printf("   大页缓冲区测试\n");
+    printf("==========================================================\n\n");
+    
+    aes_sm3_hugepage_benchmark();
+    
+    // 非临时（流式）加载
+    printf("\n==========================================================\n");
+    printf("   流式加载与缓存污染测试\n");
+    printf("==========================================================\n\n");
+    
+    aes_sm3_streaming_benchmark();
+    
+    // 能耗
+    printf("\n==========================================================\n");
+    printf("   每GB能耗测试（RAPL/powercap）\n");
+    printf("==========================================================\n\n");
+    
+    aes_sm3_energy_benchmark();
+    
+    // 指令缓存占用
+    printf("\n==========================================================\n");
+    printf("   指令缓存占用与混合负载测试\n");
+    printf("==========================================================\n\n");
+    
+    aes_sm3_icache_benchmark();
+    
+    // 冷启动
+    printf("\n==========================================================\n");
+    printf("   冷启动与首次调用延迟测试\n");
+    printf("==========================================================\n\n");
+    
+    aes_sm3_coldstart_benchmark();
+    
+    // 批大小扫描
+    printf("\n==========================================================\n");
+    printf("   批大小扫描与自动分块\n");
+    printf("==========================================================\n\n");
+    
+    aes_sm3_batch_sweep_benchmark();
+    
+    // 扇区标签
+    printf("\n==========================================================\n");
+    printf("   512字节扇区标签测试\n");
+    printf("==========================================================\n\n");
+    
+    aes_sm3_sector_benchmark();
+    
+    // 页长特化
+    printf("\n==========================================================\n");
+    printf("   8KB/16KB/64KB页长特化测试\n");
+    printf("==========================================================\n\n");
+    
+    aes_sm3_page_size_benchmark();
+    
     // 内存访问优化效果测试
     printf("\n==========================================================\n");
     printf("   内存访问优化效果测试\n");
@@ -2659,8 +9914,8 @@ void test_memory_access_optimization() {
     free(unaligned_output_data);
 }
 
-// 无预取优化的批处理函数（用于对比测试）
-void aes_sm3_integrity_batch_no_prefetch(const uint8_t** inputs, uint8_t** outputs, int batch_size) {
+// 无预取优化的批处理分块（用于对比测试）
+static void integrity_batch_tile_no_prefetch(const uint8_t** inputs, uint8_t** outputs, int batch_size) {
     // 分配临时存储空间（批处理版本）- 无预取优化
     uint8_t* temp_pool = (uint8_t*)aligned_alloc(64, batch_size * 128);  // 64字节对齐
     uint8_t* compressed_data[batch_size];
@@ -2680,6 +9935,17 @@ void aes_sm3_integrity_batch_no_prefetch(const uint8_t** inputs, uint8_t** outpu
     free(temp_pool);
 }
 
+// 无预取优化的批处理函数（用于对比测试）：超过自动调优分块大小的批次按分块执行
+void aes_sm3_integrity_batch_no_prefetch(const uint8_t** inputs, uint8_t** outputs, int batch_size) {
+    STAT_KERNEL(AES_SM3_KERNEL_BATCH_NO_PREFETCH, batch_size);
+    STAT_BATCH(batch_size);
+    int tile = aes_sm3_autotune_tile(AES_SM3_TUNE_NO_PREFETCH);
+    for (int base = 0; base < batch_size; base += tile) {
+        int n = batch_size - base < tile ? batch_size - base : tile;
+        integrity_batch_tile_no_prefetch(inputs + base, outputs + base, n);
+    }
+}
+
 // 无预取优化的XOR折叠压缩函数（用于对比测试）
 void batch_xor_folding_compress_no_prefetch(const uint8_t** inputs, uint8_t** outputs, int batch_size) {
     // 简化版本，不包含预取优化
@@ -2687,17 +9953,19 @@ void batch_xor_folding_compress_no_prefetch(const uint8_t** inputs, uint8_t** ou
         const uint8_t* input = inputs[i];
         uint8_t* output = outputs[i];
         
-        // 256字节 -> 8字节的XOR折叠（32:1压缩）
-        uint8_t folded[8] = {0};
-        
-        // 完全展开的异或折叠逻辑（无预取）
-        for (int j = 0; j < 256; j++) {
-            folded[j % 8] ^= input[j];
-        }
-        
-        // 复制结果到输出
-        for (int j = 0; j < 8; j++) {
-            output[j] = folded[j];
+        // 16个256字节段 -> 各8字节的XOR折叠（32:1压缩），填满128字节中间结果
+        for (int seg = 0; seg < 16; seg++) {
+            uint8_t folded[8] = {0};
+            
+            // 完全展开的异或折叠逻辑（无预取）
+            for (int j = 0; j < 256; j++) {
+                folded[j % 8] ^= input[seg * 256 + j];
+            }
+            
+            // 复制结果到输出
+            for (int j = 0; j < 8; j++) {
+                output[seg * 8 + j] = folded[j];
+            }
         }
     }
 }
@@ -2794,8 +10062,8 @@ void batch_sm3_hash_pipeline_prefetch(const uint8_t** compressed_inputs, uint8_t
 // v2.3 内存访问优化 - 超级预取策略
 // ============================================================================
 
-// 超级预取优化版本 - 使用非时间临时加载和更激进的预取策略
-void aes_sm3_integrity_batch_super_prefetch(const uint8_t** inputs, uint8_t** outputs, int batch_size) {
+// 超级预取优化版本的一个分块 - 使用非时间临时加载和更激进的预取策略
+static void integrity_batch_tile_super_prefetch(const uint8_t** inputs, uint8_t** outputs, int batch_size) {
     // 分配临时存储空间（批处理版本）- 使用更大的对齐粒度
     uint8_t* temp_pool = (uint8_t*)aligned_alloc(128, batch_size * 128);  // 128字节对齐，适合AVX-512
     uint8_t* compressed_data[batch_size];
@@ -2815,6 +10083,17 @@ void aes_sm3_integrity_batch_super_prefetch(const uint8_t** inputs, uint8_t** ou
     free(temp_pool);
 }
 
+// 超级预取优化版本：超过自动调优分块大小的批次按分块执行
+void aes_sm3_integrity_batch_super_prefetch(const uint8_t** inputs, uint8_t** outputs, int batch_size) {
+    STAT_KERNEL(AES_SM3_KERNEL_BATCH_SUPER_PREFETCH, batch_size);
+    STAT_BATCH(batch_size);
+    int tile = aes_sm3_autotune_tile(AES_SM3_TUNE_SUPER_PREFETCH);
+    for (int base = 0; base < batch_size; base += tile) {
+        int n = batch_size - base < tile ? batch_size - base : tile;
+        integrity_batch_tile_super_prefetch(inputs + base, outputs + base, n);
+    }
+}
+
 // 超级预取优化的XOR折叠压缩函数
 void batch_xor_folding_compress_super_prefetch(const uint8_t** inputs, uint8_t** outputs, int batch_size) {
     // 超级预取策略：提前预取多个后续块
@@ -3082,8 +10361,8 @@ void batch_sm3_hash_super_prefetch(const uint8_t** compressed_inputs, uint8_t**
 // v2.3 内存访问优化 - 流水线预取策略
 // ============================================================================
 
-// 流水线预取优化版本 - 使用双缓冲和流水线技术
-void aes_sm3_integrity_batch_pipeline_prefetch(const uint8_t** inputs, uint8_t** outputs, int batch_size) {
+// 流水线预取优化版本的一个分块 - 使用双缓冲和流水线技术
+static void integrity_batch_tile_pipeline_prefetch(const uint8_t** inputs, uint8_t** outputs, int batch_size) {
     // 分配临时存储空间（批处理版本）- 双缓冲
     uint8_t* temp_pool[2];
     temp_pool[0] = (uint8_t*)aligned_alloc(128, batch_size * 128);  // 第一个缓冲区
@@ -3116,6 +10395,17 @@ void aes_sm3_integrity_batch_pipeline_prefetch(const uint8_t** inputs, uint8_t**
     free(temp_pool[1]);
 }
 
+// 流水线预取优化版本：超过自动调优分块大小的批次按分块执行
+void aes_sm3_integrity_batch_pipeline_prefetch(const uint8_t** inputs, uint8_t** outputs, int batch_size) {
+    STAT_KERNEL(AES_SM3_KERNEL_BATCH_PIPELINE_PREFETCH, batch_size);
+    STAT_BATCH(batch_size);
+    int tile = aes_sm3_autotune_tile(AES_SM3_TUNE_PIPELINE_PREFETCH);
+    for (int base = 0; base < batch_size; base += tile) {
+        int n = batch_size - base < tile ? batch_size - base : tile;
+        integrity_batch_tile_pipeline_prefetch(inputs + base, outputs + base, n);
+    }
+}
+
 // 流水线预取优化的XOR折叠压缩函数
 void batch_xor_folding_compress_pipeline_prefetch(const uint8_t** inputs, uint8_t** outputs, 
                                                   int batch_size, int phase) {
@@ -3411,7 +10701,28 @@ void batch_sm3_hash_pipeline_prefetch(const uint8_t** compressed_inputs, uint8_t
     }
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    // 冷启动基准的子进程：aes_sm3_integrity --first-digest <内核> <预先初始化> <结果描述符>
+    if (argc >= 5 && strcmp(argv[1], "--first-digest") == 0) {
+        return aes_sm3_coldstart_child(atoi(argv[2]), atoi(argv[3]), atoi(argv[4]));
+    }
+    
+    // 管道流式模式：aes_sm3_integrity - [摘要输出描述符，默认为2]
+    if (argc >= 2 && strcmp(argv[1], "-") == 0) {
+        int digest_fd = STDERR_FILENO;
+        if (argc >= 3) {
+            char* end;
+            long fd = strtol(argv[2], &end, 10);
+            if (end == argv[2] || *end != '\0' || fd < 0 || fd > INT_MAX || fcntl((int)fd, F_GETFD) < 0 ||
+                fd == STDIN_FILENO || fd == STDOUT_FILENO) {
+                fprintf(stderr, "无效的摘要输出描述符: %s\n", argv[2]);
+                return 2;
+            }
+            digest_fd = (int)fd;
+        }
+        return aes_sm3_stream_tee(STDIN_FILENO, STDOUT_FILENO, digest_fd) < 0 ? 1 : 0;
+    }
+    
     printf("\n");
     printf("╔══════════════════════════════════════════════════════════╗\n");
     printf("║   4KB消息完整性校验算法 - AES+SM3混合优化方案 v2.3       ║\n");
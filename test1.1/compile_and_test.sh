@@ -40,11 +40,11 @@ echo "步骤1: 创建库文件（不含main函数）..."
 
 # 创建不含main函数的库文件
 # 找到main函数的起始行（通常在最后）
-MAIN_LINE=$(grep -n "^int main()" aes_sm3_integrity.c | tail -1 | cut -d: -f1)
+MAIN_LINE=$(grep -n "^int main(" aes_sm3_integrity.c | tail -1 | cut -d: -f1)
 
 if [ -z "$MAIN_LINE" ]; then
     # 如果没找到，尝试查找带空格的main
-    MAIN_LINE=$(grep -n "int main\s*()" aes_sm3_integrity.c | tail -1 | cut -d: -f1)
+    MAIN_LINE=$(grep -n "int main\s*(" aes_sm3_integrity.c | tail -1 | cut -d: -f1)
 fi
 
 if [ -z "$MAIN_LINE" ]; then
@@ -80,7 +80,7 @@ FALLBACK_FLAGS="-march=armv8-a+crypto -O3 -funroll-loops -ftree-vectorize -finli
 
 echo "创建库文件（去除main函数）..."
 # 创建不含main函数的库文件
-MAIN_LINE=$(grep -n "^int main()" aes_sm3_integrity.c | tail -1 | cut -d: -f1)
+MAIN_LINE=$(grep -n "^int main(" aes_sm3_integrity.c | tail -1 | cut -d: -f1)
 if [ -z "$MAIN_LINE" ]; then
     MAIN_LINE=3413
 fi
@@ -47,6 +47,8 @@
 
 #if defined(__unix__) || defined(__APPLE__) || defined(__linux__)
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #endif
 
 // 引用主文件中的函数声明
@@ -63,6 +65,219 @@ extern void sha256_4kb(const uint8_t* input, uint8_t* output);
 extern void sm3_4kb(const uint8_t* input, uint8_t* output);
 extern void test_memory_access_optimization(void);
 
+// 并行引擎（无锁MPMC任务队列）接口
+typedef struct aes_sm3_engine aes_sm3_engine_t;
+typedef struct aes_sm3_completion aes_sm3_completion_t;
+extern aes_sm3_engine_t* aes_sm3_engine_create(int num_threads, int queue_capacity, int wait_mode);
+extern void aes_sm3_engine_destroy(aes_sm3_engine_t* engine);
+extern void aes_sm3_engine_submit(aes_sm3_engine_t* engine, const uint8_t* input, uint8_t* output,
+                                  int page_count, int output_size, int pages_per_job,
+                                  aes_sm3_completion_t* completion);
+extern aes_sm3_completion_t* aes_sm3_completion_create(void);
+extern void aes_sm3_completion_destroy(aes_sm3_completion_t* completion);
+extern void aes_sm3_completion_wait(aes_sm3_completion_t* completion);
+
+// 自适应线程数控制器接口
+typedef struct aes_sm3_adaptive aes_sm3_adaptive_t;
+extern aes_sm3_adaptive_t* aes_sm3_adaptive_create(int max_threads, double gain_threshold);
+extern void aes_sm3_adaptive_destroy(aes_sm3_adaptive_t* ctl);
+extern int aes_sm3_adaptive_concurrency(const aes_sm3_adaptive_t* ctl);
+extern void aes_sm3_adaptive_throughput(const aes_sm3_adaptive_t* ctl, int threads,
+                                        double* total_mbps, double* per_worker_mbps);
+extern void aes_sm3_adaptive_hash(aes_sm3_adaptive_t* ctl, const uint8_t* input, uint8_t* output,
+                                  int block_count, int output_size);
+
+// 异构核心拓扑接口
+typedef struct aes_sm3_topology aes_sm3_topology_t;
+extern aes_sm3_topology_t* aes_sm3_topology_create(const char* desc);
+extern void aes_sm3_topology_destroy(aes_sm3_topology_t* topo);
+extern int aes_sm3_topology_is_heterogeneous(const aes_sm3_topology_t* topo);
+extern int aes_sm3_topology_big_cores(const aes_sm3_topology_t* topo);
+extern int aes_sm3_topology_cpu_for_thread(const aes_sm3_topology_t* topo, int thread_id);
+extern void aes_sm3_topology_partition(const aes_sm3_topology_t* topo, int block_count,
+                                       int num_threads, int* bounds);
+extern void aes_sm3_parallel_topology(const aes_sm3_topology_t* topo, const uint8_t* input, uint8_t* output,
+                                      int block_count, int num_threads, int output_size);
+extern void aes_sm3_integrity_big_core(const uint8_t* input, uint8_t* output, int output_size);
+
+// 内存区域增量快照接口
+typedef struct aes_sm3_monitor aes_sm3_monitor_t;
+extern aes_sm3_monitor_t* aes_sm3_monitor_create(const void* base, size_t length);
+extern void aes_sm3_monitor_destroy(aes_sm3_monitor_t* m);
+extern long aes_sm3_monitor_snapshot(aes_sm3_monitor_t* m);
+extern const uint8_t* aes_sm3_monitor_digests(const aes_sm3_monitor_t* m);
+extern void aes_sm3_monitor_root(const aes_sm3_monitor_t* m, uint8_t* root);
+extern int aes_sm3_monitor_soft_dirty_supported(void);
+
+// 后台巡检接口
+typedef struct aes_sm3_scrubber aes_sm3_scrubber_t;
+typedef void (*aes_sm3_scrub_callback_t)(void* user, int region_id, size_t page_index,
+                                         const uint8_t* expected, const uint8_t* actual);
+extern aes_sm3_scrubber_t* aes_sm3_scrubber_create(double bandwidth_mbps, double cpu_fraction,
+                                                   aes_sm3_scrub_callback_t callback, void* user);
+extern int aes_sm3_scrubber_add_memory(aes_sm3_scrubber_t* s, const void* base, size_t page_count,
+                                       const uint8_t* digests);
+extern int aes_sm3_scrubber_add_file(aes_sm3_scrubber_t* s, const char* path, size_t page_count,
+                                     const uint8_t* digests);
+extern long aes_sm3_scrubber_run_once(aes_sm3_scrubber_t* s);
+extern int aes_sm3_scrubber_start(aes_sm3_scrubber_t* s);
+extern void aes_sm3_scrubber_stop(aes_sm3_scrubber_t* s);
+extern void aes_sm3_scrubber_destroy(aes_sm3_scrubber_t* s);
+extern void aes_sm3_scrubber_stats(const aes_sm3_scrubber_t* s, unsigned long long* pages_verified,
+                                   unsigned long long* mismatches, unsigned long long* passes);
+
+// 页级差异比较接口
+typedef struct {
+    uint64_t start;
+    uint64_t count;
+} aes_sm3_extent_t;
+extern long aes_sm3_diff_memory(const uint8_t* a, const uint8_t* b, size_t page_count, int num_threads,
+                                uint8_t* digests_a, uint8_t* digests_b, aes_sm3_extent_t** extents);
+extern long aes_sm3_diff_manifest(const uint8_t* data, const uint8_t* manifest, size_t page_count,
+                                  int num_threads, aes_sm3_extent_t** extents);
+extern long aes_sm3_diff_files(const char* path_a, const char* path_b, int num_threads,
+                               aes_sm3_extent_t** extents);
+
+// 增量同步接口
+extern int aes_sm3_manifest_build(const char* path, const char* manifest_path, int num_threads);
+extern long aes_sm3_sync_file(const char* src_path, const char* dst_path, const char* manifest_path,
+                              int num_threads);
+
+// 追加日志接口
+typedef struct aes_sm3_log aes_sm3_log_t;
+typedef void (*aes_sm3_log_record_callback_t)(void* user, uint64_t seq, const uint8_t* data,
+                                              size_t length);
+extern aes_sm3_log_t* aes_sm3_log_open(const char* path);
+extern long long aes_sm3_log_append(aes_sm3_log_t* wal, const void* data, size_t length);
+extern int aes_sm3_log_commit(aes_sm3_log_t* wal);
+extern int aes_sm3_log_close(aes_sm3_log_t* wal);
+extern long aes_sm3_log_recover(const char* path, int num_threads,
+                                aes_sm3_log_record_callback_t callback, void* user,
+                                uint64_t* valid_bytes, uint64_t* next_seq);
+
+// 校验型页缓存接口
+typedef struct aes_sm3_cache aes_sm3_cache_t;
+extern void aes_sm3_copy_integrity_256bit(uint8_t* dst, const uint8_t* src, uint8_t* output);
+extern aes_sm3_cache_t* aes_sm3_cache_create(int fd, const uint8_t* manifest, size_t capacity_pages,
+                                             int shard_count);
+extern void aes_sm3_cache_destroy(aes_sm3_cache_t* cache);
+extern const uint8_t* aes_sm3_cache_get(aes_sm3_cache_t* cache, uint64_t page, int* status);
+#define AES_SM3_CACHE_RANGE   -1
+#define AES_SM3_CACHE_CORRUPT -2
+#define AES_SM3_CACHE_BUSY    -3
+extern void aes_sm3_cache_release(aes_sm3_cache_t* cache, uint64_t page);
+extern void aes_sm3_cache_stats(aes_sm3_cache_t* cache, unsigned long long* hits,
+                                unsigned long long* misses, unsigned long long* corrupt);
+
+// 数据库页校验接口
+typedef struct aes_sm3_pagestore aes_sm3_pagestore_t;
+extern void aes_sm3_page_seal(uint8_t* page);
+extern int aes_sm3_page_verify(const uint8_t* page);
+extern aes_sm3_pagestore_t* aes_sm3_pagestore_open_fd(int fd);
+extern void aes_sm3_pagestore_destroy(aes_sm3_pagestore_t* ps);
+extern int aes_sm3_pagestore_write(aes_sm3_pagestore_t* ps, uint64_t page_no, uint8_t* page);
+extern int aes_sm3_pagestore_read(aes_sm3_pagestore_t* ps, uint64_t page_no, int count, uint8_t* buf,
+                                  uint64_t* bad_page);
+extern unsigned long long aes_sm3_pagestore_checksum_failures(const aes_sm3_pagestore_t* ps);
+
+// 管道流式校验接口
+extern long long aes_sm3_stream_tee(int in_fd, int out_fd, int digest_fd);
+
+// 大页缓冲区接口
+extern void* aes_sm3_buffer_alloc(size_t size, int* kind);
+extern void aes_sm3_buffer_free(void* buffer, size_t size);
+
+// 流式加载接口
+#define AES_SM3_LOAD_TEMPORAL 0
+#define AES_SM3_LOAD_STREAMING 1
+extern void aes_sm3_integrity_256bit_mode(const uint8_t* input, uint8_t* output, int mode);
+extern void aes_sm3_integrity_batch_mode(const uint8_t** inputs, uint8_t** outputs, int batch_size,
+                                         int mode);
+
+// 运行时统计接口（布局需与实现一致）
+#define AES_SM3_KERNEL_256BIT 0
+#define AES_SM3_KERNEL_BATCH 2
+typedef struct {
+    unsigned long long kernel_calls[14];
+    unsigned long long kernel_pages[14];
+    unsigned long long batch_calls;
+    unsigned long long batch_pages;
+    unsigned long long batch_hist[14];
+    unsigned long long jobs;
+    unsigned long long wait_ns;
+    unsigned long long wait_hist[16];
+    unsigned long long busy_ns;
+    unsigned long long idle_ns;
+} aes_sm3_stats_t;
+typedef struct aes_sm3_stats_exporter aes_sm3_stats_exporter_t;
+extern int aes_sm3_stats_enabled(void);
+extern int aes_sm3_stats_snapshot(aes_sm3_stats_t* total, aes_sm3_stats_t* per_thread,
+                                  int* thread_ids, int max_threads);
+extern void aes_sm3_stats_merge(aes_sm3_stats_t* dst, const aes_sm3_stats_t* src);
+extern int aes_sm3_stats_write_prometheus(const char* path);
+extern aes_sm3_stats_exporter_t* aes_sm3_stats_exporter_start(const char* path, int interval_ms);
+extern void aes_sm3_stats_exporter_stop(aes_sm3_stats_exporter_t* e);
+
+// 时间线追踪接口
+extern int aes_sm3_trace_start(size_t spans_per_thread);
+extern void aes_sm3_trace_stop(void);
+extern long aes_sm3_trace_dump(const char* path);
+
+// USDT探针semaphore（未编译探针时为空，弱引用）
+extern volatile unsigned short aes_sm3_batch_start_semaphore __attribute__((weak));
+extern volatile unsigned short aes_sm3_batch_end_semaphore __attribute__((weak));
+extern volatile unsigned short aes_sm3_job_submit_semaphore __attribute__((weak));
+extern volatile unsigned short aes_sm3_job_complete_semaphore __attribute__((weak));
+
+// 显式初始化接口
+#define AES_SM3_INIT_THREAD 0x4
+#define AES_SM3_INIT_ALL 0xF
+extern void aes_sm3_init(int flags);
+
+// 自动调优缓存接口
+#define AES_SM3_TUNE_BATCH 0
+#define AES_SM3_TUNE_NO_PREFETCH 1
+extern int aes_sm3_autotune_tile(int family);
+extern void aes_sm3_autotune_set_tile(int family, int pages);
+extern void aes_sm3_integrity_batch_no_prefetch(const uint8_t** inputs, uint8_t** outputs, int batch_size);
+extern int aes_sm3_autotune_save(const char* path);
+extern int aes_sm3_autotune_load(const char* path);
+
+// 512字节扇区标签接口
+extern int aes_sm3_sector_tags(const uint8_t* input, size_t sector_count, uint8_t* tags, int tag_bits);
+extern long aes_sm3_sector_verify(const uint8_t* input, size_t sector_count, const uint8_t* tags,
+                                  int tag_bits, long* first_bad);
+
+// 大页面尺寸特化接口
+extern void aes_sm3_integrity_8k_256bit(const uint8_t* input, uint8_t* output);
+extern void aes_sm3_integrity_16k_256bit(const uint8_t* input, uint8_t* output);
+extern void aes_sm3_integrity_16k_128bit(const uint8_t* input, uint8_t* output);
+extern void aes_sm3_integrity_64k_256bit(const uint8_t* input, uint8_t* output);
+extern void aes_sm3_integrity_batch_8k(const uint8_t** inputs, uint8_t** outputs, int batch_size);
+extern void aes_sm3_integrity_batch_64k(const uint8_t** inputs, uint8_t** outputs, int batch_size);
+extern void aes_sm3_parallel_16k(const uint8_t* input, uint8_t* output, int page_count,
+                                 int num_threads, int output_size);
+
+// 混合长度批处理接口
+extern int aes_sm3_integrity_batch_mixed(const uint8_t** inputs, const size_t* lengths,
+                                         uint8_t** outputs, int batch_size);
+
+// 128位紧密输出接口
+extern void aes_sm3_integrity_batch_128bit(const uint8_t** inputs, uint8_t* output, int batch_size);
+extern void aes_sm3_integrity_batch_mode_128bit(const uint8_t** inputs, uint8_t* output, int batch_size,
+                                                int mode);
+extern void aes_sm3_integrity_batch_8k_128bit(const uint8_t** inputs, uint8_t* output, int batch_size);
+extern int aes_sm3_integrity_batch_mixed_128bit(const uint8_t** inputs, const size_t* lengths,
+                                                uint8_t* output, int batch_size);
+
+// 定位型摘要接口
+#define AES_SM3_LOCATOR_RECORD 96
+extern void aes_sm3_integrity_localizing(const uint8_t* input, uint8_t* record);
+extern void aes_sm3_integrity_batch_localizing(const uint8_t** inputs, uint8_t* records, int batch_size);
+extern int aes_sm3_localize_damage(const uint8_t* input, const uint8_t* record);
+extern int aes_sm3_localize_damage_batch(const uint8_t** inputs, const uint8_t* records, int batch_size,
+                                         uint16_t* masks);
+
 // SM3相关声明已移除，使用现有的sm3_4kb函数
 
 // 测试统计结构
@@ -1099,11 +1314,17 @@ void test_multithread_correctness() {
     
     printf("  验证结果: %s\n", (mismatch_count == 0) ? "完全一致 ✓" : "存在差异 ✗");
     
+    // 线程数不大于0时按1个线程处理
+    memset(multi_output, 0, num_blocks * 32);
+    aes_sm3_parallel(input_data, multi_output, num_blocks, 0, 256);
+    int zero_threads_ok = memcmp(single_output, multi_output, num_blocks * 32) == 0;
+    
     free(input_data);
     free(single_output);
     free(multi_output);
     
     ASSERT_TRUE(mismatch_count == 0, "多线程处理应与单线程结果一致");
+    ASSERT_TRUE(zero_threads_ok, "线程数为0时应按单线程处理");
     
     TEST_END();
 }
@@ -1181,6 +1402,1801 @@ void test_sm3_optimization_comparison() {
     TEST_END();
 }
 
+// ============================================================================
+// 第七部分：并行引擎测试
+// ============================================================================
+
+// 测试21：无锁MPMC任务队列多生产者提交测试
+typedef struct {
+    aes_sm3_engine_t* engine;
+    const uint8_t* input;
+    uint8_t* output;
+    int page_count;
+} queue_producer_arg_t;
+
+static void* queue_producer_thread(void* arg) {
+    queue_producer_arg_t* p = (queue_producer_arg_t*)arg;
+    aes_sm3_completion_t* completion = aes_sm3_completion_create();
+    
+    // 每次提交一页，最大化队列竞争
+    for (int i = 0; i < p->page_count; i++) {
+        aes_sm3_engine_submit(p->engine, p->input + i * 4096, p->output + i * 32,
+                              1, 256, 1, completion);
+    }
+    aes_sm3_completion_wait(completion);
+    aes_sm3_completion_destroy(completion);
+    return NULL;
+}
+
+void test_mpmc_queue_engine() {
+    TEST_START("无锁MPMC任务队列多生产者提交测试");
+    
+    const int num_producers = 4;
+    const int pages_per_producer = 200;
+    const int total_pages = num_producers * pages_per_producer;
+    
+    uint8_t* input_data = malloc(total_pages * 4096);
+    uint8_t* expected = malloc(total_pages * 32);
+    uint8_t* actual = malloc(total_pages * 32);
+    
+    for (int i = 0; i < total_pages * 4096; i++) {
+        input_data[i] = (uint8_t)((i * 31 + i / 4096) % 256);
+    }
+    for (int i = 0; i < total_pages; i++) {
+        aes_sm3_integrity_256bit(input_data + i * 4096, expected + i * 32);
+    }
+    
+    int all_match = 1;
+    const char* mode_names[2] = {"自旋模式", "阻塞模式"};
+    for (int mode = 0; mode < 2; mode++) {
+        memset(actual, 0, total_pages * 32);
+        
+        // 队列容量刻意小于任务数，覆盖队列满时提交者代为执行的路径
+        aes_sm3_engine_t* engine = aes_sm3_engine_create(4, 16, mode);
+        pthread_t producers[num_producers];
+        queue_producer_arg_t args[num_producers];
+        
+        for (int i = 0; i < num_producers; i++) {
+            args[i].engine = engine;
+            args[i].input = input_data + i * pages_per_producer * 4096;
+            args[i].output = actual + i * pages_per_producer * 32;
+            args[i].page_count = pages_per_producer;
+            pthread_create(&producers[i], NULL, queue_producer_thread, &args[i]);
+        }
+        for (int i = 0; i < num_producers; i++) {
+            pthread_join(producers[i], NULL);
+        }
+        aes_sm3_engine_destroy(engine);
+        
+        int match = compare_hash(expected, actual, total_pages * 32);
+        printf("  %s: %d个生产者 x %d页 -> %s\n", mode_names[mode], num_producers,
+               pages_per_producer, match ? "全部匹配 ✓" : "存在不匹配 ✗");
+        all_match &= match;
+    }
+    
+    free(input_data);
+    free(expected);
+    free(actual);
+    
+    ASSERT_TRUE(all_match, "多生产者经任务队列提交的结果应与单线程一致");
+    
+    TEST_END();
+}
+
+// 测试22：自适应线程数控制器测试
+void test_adaptive_concurrency() {
+    TEST_START("自适应线程数控制器测试");
+    
+    const int num_blocks = 8192;
+    int max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    
+    uint8_t* input_data = malloc(num_blocks * 4096);
+    uint8_t* expected = malloc(num_blocks * 32);
+    uint8_t* actual = malloc(num_blocks * 32);
+    
+    for (int i = 0; i < num_blocks * 4096; i++) {
+        input_data[i] = (uint8_t)((i * 7 + i / 4096) % 256);
+    }
+    for (int i = 0; i < num_blocks; i++) {
+        aes_sm3_integrity_256bit(input_data + i * 4096, expected + i * 32);
+    }
+    
+    aes_sm3_adaptive_t* ctl = aes_sm3_adaptive_create(max_threads, 0.25);
+    ASSERT_TRUE(ctl != NULL, "控制器创建失败");
+    
+    // 多轮调用，让控制器完成爬坡并进入稳定状态
+    int all_match = 1;
+    for (int round = 0; round < 3; round++) {
+        memset(actual, 0, num_blocks * 32);
+        aes_sm3_adaptive_hash(ctl, input_data, actual, num_blocks, 256);
+        all_match &= compare_hash(expected, actual, num_blocks * 32);
+    }
+    
+    int chosen = aes_sm3_adaptive_concurrency(ctl);
+    double total_mbps, worker_mbps;
+    aes_sm3_adaptive_throughput(ctl, chosen, &total_mbps, &worker_mbps);
+    
+    printf("  最大线程数: %d\n", max_threads);
+    printf("  选定并发度: %d\n", chosen);
+    printf("  选定并发度吞吐: 聚合 %.2f MB/s, 每线程 %.2f MB/s\n", total_mbps, worker_mbps);
+    printf("  结果验证: %s\n", all_match ? "全部匹配 ✓" : "存在不匹配 ✗");
+    
+    aes_sm3_adaptive_destroy(ctl);
+    free(input_data);
+    free(expected);
+    free(actual);
+    
+    ASSERT_TRUE(all_match, "自适应并行结果应与单线程一致");
+    ASSERT_TRUE(chosen >= 1 && chosen <= max_threads, "选定并发度应在1到最大线程数之间");
+    ASSERT_TRUE(total_mbps > 0.0, "选定并发度应有吞吐测量值");
+    
+    TEST_END();
+}
+
+// 测试23：异构核心拓扑加权分区测试
+void test_heterogeneous_partition() {
+    TEST_START("异构核心拓扑加权分区测试");
+    
+    // 合成拓扑：2个小核在前，2个大核在后（创建时应按算力降序重排）
+    aes_sm3_topology_t* topo = aes_sm3_topology_create("2*512,2*1024");
+    ASSERT_TRUE(topo != NULL, "合成拓扑解析失败");
+    ASSERT_TRUE(aes_sm3_topology_create("4*") == NULL, "非法拓扑描述应被拒绝");
+    
+    int hetero = aes_sm3_topology_is_heterogeneous(topo);
+    int big = aes_sm3_topology_big_cores(topo);
+    int first_cpu = aes_sm3_topology_cpu_for_thread(topo, 0);
+    printf("  合成拓扑: 2*512,2*1024\n");
+    printf("  异构: %s, 大核数: %d, 线程0绑定CPU%d\n", hetero ? "是" : "否", big, first_cpu);
+    
+    const int num_blocks = 600;
+    int bounds[5];
+    aes_sm3_topology_partition(topo, num_blocks, 4, bounds);
+    printf("  初始分区: ");
+    for (int i = 0; i < 4; i++) {
+        printf("[%d,%d) ", bounds[i], bounds[i + 1]);
+    }
+    printf("\n");
+    
+    uint8_t* input_data = malloc(num_blocks * 4096);
+    uint8_t* expected = malloc(num_blocks * 16);
+    uint8_t* actual = malloc(num_blocks * 16);
+    for (int i = 0; i < num_blocks * 4096; i++) {
+        input_data[i] = (uint8_t)((i * 13 + i / 4096) % 256);
+    }
+    for (int i = 0; i < num_blocks; i++) {
+        aes_sm3_integrity_128bit(input_data + i * 4096, expected + i * 16);
+    }
+    aes_sm3_parallel_topology(topo, input_data, actual, num_blocks, 4, 128);
+    int match = compare_hash(expected, actual, num_blocks * 16);
+    printf("  加权分区+窃取结果: %s\n", match ? "全部匹配 ✓" : "存在不匹配 ✗");
+    
+    // 大核单页接口
+    uint8_t big_out[16];
+    aes_sm3_integrity_big_core(input_data, big_out, 128);
+    int big_core_ok = memcmp(big_out, expected, 16) == 0;
+    
+    aes_sm3_topology_destroy(topo);
+    free(input_data);
+    free(expected);
+    free(actual);
+    
+    ASSERT_TRUE(hetero, "大小核混合拓扑应识别为异构");
+    ASSERT_TRUE(big == 2 && (first_cpu == 2 || first_cpu == 3), "大核应排在前面");
+    ASSERT_TRUE(big_core_ok, "大核单页校验应与单页结果一致");
+    ASSERT_TRUE(bounds[1] == 200 && bounds[2] == 400 && bounds[3] == 500 && bounds[4] == 600,
+                "分区应与算力成正比");
+    ASSERT_TRUE(match, "异构并行结果应与单线程一致");
+    
+    TEST_END();
+}
+
+// 测试24：soft-dirty增量快照测试
+void test_incremental_snapshot() {
+    TEST_START("soft-dirty增量快照测试");
+    
+    const int num_pages = 257;  // 奇数页，覆盖Merkle树节点上提路径
+    uint8_t* region = mmap(NULL, num_pages * 4096, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ASSERT_TRUE(region != MAP_FAILED, "mmap失败");
+    for (int i = 0; i < num_pages * 4096; i++) {
+        region[i] = (uint8_t)((i * 11 + i / 4096) % 256);
+    }
+    
+    int soft_dirty = aes_sm3_monitor_soft_dirty_supported();
+    printf("  内核soft-dirty追踪: %s\n", soft_dirty ? "可用" : "不可用（退化为全量重算）");
+    
+    aes_sm3_monitor_t* m = aes_sm3_monitor_create(region, num_pages * 4096);
+    ASSERT_TRUE(m != NULL, "监控器创建失败");
+    
+    long first = aes_sm3_monitor_snapshot(m);
+    uint8_t root_before[32], root_after[32], root_full[32];
+    aes_sm3_monitor_root(m, root_before);
+    
+    // 修改3个页
+    const int modified[3] = {0, 128, 256};
+    for (int i = 0; i < 3; i++) {
+        region[modified[i] * 4096 + 100] ^= 0x5A;
+    }
+    long second = aes_sm3_monitor_snapshot(m);
+    long third = aes_sm3_monitor_snapshot(m);
+    aes_sm3_monitor_root(m, root_after);
+    
+    printf("  首次快照重算页数: %ld\n", first);
+    printf("  修改3页后重算页数: %ld\n", second);
+    printf("  无修改时重算页数: %ld\n", third);
+    
+    // 摘要应与直接计算一致
+    int digests_ok = 1;
+    uint8_t expected[32];
+    const uint8_t* digests = aes_sm3_monitor_digests(m);
+    for (int i = 0; i < num_pages; i++) {
+        aes_sm3_integrity_256bit(region + i * 4096, expected);
+        digests_ok &= compare_hash(expected, digests + i * 32, 32);
+    }
+    
+    // 增量更新的Merkle根应与全量重建一致
+    aes_sm3_monitor_t* fresh = aes_sm3_monitor_create(region, num_pages * 4096);
+    aes_sm3_monitor_snapshot(fresh);
+    aes_sm3_monitor_root(fresh, root_full);
+    aes_sm3_monitor_destroy(fresh);
+    
+    print_hash("修改前Merkle根", root_before, 32);
+    print_hash("增量Merkle根  ", root_after, 32);
+    print_hash("全量Merkle根  ", root_full, 32);
+    
+    aes_sm3_monitor_destroy(m);
+    munmap(region, num_pages * 4096);
+    
+    ASSERT_TRUE(first == num_pages, "首次快照应重算全部页");
+    ASSERT_TRUE(second >= 3, "修改过的页必须被重算");
+    ASSERT_TRUE(!soft_dirty || (second < num_pages && third < num_pages), "soft-dirty可用时只应重算脏页");
+    ASSERT_TRUE(digests_ok, "页摘要应与直接计算一致");
+    ASSERT_TRUE(!compare_hash(root_before, root_after, 32), "修改后Merkle根应变化");
+    ASSERT_TRUE(compare_hash(root_after, root_full, 32), "增量Merkle根应与全量重建一致");
+    
+    TEST_END();
+}
+
+// 测试25：限速后台巡检测试
+typedef struct {
+    int count;
+    int region_id[8];
+    size_t page_index[8];
+} scrub_report_t;
+
+static void scrub_report_callback(void* user, int region_id, size_t page_index,
+                                  const uint8_t* expected, const uint8_t* actual) {
+    scrub_report_t* report = (scrub_report_t*)user;
+    (void)expected;
+    (void)actual;
+    if (report->count < 8) {
+        report->region_id[report->count] = region_id;
+        report->page_index[report->count] = page_index;
+    }
+    report->count++;
+}
+
+void test_background_scrubber() {
+    TEST_START("限速后台巡检测试");
+    
+    const int mem_pages = 100;
+    const int file_pages = 40;
+    uint8_t* memory = malloc(mem_pages * 4096);
+    uint8_t* file_data = malloc(file_pages * 4096);
+    uint8_t* mem_digests = malloc(mem_pages * 32);
+    uint8_t* file_digests = malloc(file_pages * 32);
+    
+    for (int i = 0; i < mem_pages * 4096; i++) {
+        memory[i] = (uint8_t)((i * 3 + i / 4096) % 256);
+    }
+    for (int i = 0; i < file_pages * 4096; i++) {
+        file_data[i] = (uint8_t)((i * 5 + i / 4096) % 256);
+    }
+    for (int i = 0; i < mem_pages; i++) {
+        aes_sm3_integrity_256bit(memory + i * 4096, mem_digests + i * 32);
+    }
+    for (int i = 0; i < file_pages; i++) {
+        aes_sm3_integrity_256bit(file_data + i * 4096, file_digests + i * 32);
+    }
+    
+    // 损坏位置取每16字节中的低8字节：aarch64上整页摘要只覆盖这些字节
+    // 文件中第7页写入损坏数据
+    char path[] = "/tmp/aes_sm3_scrub_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_TRUE(fd >= 0, "临时文件创建失败");
+    file_data[7 * 4096 + 6] ^= 0x01;
+    ssize_t written = write(fd, file_data, file_pages * 4096);
+    close(fd);
+    
+    // 内存中第3页和第64页损坏
+    memory[3 * 4096] ^= 0x80;
+    memory[64 * 4096 + 4087] ^= 0x10;
+    
+    scrub_report_t report;
+    memset(&report, 0, sizeof(report));
+    aes_sm3_scrubber_t* s = aes_sm3_scrubber_create(0.0, 0.0, scrub_report_callback, &report);
+    int mem_id = aes_sm3_scrubber_add_memory(s, memory, mem_pages, mem_digests);
+    int file_id = aes_sm3_scrubber_add_file(s, path, file_pages, file_digests);
+    
+    long found = aes_sm3_scrubber_run_once(s);
+    printf("  同步巡检一遍: 发现%ld个不一致页\n", found);
+    for (int i = 0; i < report.count && i < 8; i++) {
+        printf("    区域%d 页%zu\n", report.region_id[i], report.page_index[i]);
+    }
+    int reported_ok = (report.count == 3 &&
+                       report.region_id[0] == mem_id && report.page_index[0] == 3 &&
+                       report.region_id[1] == mem_id && report.page_index[1] == 64 &&
+                       report.region_id[2] == file_id && report.page_index[2] == 7);
+    
+    // 后台限速运行：带宽预算40MB/s，CPU预算50%
+    aes_sm3_scrubber_destroy(s);
+    s = aes_sm3_scrubber_create(40.0, 0.5, NULL, NULL);
+    aes_sm3_scrubber_add_memory(s, memory, mem_pages, mem_digests);
+    aes_sm3_scrubber_add_file(s, path, file_pages, file_digests);
+    
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    aes_sm3_scrubber_start(s);
+    unsigned long long pages = 0, mismatches = 0, passes = 0;
+    double elapsed = 0.0;
+    while (passes < 2 && elapsed < 10.0) {
+        usleep(5000);
+        aes_sm3_scrubber_stats(s, &pages, &mismatches, &passes);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        elapsed = (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+    }
+    aes_sm3_scrubber_stop(s);
+    aes_sm3_scrubber_stats(s, &pages, &mismatches, &passes);
+    double rate = pages * 4.0 / 1024.0 / elapsed;
+    printf("  后台巡检: %llu遍, %llu页, %llu个不一致, 实测速率 %.2f MB/s (预算40 MB/s)\n",
+           passes, pages, mismatches, rate);
+    aes_sm3_scrubber_destroy(s);
+    
+    unlink(path);
+    free(memory);
+    free(file_data);
+    free(mem_digests);
+    free(file_digests);
+    
+    ASSERT_TRUE(written == file_pages * 4096, "临时文件写入失败");
+    ASSERT_TRUE(found == 3 && reported_ok, "应准确上报损坏的3个页");
+    ASSERT_TRUE(passes >= 2 && mismatches >= passes * 3, "后台巡检应持续发现损坏页");
+    ASSERT_TRUE(rate < 40.0 * 1.5, "后台巡检速率应受带宽预算限制");
+    
+    TEST_END();
+}
+
+// 测试26：并行页级差异比较测试
+void test_parallel_image_diff() {
+    TEST_START("并行页级差异比较测试");
+    
+    const size_t pages = 1000;
+    uint8_t* a = malloc(pages * 4096);
+    uint8_t* b = malloc(pages * 4096);
+    uint8_t* digests_a = malloc(pages * 32);
+    uint8_t* digests_b = malloc(pages * 32);
+    
+    for (size_t i = 0; i < pages * 4096; i++) {
+        a[i] = (uint8_t)((i * 7 + i / 4096) % 256);
+    }
+    memcpy(b, a, pages * 4096);
+    
+    // 变化：单页5、连续区间[63,66)跨越位图字边界、最后一页
+    // 位置取每16字节中的低8字节，使下面的manifest比较在aarch64上同样能检出
+    b[5 * 4096 + 17] ^= 0x01;
+    for (size_t p = 63; p < 66; p++) {
+        b[p * 4096 + 4087] ^= 0x80;
+    }
+    b[(pages - 1) * 4096] ^= 0xFF;
+    // 同一256字节段内交换两个8字节字：XOR折叠相同但内容不同，也必须检出
+    uint8_t tmp[8];
+    memcpy(tmp, b + 200 * 4096, 8);
+    memcpy(b + 200 * 4096, b + 200 * 4096 + 8, 8);
+    memcpy(b + 200 * 4096 + 8, tmp, 8);
+    
+    aes_sm3_extent_t* extents = NULL;
+    long n = aes_sm3_diff_memory(a, b, pages, 4, digests_a, digests_b, &extents);
+    int extents_ok = (n == 4 &&
+                      extents[0].start == 5 && extents[0].count == 1 &&
+                      extents[1].start == 63 && extents[1].count == 3 &&
+                      extents[2].start == 200 && extents[2].count == 1 &&
+                      extents[3].start == pages - 1 && extents[3].count == 1);
+    free(extents);
+    
+    // 顺带输出的摘要必须与单页接口一致
+    int digests_ok = 1;
+    uint8_t expected[32];
+    for (size_t p = 0; p < pages; p += 37) {
+        aes_sm3_integrity_256bit(a + p * 4096, expected);
+        digests_ok &= compare_hash(expected, digests_a + p * 32, 32);
+        aes_sm3_integrity_256bit(b + p * 4096, expected);
+        digests_ok &= compare_hash(expected, digests_b + p * 32, 32);
+    }
+    
+    // 与a的manifest比较b（只哈希b一侧）
+    extents = NULL;
+    long n_manifest = aes_sm3_diff_manifest(b, digests_a, pages, 3, &extents);
+    int manifest_ok = (n_manifest >= 3 && extents[0].start == 5 && extents[1].start == 63 &&
+                       extents[1].count == 3);
+    free(extents);
+    
+    // 相同输入无变化区间
+    extents = NULL;
+    long n_same = aes_sm3_diff_memory(a, a, pages, 2, NULL, NULL, &extents);
+    free(extents);
+    
+    // 文件比较：长度不同且尾页不足4KB
+    char path_a[] = "/tmp/aes_sm3_diff_a_XXXXXX";
+    char path_b[] = "/tmp/aes_sm3_diff_b_XXXXXX";
+    int fd_a = mkstemp(path_a);
+    int fd_b = mkstemp(path_b);
+    ssize_t wa = write(fd_a, a, 10 * 4096 + 100);
+    ssize_t wb = write(fd_b, a, 12 * 4096 + 100);
+    close(fd_a);
+    close(fd_b);
+    extents = NULL;
+    long n_files = aes_sm3_diff_files(path_a, path_b, 2, &extents);
+    int files_ok = (n_files == 1 && extents[0].start == 10 && extents[0].count == 3);
+    free(extents);
+    unlink(path_a);
+    unlink(path_b);
+    
+    printf("  内存比较: %ld个区间, manifest比较: %ld个区间, 文件比较: %ld个区间\n",
+           n, n_manifest, n_files);
+    
+    free(a);
+    free(b);
+    free(digests_a);
+    free(digests_b);
+    
+    ASSERT_TRUE(extents_ok, "变化区间应精确合并");
+    ASSERT_TRUE(digests_ok, "比较时输出的摘要应与单页接口一致");
+    ASSERT_TRUE(manifest_ok, "manifest比较应检出摘要不同的页");
+    ASSERT_TRUE(n_same == 0, "相同输入不应产生变化区间");
+    ASSERT_TRUE(wa > 0 && wb > 0 && files_ok, "文件比较应把尾部差异页合并为一个区间");
+    
+    TEST_END();
+}
+
+// 测试27：本地增量同步测试
+static int files_identical(const char* path_a, const char* path_b) {
+    FILE* fa = fopen(path_a, "rb");
+    FILE* fb = fopen(path_b, "rb");
+    int same = (fa != NULL && fb != NULL);
+    while (same) {
+        int ca = fgetc(fa);
+        int cb = fgetc(fb);
+        if (ca != cb) {
+            same = 0;
+        }
+        if (ca == EOF || cb == EOF) {
+            break;
+        }
+    }
+    if (fa) fclose(fa);
+    if (fb) fclose(fb);
+    return same;
+}
+
+void test_delta_sync() {
+    TEST_START("基于页摘要的本地增量同步测试");
+    
+    const size_t src_size = 300 * 4096 + 100;
+    uint8_t* data = malloc(src_size);
+    for (size_t i = 0; i < src_size; i++) {
+        data[i] = (uint8_t)((i * 11 + i / 4096) % 256);
+    }
+    
+    char src_path[] = "/tmp/aes_sm3_sync_src_XXXXXX";
+    char dst_path[] = "/tmp/aes_sm3_sync_dst_XXXXXX";
+    char manifest_path[] = "/tmp/aes_sm3_sync_man_XXXXXX";
+    int fd = mkstemp(src_path);
+    ssize_t written = write(fd, data, src_size);
+    close(fd);
+    close(mkstemp(dst_path));
+    close(mkstemp(manifest_path));
+    
+    // 首次同步：目标为空，全部写入
+    long first = aes_sm3_sync_file(src_path, dst_path, manifest_path, 4);
+    int first_ok = files_identical(src_path, dst_path);
+    
+    // 未变化：不写任何页
+    long unchanged = aes_sm3_sync_file(src_path, dst_path, manifest_path, 4);
+    
+    // 修改3个位置（含跨块页和尾页），只应写入对应页
+    // 第1000字节位于16字节块的高8字节，清单摘要也必须覆盖
+    data[3 * 4096 + 7] ^= 0x5A;
+    for (size_t p = 150; p < 153; p++) {
+        data[p * 4096 + 1000] ^= 0xA5;
+    }
+    data[src_size - 1] ^= 0xFF;
+    fd = open(src_path, O_WRONLY);
+    written += pwrite(fd, data, src_size, 0);
+    close(fd);
+    long delta = aes_sm3_sync_file(src_path, dst_path, manifest_path, 4);
+    int delta_ok = files_identical(src_path, dst_path);
+    
+    // 清单被就地更新：与重新生成的清单逐字节一致
+    char rebuilt_path[] = "/tmp/aes_sm3_sync_reb_XXXXXX";
+    close(mkstemp(rebuilt_path));
+    int build_ret = aes_sm3_manifest_build(dst_path, rebuilt_path, 2);
+    int manifest_ok = (build_ret == 0) && files_identical(manifest_path, rebuilt_path);
+    
+    // 源文件缩短，且不提供清单（重新哈希目标）
+    fd = open(src_path, O_WRONLY | O_TRUNC);
+    written += write(fd, data, 100 * 4096 + 10);
+    close(fd);
+    long shrink = aes_sm3_sync_file(src_path, dst_path, NULL, 2);
+    int shrink_ok = files_identical(src_path, dst_path);
+    
+    printf("  首次同步: %ld页, 无变化: %ld页, 增量: %ld页, 缩短: %ld页\n",
+           first, unchanged, delta, shrink);
+    
+    unlink(src_path);
+    unlink(dst_path);
+    unlink(manifest_path);
+    unlink(rebuilt_path);
+    free(data);
+    
+    ASSERT_TRUE(written > 0, "临时文件写入失败");
+    ASSERT_TRUE(first == 301 && first_ok, "首次同步应写入全部页");
+    ASSERT_TRUE(unchanged == 0, "未变化的文件不应写入任何页");
+    ASSERT_TRUE(delta == 5 && delta_ok, "增量同步应只写入变化的页");
+    ASSERT_TRUE(manifest_ok, "目标清单应被就地更新");
+    ASSERT_TRUE(shrink == 1 && shrink_ok, "缩短后只有新尾页需要写入");
+    
+    TEST_END();
+}
+
+// 测试28：带完整性帧的追加日志测试
+typedef struct {
+    long count;
+    long mismatches;
+    uint64_t last_seq;
+} log_replay_t;
+
+static size_t log_record_length(uint64_t seq) {
+    return (seq * 733) % 9000 + 1;
+}
+
+static void log_record_fill(uint64_t seq, uint8_t* buffer) {
+    size_t length = log_record_length(seq);
+    for (size_t i = 0; i < length; i++) {
+        buffer[i] = (uint8_t)((seq * 31 + i) % 251);
+    }
+}
+
+static void log_replay_callback(void* user, uint64_t seq, const uint8_t* data, size_t length) {
+    log_replay_t* replay = (log_replay_t*)user;
+    uint8_t expected[9001];
+    log_record_fill(seq, expected);
+    if (seq != (uint64_t)replay->count || length != log_record_length(seq) ||
+        memcmp(expected, data, length) != 0) {
+        replay->mismatches++;
+    }
+    replay->last_seq = seq;
+    replay->count++;
+}
+
+void test_integrity_log() {
+    TEST_START("带完整性帧的追加日志测试");
+    
+    char path[] = "/tmp/aes_sm3_log_XXXXXX";
+    close(mkstemp(path));
+    uint8_t record[9001];
+    
+    // 追加500条变长记录，期间穿插组提交
+    aes_sm3_log_t* wal = aes_sm3_log_open(path);
+    int append_ok = (wal != NULL);
+    for (uint64_t seq = 0; seq < 500 && append_ok; seq++) {
+        log_record_fill(seq, record);
+        append_ok = (aes_sm3_log_append(wal, record, log_record_length(seq)) == (long long)seq);
+        if (seq % 97 == 0) {
+            append_ok &= (aes_sm3_log_commit(wal) == 0);
+        }
+    }
+    uint8_t* oversized = calloc(1, 64 * 4096);
+    int reject_ok = wal != NULL && aes_sm3_log_append(wal, oversized, 64 * 4096) == -1;
+    free(oversized);
+    int close_ok = wal != NULL && aes_sm3_log_close(wal) == 0;
+    
+    // 并行恢复：全部记录按序完好
+    log_replay_t replay = { 0, 0, 0 };
+    uint64_t valid_bytes = 0, next_seq = 0;
+    long recovered = aes_sm3_log_recover(path, 4, log_replay_callback, &replay, &valid_bytes, &next_seq);
+    int recover_ok = (recovered == 500 && replay.count == 500 && replay.mismatches == 0 &&
+                      next_seq == 500);
+    
+    // 篡改文件中部一个数据字节：恢复截止于损坏组之前
+    // 先篡改每16字节中第8~15字节的位置（NEON低半折叠覆盖不到），恢复后再篡改低半字节
+    int fd = open(path, O_RDWR);
+    off_t corrupt_at = (off_t)(valid_bytes / 2) & ~(off_t)4095;
+    uint8_t byte = 0;
+    ssize_t io = pread(fd, &byte, 1, corrupt_at + 109);
+    byte ^= 0x01;
+    io += pwrite(fd, &byte, 1, corrupt_at + 109);
+    log_replay_t high = { 0, 0, 0 };
+    long high_truncated = aes_sm3_log_recover(path, 4, log_replay_callback, &high, NULL, NULL);
+    byte ^= 0x01;
+    io += pwrite(fd, &byte, 1, corrupt_at + 109);
+    io += pread(fd, &byte, 1, corrupt_at + 100);
+    byte ^= 0x01;
+    io += pwrite(fd, &byte, 1, corrupt_at + 100);
+    close(fd);
+    log_replay_t partial = { 0, 0, 0 };
+    long truncated = aes_sm3_log_recover(path, 4, log_replay_callback, &partial, NULL, NULL);
+    int truncate_ok = (truncated > 0 && truncated < 500 && partial.mismatches == 0 &&
+                       high_truncated == truncated && high.mismatches == 0);
+    
+    // 重新打开追加：截断损坏部分，序号接续
+    wal = aes_sm3_log_open(path);
+    long long next = -1;
+    if (wal != NULL) {
+        log_record_fill(truncated, record);
+        next = aes_sm3_log_append(wal, record, log_record_length(truncated));
+        aes_sm3_log_close(wal);
+    }
+    log_replay_t reopened = { 0, 0, 0 };
+    long after = aes_sm3_log_recover(path, 2, log_replay_callback, &reopened, NULL, NULL);
+    
+    printf("  恢复: %ld条记录(%.1f KB), 篡改后: %ld条, 重新打开追加后: %ld条\n",
+           recovered, valid_bytes / 1024.0, truncated, after);
+    unlink(path);
+    
+    ASSERT_TRUE(append_ok && close_ok, "追加与组提交应成功");
+    ASSERT_TRUE(reject_ok, "超过一组容量的记录应被拒绝");
+    ASSERT_TRUE(recover_ok, "恢复应按序得到全部完好记录");
+    ASSERT_TRUE(io == 5 && truncate_ok, "恢复应截止于损坏的组（含每16字节第8~15字节的损坏）");
+    ASSERT_TRUE(next == truncated && after == truncated + 1 && reopened.mismatches == 0,
+                "重新打开后应截断损坏部分并接续序号");
+    
+    TEST_END();
+}
+
+// 测试29：校验型直读页缓存测试
+typedef struct {
+    aes_sm3_cache_t* cache;
+    const uint8_t* data;
+    int seed;
+    int errors;
+} cache_reader_t;
+
+static void* cache_reader_thread(void* arg) {
+    cache_reader_t* r = (cache_reader_t*)arg;
+    unsigned int state = r->seed;
+    for (int i = 0; i < 2000; i++) {
+        state = state * 1103515245u + 12345u;
+        uint64_t page = (state >> 8) % 256;
+        if (page == 10) {
+            continue;
+        }
+        int verified = 0;
+        const uint8_t* p = aes_sm3_cache_get(r->cache, page, &verified);
+        if (p == NULL || !verified || memcmp(p, r->data + page * 4096, 4096) != 0) {
+            r->errors++;
+        }
+        if (p != NULL) {
+            aes_sm3_cache_release(r->cache, page);
+        }
+    }
+    return NULL;
+}
+
+void test_verified_page_cache() {
+    TEST_START("校验型直读页缓存测试");
+    
+    const size_t pages = 256;
+    uint8_t* data = malloc(pages * 4096);
+    uint8_t* manifest = malloc(pages * 32);
+    for (size_t i = 0; i < pages * 4096; i++) {
+        data[i] = (uint8_t)((i * 13 + i / 4096) % 256);
+    }
+    for (size_t i = 0; i < pages; i++) {
+        aes_sm3_integrity_256bit(data + i * 4096, manifest + i * 32);
+    }
+    
+    // 复制+哈希融合内核与单页接口一致
+    uint8_t copy[4096], digest[32];
+    aes_sm3_copy_integrity_256bit(copy, data + 7 * 4096, digest);
+    int fused_ok = memcmp(copy, data + 7 * 4096, 4096) == 0 && compare_hash(digest, manifest + 7 * 32, 32);
+    
+    char path[] = "/tmp/aes_sm3_cache_XXXXXX";
+    int fd = mkstemp(path);
+    ssize_t written = write(fd, data, pages * 4096);
+    manifest[10 * 32] ^= 0x01;  // 模拟第10页在存储上损坏
+    
+    // 多线程随机读：容量64页，4个分片
+    aes_sm3_cache_t* cache = aes_sm3_cache_create(fd, manifest, 64, 4);
+    cache_reader_t readers[4];
+    pthread_t threads[4];
+    for (int t = 0; t < 4; t++) {
+        readers[t].cache = cache;
+        readers[t].data = data;
+        readers[t].seed = t + 1;
+        readers[t].errors = 0;
+        pthread_create(&threads[t], NULL, cache_reader_thread, &readers[t]);
+    }
+    int reader_errors = 0;
+    for (int t = 0; t < 4; t++) {
+        pthread_join(threads[t], NULL);
+        reader_errors += readers[t].errors;
+    }
+    
+    int bad_status = 0;
+    const uint8_t* bad = aes_sm3_cache_get(cache, 10, &bad_status);
+    unsigned long long hits, misses, corrupt;
+    aes_sm3_cache_stats(cache, &hits, &misses, &corrupt);
+    aes_sm3_cache_destroy(cache);
+    
+    // pin住的页不会被淘汰：单分片4帧全部pin住时无法装入新页
+    cache = aes_sm3_cache_create(fd, manifest, 4, 1);
+    for (uint64_t p = 0; p < 4; p++) {
+        aes_sm3_cache_get(cache, p, NULL);
+    }
+    int blocked_status = 0;
+    const uint8_t* blocked = aes_sm3_cache_get(cache, 4, &blocked_status);
+    aes_sm3_cache_release(cache, 2);
+    const uint8_t* admitted = aes_sm3_cache_get(cache, 4, NULL);
+    int pinned_ok = (blocked == NULL && blocked_status == AES_SM3_CACHE_BUSY && admitted != NULL &&
+                     memcmp(admitted, data + 4 * 4096, 4096) == 0 &&
+                     aes_sm3_cache_get(cache, 0, NULL) != NULL);
+    aes_sm3_cache_destroy(cache);
+    
+    // 文件末尾追加不足4KB的尾页：按补零摘要校验，帧中超出部分为零
+    uint8_t tail_page[4096];
+    memset(tail_page, 0, sizeof(tail_page));
+    memcpy(tail_page, data, 100);
+    written += write(fd, data, 100);
+    uint8_t* tail_manifest = malloc((pages + 1) * 32);
+    memcpy(tail_manifest, manifest, pages * 32);
+    aes_sm3_integrity_256bit(tail_page, tail_manifest + pages * 32);
+    cache = aes_sm3_cache_create(fd, tail_manifest, 8, 2);
+    int tail_status = 0, range_status = 0;
+    const uint8_t* tail = aes_sm3_cache_get(cache, pages, &tail_status);
+    int tail_ok = tail != NULL && tail_status == 1 && memcmp(tail, tail_page, 4096) == 0;
+    int range_ok = aes_sm3_cache_get(cache, pages + 1, &range_status) == NULL &&
+                   range_status == AES_SM3_CACHE_RANGE;
+    aes_sm3_cache_destroy(cache);
+    free(tail_manifest);
+    
+    printf("  命中: %llu, 未命中: %llu, 校验失败: %llu\n", hits, misses, corrupt);
+    
+    close(fd);
+    unlink(path);
+    free(data);
+    free(manifest);
+    
+    ASSERT_TRUE(written == (ssize_t)(pages * 4096 + 100), "临时文件写入失败");
+    ASSERT_TRUE(fused_ok, "复制+哈希融合内核应与单页接口一致");
+    ASSERT_TRUE(reader_errors == 0, "并发读取应返回已校验且内容正确的页");
+    ASSERT_TRUE(bad == NULL && bad_status == AES_SM3_CACHE_CORRUPT && corrupt >= 1,
+                "摘要不一致的页不应进入缓存");
+    ASSERT_TRUE(hits > 0 && misses >= 255, "应同时产生命中与未命中");
+    ASSERT_TRUE(pinned_ok, "pin住的页不应被淘汰");
+    ASSERT_TRUE(tail_ok && range_ok, "文件尾部不足4KB的页应可读取并校验");
+    
+    TEST_END();
+}
+
+// 测试30：数据库页校验垫片测试
+void test_page_checksum_shim() {
+    TEST_START("数据库页校验垫片测试");
+    
+    const int pages = 40;
+    uint8_t* buf = aligned_alloc(4096, pages * 4096);
+    for (int i = 0; i < pages * 4096; i++) {
+        buf[i] = (uint8_t)((i * 17 + i / 4096) % 256);
+    }
+    
+    // 尾区摘要覆盖尾区清零后的整页：与尾区原内容无关
+    uint8_t page[4096], zeroed[4096];
+    memcpy(page, buf, 4096);
+    aes_sm3_page_seal(page);
+    memcpy(zeroed, page, 4096);
+    memset(zeroed + 4096 - 16, 0, 16);
+    aes_sm3_page_seal(zeroed);
+    int trailer_ok = compare_hash(zeroed + 4096 - 16, page + 4096 - 16, 16) &&
+                     memcmp(page, buf, 4096 - 16) == 0 && aes_sm3_page_verify(page);
+    // 每16字节中低8字节和第8~15字节的改动都应被检出
+    page[100] ^= 0x01;
+    int detect_ok = !aes_sm3_page_verify(page);
+    page[100] ^= 0x01;
+    page[2008] ^= 0x01;
+    detect_ok &= !aes_sm3_page_verify(page);
+    
+    char path[] = "/tmp/aes_sm3_pages_XXXXXX";
+    int fd = mkstemp(path);
+    aes_sm3_pagestore_t* ps = aes_sm3_pagestore_open_fd(fd);
+    int write_ok = 1;
+    for (int p = 0; p < pages; p++) {
+        write_ok &= (aes_sm3_pagestore_write(ps, p, buf + p * 4096) == 0);
+    }
+    
+    uint8_t* readback = aligned_alloc(4096, pages * 4096);
+    int read_ret = aes_sm3_pagestore_read(ps, 0, pages, readback, NULL);
+    int read_ok = (read_ret == 0 && memcmp(readback, buf, pages * 4096) == 0);
+    
+    // 篡改磁盘上第23页的负载（偏移2008位于16字节块的第8字节）
+    uint8_t byte = 0;
+    ssize_t io = pread(fd, &byte, 1, 23 * 4096 + 2008);
+    byte ^= 0x40;
+    io += pwrite(fd, &byte, 1, 23 * 4096 + 2008);
+    uint64_t bad_page = 0;
+    int corrupt_ret = aes_sm3_pagestore_read(ps, 0, pages, readback, &bad_page);
+    int single_ret = aes_sm3_pagestore_read(ps, 22, 1, readback, NULL);
+    unsigned long long failures = aes_sm3_pagestore_checksum_failures(ps);
+    
+    printf("  多页读取: %d, 篡改后: %d (损坏页 %llu), 校验失败计数: %llu\n",
+           read_ret, corrupt_ret, (unsigned long long)bad_page, failures);
+    
+    aes_sm3_pagestore_destroy(ps);
+    close(fd);
+    unlink(path);
+    free(buf);
+    free(readback);
+    
+    ASSERT_TRUE(trailer_ok, "尾区摘要应覆盖尾区清零后的整页");
+    ASSERT_TRUE(detect_ok, "负载任一字节位置的改动都应导致校验失败");
+    ASSERT_TRUE(write_ok && read_ok, "写入后批量读取应校验通过");
+    ASSERT_TRUE(io == 2 && corrupt_ret == -2 && bad_page == 23, "应定位到损坏的页");
+    ASSERT_TRUE(single_ret == 0 && failures == 1, "未损坏的页应正常读取");
+    
+    TEST_END();
+}
+
+// 测试31：管道流式透传校验测试
+typedef struct {
+    int fd;
+    const uint8_t* data;
+    size_t length;
+    uint8_t* received;
+    size_t received_len;
+} stream_pump_t;
+
+static void* stream_producer_thread(void* arg) {
+    stream_pump_t* pump = (stream_pump_t*)arg;
+    size_t done = 0;
+    while (done < pump->length) {
+        // 不规则的写入粒度，模拟真实生产者
+        size_t piece = 1000 + (done / 7) % 9000;
+        if (piece > pump->length - done) piece = pump->length - done;
+        ssize_t n = write(pump->fd, pump->data + done, piece);
+        if (n <= 0) break;
+        done += n;
+    }
+    close(pump->fd);
+    return NULL;
+}
+
+static void* stream_consumer_thread(void* arg) {
+    stream_pump_t* pump = (stream_pump_t*)arg;
+    ssize_t n;
+    while ((n = read(pump->fd, pump->received + pump->received_len,
+                     pump->length + 4096 - pump->received_len)) > 0) {
+        pump->received_len += n;
+    }
+    return NULL;
+}
+
+// 按页重新计算摘要，与旁路输出的文本逐行比较
+static int stream_digests_match(const uint8_t* data, size_t length, const char* path) {
+    FILE* f = fopen(path, "r");
+    if (f == NULL) return 0;
+    size_t pages = (length + 4095) / 4096;
+    int ok = 1;
+    for (size_t p = 0; p < pages && ok; p++) {
+        uint8_t page[4096] = {0};
+        uint8_t digest[32];
+        char hex[65];
+        unsigned long long index = 0;
+        size_t len = length - p * 4096 < 4096 ? length - p * 4096 : 4096;
+        memcpy(page, data + p * 4096, len);
+        aes_sm3_integrity_256bit(page, digest);
+        for (int i = 0; i < 32; i++) sprintf(hex + i * 2, "%02x", digest[i]);
+        char line_hex[80];
+        ok = fscanf(f, "%llu %70s", &index, line_hex) == 2 && index == p && strcmp(hex, line_hex) == 0;
+    }
+    char extra[80];
+    ok = ok && fscanf(f, "%70s", extra) != 1;
+    fclose(f);
+    return ok;
+}
+
+static long long stream_run(int in_fd, const uint8_t* data, size_t length, int produce,
+                            const char* digest_path, uint8_t* received, size_t* received_len) {
+    int out_pipe[2];
+    int pipe_in[2] = { -1, -1 };
+    if (pipe(out_pipe) != 0) return -1;
+    if (produce && pipe(pipe_in) != 0) return -1;
+    
+    stream_pump_t producer = { produce ? pipe_in[1] : -1, data, length, NULL, 0 };
+    stream_pump_t consumer = { out_pipe[0], data, length, received, 0 };
+    pthread_t producer_thread, consumer_thread;
+    if (produce) {
+        pthread_create(&producer_thread, NULL, stream_producer_thread, &producer);
+        in_fd = pipe_in[0];
+    }
+    pthread_create(&consumer_thread, NULL, stream_consumer_thread, &consumer);
+    
+    int digest_fd = open(digest_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    long long total = aes_sm3_stream_tee(in_fd, out_pipe[1], digest_fd);
+    close(digest_fd);
+    close(out_pipe[1]);
+    
+    pthread_join(consumer_thread, NULL);
+    if (produce) {
+        pthread_join(producer_thread, NULL);
+        close(pipe_in[0]);
+    }
+    close(out_pipe[0]);
+    *received_len = consumer.received_len;
+    return total;
+}
+
+void test_stream_tee() {
+    TEST_START("管道流式透传校验测试");
+    
+    const size_t length = 3 * 1024 * 1024 + 1234;  // 含不足一页的尾部
+    uint8_t* data = malloc(length);
+    uint8_t* received = malloc(length + 4096);
+    for (size_t i = 0; i < length; i++) {
+        data[i] = (uint8_t)((i * 19 + i / 4096) % 256);
+    }
+    char digest_path[] = "/tmp/aes_sm3_stream_dg_XXXXXX";
+    char file_path[] = "/tmp/aes_sm3_stream_in_XXXXXX";
+    close(mkstemp(digest_path));
+    
+    // 管道 -> 管道（tee路径）
+    size_t received_len = 0;
+    long long piped = stream_run(-1, data, length, 1, digest_path, received, &received_len);
+    int pipe_ok = (piped == (long long)length && received_len == length &&
+                   memcmp(received, data, length) == 0 &&
+                   stream_digests_match(data, length, digest_path));
+    
+    // 普通文件 -> 管道（mmap + vmsplice路径）
+    int fd = mkstemp(file_path);
+    ssize_t written = write(fd, data, length);
+    lseek(fd, 0, SEEK_SET);
+    memset(received, 0, length);
+    long long mapped = stream_run(fd, data, length, 0, digest_path, received, &received_len);
+    int file_ok = (mapped == (long long)length && received_len == length &&
+                   memcmp(received, data, length) == 0 &&
+                   stream_digests_match(data, length, digest_path));
+    close(fd);
+    
+    printf("  管道输入: %lld字节, 文件输入: %lld字节, 每流%zu条摘要\n",
+           piped, mapped, (length + 4095) / 4096);
+    
+    unlink(digest_path);
+    unlink(file_path);
+    free(data);
+    free(received);
+    
+    ASSERT_TRUE(written == (ssize_t)length, "临时文件写入失败");
+    ASSERT_TRUE(pipe_ok, "管道输入应原样透传并输出正确的页摘要");
+    ASSERT_TRUE(file_ok, "文件输入应原样透传并输出正确的页摘要");
+    
+    TEST_END();
+}
+
+// 测试32：大页缓冲区与2MB分块测试
+void test_hugepage_buffers() {
+    TEST_START("大页缓冲区与2MB分块测试");
+    
+    const size_t size = 24 * 1024 * 1024 + 12345;  // 非2MB整数倍
+    int kind = -1;
+    uint8_t* buffer = aes_sm3_buffer_alloc(size, &kind);
+    int alloc_ok = (buffer != NULL && ((uintptr_t)buffer & (2 * 1024 * 1024 - 1)) == 0 &&
+                    kind >= 0 && kind <= 2);
+    
+    // 从非2MB对齐的位置开始，任务切分需要在大页边界处截断
+    const int pages = 5000;
+    const uint8_t* input = buffer + 3 * 4096;
+    for (size_t i = 0; i < size; i++) {
+        buffer[i] = (uint8_t)((i * 23 + i / 4096) % 256);
+    }
+    uint8_t* expected = malloc(pages * 32);
+    uint8_t* engine_out = malloc(pages * 32);
+    uint8_t* topo_out = malloc(pages * 32);
+    for (int i = 0; i < pages; i++) {
+        aes_sm3_integrity_256bit(input + (size_t)i * 4096, expected + i * 32);
+    }
+    memset(engine_out, 0, pages * 32);
+    memset(topo_out, 0, pages * 32);
+    
+    aes_sm3_parallel(input, engine_out, pages, 4, 256);
+    aes_sm3_topology_t* topo = aes_sm3_topology_create("2*1024,2*512");
+    aes_sm3_parallel_topology(topo, input, topo_out, pages, 4, 256);
+    aes_sm3_topology_destroy(topo);
+    
+    int engine_ok = memcmp(engine_out, expected, pages * 32) == 0;
+    int topo_ok = memcmp(topo_out, expected, pages * 32) == 0;
+    
+    static const char* kind_names[] = { "普通页", "透明大页", "显式大页" };
+    printf("  分配结果: %s, 引擎分块: %s, 拓扑分区: %s\n",
+           (kind >= 0 && kind <= 2) ? kind_names[kind] : "失败",
+           engine_ok ? "一致" : "不一致", topo_ok ? "一致" : "不一致");
+    
+    aes_sm3_buffer_free(buffer, size);
+    free(expected);
+    free(engine_out);
+    free(topo_out);
+    
+    ASSERT_TRUE(alloc_ok, "缓冲区应按2MB对齐分配");
+    ASSERT_TRUE(engine_ok, "按2MB边界切分的任务结果应与单页接口一致");
+    ASSERT_TRUE(topo_ok, "对齐到2MB的拓扑分区结果应与单页接口一致");
+    
+    TEST_END();
+}
+
+// 测试33：流式加载折叠内核测试
+void test_streaming_load_modes() {
+    TEST_START("流式加载折叠内核测试");
+    
+    const int pages = 150;  // 跨越多个批次
+    uint8_t* data = malloc(pages * 4096);
+    uint8_t* expected = malloc(pages * 32);
+    uint8_t* single = malloc(pages * 32);
+    uint8_t* batch = malloc(pages * 32);
+    const uint8_t* inputs[150];
+    uint8_t* outputs[150];
+    
+    for (int i = 0; i < pages * 4096; i++) {
+        data[i] = (uint8_t)((i * 37 + i / 4096) % 256);
+    }
+    for (int i = 0; i < pages; i++) {
+        aes_sm3_integrity_256bit(data + i * 4096, expected + i * 32);
+        aes_sm3_integrity_256bit_mode(data + i * 4096, single + i * 32, AES_SM3_LOAD_STREAMING);
+        inputs[i] = data + i * 4096;
+        outputs[i] = batch + i * 32;
+    }
+    aes_sm3_integrity_batch_mode(inputs, outputs, pages, AES_SM3_LOAD_STREAMING);
+    int single_ok = memcmp(single, expected, pages * 32) == 0;
+    int batch_ok = memcmp(batch, expected, pages * 32) == 0;
+    
+    memset(batch, 0, pages * 32);
+    aes_sm3_integrity_batch_mode(inputs, outputs, pages, AES_SM3_LOAD_TEMPORAL);
+    int temporal_ok = memcmp(batch, expected, pages * 32) == 0;
+    
+    printf("  流式单页: %s, 流式批处理: %s, 普通批处理: %s\n",
+           single_ok ? "一致" : "不一致", batch_ok ? "一致" : "不一致",
+           temporal_ok ? "一致" : "不一致");
+    
+    free(data);
+    free(expected);
+    free(single);
+    free(batch);
+    
+    ASSERT_TRUE(single_ok, "流式单页结果应与普通模式一致");
+    ASSERT_TRUE(batch_ok, "流式批处理结果应与普通模式一致");
+    ASSERT_TRUE(temporal_ok, "普通模式批处理结果应保持不变");
+    
+    TEST_END();
+}
+
+// 测试34：运行时统计测试
+static int file_contains(const char* path, const char* needle) {
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        return 0;
+    }
+    static char text[65536];
+    size_t n = fread(text, 1, sizeof(text) - 1, f);
+    text[n] = 0;
+    fclose(f);
+    return strstr(text, needle) != NULL;
+}
+
+void test_runtime_stats() {
+    TEST_START("运行时统计测试");
+    
+    if (!aes_sm3_stats_enabled()) {
+        aes_sm3_stats_t total;
+        printf("  统计已在编译时关闭\n");
+        ASSERT_TRUE(aes_sm3_stats_snapshot(&total, NULL, NULL, 0) == 0 && total.jobs == 0,
+                    "关闭统计时快照应为空");
+    } else {
+        const int pages = 256;
+        uint8_t* data = malloc(pages * 4096);
+        uint8_t* output = malloc(pages * 32);
+        const uint8_t* inputs[10];
+        uint8_t* outputs[10];
+        for (int i = 0; i < pages * 4096; i++) {
+            data[i] = (uint8_t)(i * 13);
+        }
+        for (int i = 0; i < 10; i++) {
+            inputs[i] = data + i * 4096;
+            outputs[i] = output + i * 32;
+        }
+        
+        aes_sm3_stats_t before, after;
+        aes_sm3_stats_snapshot(&before, NULL, NULL, 0);
+        for (int i = 0; i < 5; i++) {
+            aes_sm3_integrity_256bit(data + i * 4096, output + i * 32);
+        }
+        aes_sm3_integrity_batch(inputs, outputs, 10);
+        aes_sm3_parallel(data, output, pages, 4, 256);
+        aes_sm3_stats_snapshot(&after, NULL, NULL, 0);
+        
+        unsigned long long single_pages = after.kernel_pages[AES_SM3_KERNEL_256BIT] - before.kernel_pages[AES_SM3_KERNEL_256BIT];
+        unsigned long long batch_pages = after.kernel_pages[AES_SM3_KERNEL_BATCH] - before.kernel_pages[AES_SM3_KERNEL_BATCH];
+        unsigned long long bucket8 = after.batch_hist[3] - before.batch_hist[3];
+        unsigned long long jobs = after.jobs - before.jobs;
+        unsigned long long waits = 0;
+        for (int b = 0; b < 16; b++) {
+            waits += after.wait_hist[b] - before.wait_hist[b];
+        }
+        printf("  单页: %llu页, 批处理: %llu页, 并行任务: %llu, 工作线程忙碌: %.3fms\n",
+               single_pages, batch_pages, jobs, (after.busy_ns - before.busy_ns) / 1e6);
+        
+        aes_sm3_stats_t merged = before;
+        aes_sm3_stats_merge(&merged, &before);
+        int merge_ok = merged.kernel_pages[0] == 2 * before.kernel_pages[0] && merged.jobs == 2 * before.jobs;
+        
+        char path[] = "/tmp/aes_sm3_stats_XXXXXX";
+        close(mkstemp(path));
+        int write_ok = aes_sm3_stats_write_prometheus(path) == 0 &&
+                       file_contains(path, "aes_sm3_kernel_pages_total{kernel=\"256bit\"}") &&
+                       file_contains(path, "aes_sm3_queue_wait_seconds_bucket{le=\"+Inf\"}");
+        unlink(path);
+        
+        aes_sm3_stats_exporter_t* exporter = aes_sm3_stats_exporter_start(path, 20);
+        usleep(50000);
+        aes_sm3_stats_exporter_stop(exporter);
+        int exporter_ok = exporter != NULL && file_contains(path, "aes_sm3_batch_pages_count");
+        unlink(path);
+        
+        free(data);
+        free(output);
+        
+        ASSERT_TRUE(single_pages >= 5 + (unsigned long long)pages, "单页核函数计数应包含直接调用和并行任务");
+        ASSERT_TRUE(batch_pages >= 10 && bucket8 >= 1, "批处理页数与直方图应被记录");
+        ASSERT_TRUE(jobs >= 1 && waits == jobs, "并行任务的排队等待应全部进入直方图");
+        ASSERT_TRUE(merge_ok, "合并应逐项相加");
+        ASSERT_TRUE(write_ok, "Prometheus文本应包含计数和直方图");
+        ASSERT_TRUE(exporter_ok, "周期导出器应写出文件");
+    }
+    
+    TEST_END();
+}
+
+// 测试35：时间线追踪导出测试
+void test_trace_export() {
+    TEST_START("时间线追踪导出测试");
+    
+    const int pages = 256;
+    uint8_t* data = malloc(pages * 4096);
+    uint8_t* output = malloc(pages * 32);
+    const uint8_t* inputs[16];
+    uint8_t* outputs[16];
+    for (int i = 0; i < pages * 4096; i++) {
+        data[i] = (uint8_t)(i * 7 + 3);
+    }
+    for (int i = 0; i < 16; i++) {
+        inputs[i] = data + i * 4096;
+        outputs[i] = output + i * 32;
+    }
+    
+    char path[] = "/tmp/aes_sm3_trace_XXXXXX";
+    close(mkstemp(path));
+    int started = aes_sm3_trace_start(1024);
+    aes_sm3_parallel(data, output, pages, 4, 256);
+    aes_sm3_integrity_batch(inputs, outputs, 16);
+    aes_sm3_trace_stop();
+    long spans = aes_sm3_trace_dump(path);
+    
+    // 停止后不再记录
+    aes_sm3_integrity_batch(inputs, outputs, 16);
+    long spans_after = aes_sm3_trace_dump(path);
+    
+    int has_events = file_contains(path, "\"traceEvents\"") &&
+                     file_contains(path, "\"name\":\"fold\"") &&
+                     file_contains(path, "\"name\":\"sm3\"") &&
+                     file_contains(path, "\"name\":\"join\"") &&
+                     file_contains(path, "\"name\":\"thread_start\"") &&
+                     file_contains(path, "\"name\":\"thread_name\"");
+    
+    // 同一次记录中先后两批工作线程：已退出线程的缓冲区有未导出区间时不能被复用，
+    // 每个thread_start区间都应落在不同的tid上
+    aes_sm3_trace_start(1024);
+    aes_sm3_parallel(data, output, pages, 4, 256);
+    aes_sm3_parallel(data, output, pages, 4, 256);
+    aes_sm3_trace_stop();
+    aes_sm3_trace_dump(path);
+    int thread_starts = 0;
+    int distinct_tids = 0;
+    int start_tids[64];
+    FILE* trace = fopen(path, "r");
+    char line[512];
+    while (trace != NULL && fgets(line, sizeof(line), trace) != NULL) {
+        const char* tid_field = strstr(line, "\"tid\":");
+        int tid;
+        if (strstr(line, "\"name\":\"thread_start\"") == NULL || tid_field == NULL ||
+            sscanf(tid_field, "\"tid\":%d", &tid) != 1) {
+            continue;
+        }
+        int seen = 0;
+        for (int i = 0; i < distinct_tids; i++) {
+            seen |= start_tids[i] == tid;
+        }
+        if (!seen && distinct_tids < 64) {
+            start_tids[distinct_tids++] = tid;
+        }
+        thread_starts++;
+    }
+    if (trace != NULL) {
+        fclose(trace);
+    }
+    printf("  记录区间: %ld, 停止后: %ld, 两批线程启动: %d, 不同tid: %d\n",
+           spans, spans_after, thread_starts, distinct_tids);
+    unlink(path);
+    
+    free(data);
+    free(output);
+    
+    if (started != 0) {
+        printf("  追踪已在编译时关闭\n");
+        ASSERT_TRUE(spans == -1, "关闭追踪时导出应失败");
+    } else {
+        ASSERT_TRUE(spans >= 5, "应记录线程启动、分区、哈希和汇合区间");
+        ASSERT_TRUE(spans_after == spans, "停止后不应继续记录");
+        ASSERT_TRUE(has_events, "导出应为包含各阶段的Chrome trace JSON");
+        ASSERT_TRUE(thread_starts >= 2 && distinct_tids == thread_starts,
+                    "复用的缓冲区不应把已退出线程的区间归到新线程名下");
+    }
+    
+    TEST_END();
+}
+
+// 测试36：USDT探针挂接路径测试
+void test_usdt_probe_paths() {
+    TEST_START("USDT探针挂接路径测试");
+    
+    const int pages = 128;
+    uint8_t* data = malloc(pages * 4096);
+    uint8_t* expected = malloc(pages * 32);
+    uint8_t* batch = malloc(pages * 32);
+    uint8_t* parallel = malloc(pages * 32);
+    const uint8_t* inputs[128];
+    uint8_t* outputs[128];
+    for (int i = 0; i < pages * 4096; i++) {
+        data[i] = (uint8_t)(i * 29 + 1);
+    }
+    for (int i = 0; i < pages; i++) {
+        aes_sm3_integrity_256bit(data + i * 4096, expected + i * 32);
+        inputs[i] = data + i * 4096;
+        outputs[i] = batch + i * 32;
+    }
+    
+    // 模拟bpftrace挂接：置位semaphore后走探针参数计算路径
+    int available = &aes_sm3_batch_end_semaphore != NULL;
+    if (available) {
+        aes_sm3_batch_start_semaphore = 1;
+        aes_sm3_batch_end_semaphore = 1;
+        aes_sm3_job_submit_semaphore = 1;
+        aes_sm3_job_complete_semaphore = 1;
+    }
+    aes_sm3_integrity_batch(inputs, outputs, pages);
+    aes_sm3_parallel(data, parallel, pages, 4, 256);
+    if (available) {
+        aes_sm3_batch_start_semaphore = 0;
+        aes_sm3_batch_end_semaphore = 0;
+        aes_sm3_job_submit_semaphore = 0;
+        aes_sm3_job_complete_semaphore = 0;
+    }
+    
+    int batch_ok = memcmp(batch, expected, pages * 32) == 0;
+    int parallel_ok = memcmp(parallel, expected, pages * 32) == 0;
+    printf("  探针: %s, 批处理: %s, 并行: %s\n", available ? "已编译" : "未编译",
+           batch_ok ? "一致" : "不一致", parallel_ok ? "一致" : "不一致");
+    
+    free(data);
+    free(expected);
+    free(batch);
+    free(parallel);
+    
+    ASSERT_TRUE(batch_ok, "挂接探针后批处理结果应不变");
+    ASSERT_TRUE(parallel_ok, "挂接探针后并行结果应不变");
+    
+    TEST_END();
+}
+
+// 测试37：显式初始化测试
+// 在新线程中观察初始化效果：登记统计块后存活线程数加一
+static void* eager_init_thread(void* arg) {
+    int* live = (int*)arg;
+    live[0] = aes_sm3_stats_snapshot(NULL, NULL, NULL, 0);
+    aes_sm3_init(AES_SM3_INIT_THREAD);
+    live[1] = aes_sm3_stats_snapshot(NULL, NULL, NULL, 0);
+    return NULL;
+}
+
+void test_eager_init() {
+    TEST_START("显式初始化测试");
+    
+    uint8_t* data = malloc(64 * 4096);
+    uint8_t before[64 * 32], after[64 * 32];
+    for (int i = 0; i < 64 * 4096; i++) {
+        data[i] = (uint8_t)(i * 11 + 5);
+    }
+    for (int i = 0; i < 64; i++) {
+        aes_sm3_integrity_256bit(data + i * 4096, before + i * 32);
+    }
+    
+    // 可重复调用，且不改变任何结果
+    aes_sm3_init(AES_SM3_INIT_ALL);
+    aes_sm3_init(AES_SM3_INIT_ALL);
+    aes_sm3_parallel(data, after, 64, 4, 256);
+    int ok = memcmp(before, after, sizeof(before)) == 0;
+    
+    int live[2] = { 0, 0 };
+    pthread_t thread;
+    pthread_create(&thread, NULL, eager_init_thread, live);
+    pthread_join(thread, NULL);
+    printf("  初始化后并行结果: %s, 初始化前后存活统计线程: %d -> %d\n",
+           ok ? "一致" : "不一致", live[0], live[1]);
+    
+    free(data);
+    
+    ASSERT_TRUE(ok, "初始化后结果应与惰性初始化一致");
+    if (aes_sm3_stats_enabled()) {
+        ASSERT_TRUE(live[1] == live[0] + 1, "初始化应为调用线程登记统计块");
+    }
+    
+    TEST_END();
+}
+
+// 测试38：自动调优分块测试
+void test_autotune_tiling() {
+    TEST_START("自动调优分块测试");
+    
+    const int pages = 300;  // 不是分块大小的整数倍
+    uint8_t* data = malloc(pages * 4096);
+    uint8_t* expected = malloc(pages * 32);
+    uint8_t* batch = malloc(pages * 32);
+    const uint8_t** inputs = malloc(pages * sizeof(uint8_t*));
+    uint8_t** outputs = malloc(pages * sizeof(uint8_t*));
+    for (int i = 0; i < pages * 4096; i++) {
+        data[i] = (uint8_t)(i * 41 + i / 4096);
+    }
+    for (int i = 0; i < pages; i++) {
+        aes_sm3_integrity_256bit(data + i * 4096, expected + i * 32);
+        inputs[i] = data + i * 4096;
+        outputs[i] = batch + i * 32;
+    }
+    
+    int original = aes_sm3_autotune_tile(AES_SM3_TUNE_BATCH);
+    int original_no_prefetch = aes_sm3_autotune_tile(AES_SM3_TUNE_NO_PREFETCH);
+    int tiles[] = { 4096, 1, 16 };
+    int tiled_ok = 1;
+    uint8_t* untiled = malloc(pages * 32);
+    for (int t = 0; t < 3; t++) {
+        aes_sm3_autotune_set_tile(AES_SM3_TUNE_BATCH, tiles[t]);
+        memset(batch, 0, pages * 32);
+        aes_sm3_integrity_batch(inputs, outputs, pages);
+        tiled_ok &= memcmp(batch, expected, pages * 32) == 0;
+        
+        // 对比族（简化折叠，摘要与主路径不同）同样按各自的分块大小执行，结果不随分块变化
+        aes_sm3_autotune_set_tile(AES_SM3_TUNE_NO_PREFETCH, tiles[t]);
+        memset(batch, 0, pages * 32);
+        aes_sm3_integrity_batch_no_prefetch(inputs, outputs, pages);
+        if (t == 0) {
+            memcpy(untiled, batch, pages * 32);
+        }
+        tiled_ok &= memcmp(batch, untiled, pages * 32) == 0;
+    }
+    free(untiled);
+    
+    // 保存后修改，再载入应恢复
+    char path[] = "/tmp/aes_sm3_autotune_XXXXXX";
+    close(mkstemp(path));
+    aes_sm3_autotune_set_tile(AES_SM3_TUNE_BATCH, 32);
+    aes_sm3_autotune_set_tile(AES_SM3_TUNE_NO_PREFETCH, 128);
+    int saved = aes_sm3_autotune_save(path) == 0;
+    aes_sm3_autotune_set_tile(AES_SM3_TUNE_BATCH, 8);
+    aes_sm3_autotune_set_tile(AES_SM3_TUNE_NO_PREFETCH, 8);
+    int loaded = aes_sm3_autotune_load(path);
+    int roundtrip_ok = saved && loaded > 0 &&
+                       aes_sm3_autotune_tile(AES_SM3_TUNE_BATCH) == 32 &&
+                       aes_sm3_autotune_tile(AES_SM3_TUNE_NO_PREFETCH) == 128;
+    aes_sm3_autotune_set_tile(AES_SM3_TUNE_BATCH, 0);
+    int clamped_ok = aes_sm3_autotune_tile(AES_SM3_TUNE_BATCH) == 1;
+    unlink(path);
+    aes_sm3_autotune_set_tile(AES_SM3_TUNE_BATCH, original);
+    aes_sm3_autotune_set_tile(AES_SM3_TUNE_NO_PREFETCH, original_no_prefetch);
+    
+    printf("  分块结果: %s, 缓存往返: %s\n", tiled_ok ? "一致" : "不一致", roundtrip_ok ? "成功" : "失败");
+    
+    free(data);
+    free(expected);
+    free(batch);
+    free(inputs);
+    free(outputs);
+    
+    ASSERT_TRUE(tiled_ok, "任意分块大小下批处理结果应与单块一致");
+    ASSERT_TRUE(roundtrip_ok, "自动调优缓存保存后应能载入");
+    ASSERT_TRUE(clamped_ok, "分块大小应被限制在有效范围内");
+    
+    TEST_END();
+}
+
+// 测试39：512字节扇区标签测试
+void test_sector_tags() {
+    TEST_START("512字节扇区标签测试");
+    
+    const size_t sectors = 21;  // 2页半：覆盖不足8路的尾组
+    uint8_t* data = malloc(sectors * 512);
+    uint8_t* tags128 = malloc(sectors * 16);
+    uint8_t* tags64 = malloc(sectors * 8);
+    uint8_t* tail = malloc(sectors * 16);
+    uint8_t* after = malloc(sectors * 16);
+    for (size_t i = 0; i < sectors * 512; i++) {
+        data[i] = (uint8_t)(i * 97 + i / 512);
+    }
+    
+    int rc128 = aes_sm3_sector_tags(data, sectors, tags128, 128);
+    int rc64 = aes_sm3_sector_tags(data, sectors, tags64, 64);
+    int prefix_ok = 1;
+    for (size_t i = 0; i < sectors; i++) {
+        prefix_ok &= memcmp(tags64 + i * 8, tags128 + i * 16, 8) == 0;
+    }
+    
+    // 单独计算尾部扇区应与整体计算中的对应标签一致
+    aes_sm3_sector_tags(data + 17 * 512, sectors - 17, tail, 128);
+    int tail_ok = memcmp(tail, tags128 + 17 * 16, (sectors - 17) * 16) == 0;
+    
+    // 相同内容的扇区标签相同
+    memcpy(data + 5 * 512, data + 2 * 512, 512);
+    aes_sm3_sector_tags(data, sectors, tags128, 128);
+    int equal_ok = memcmp(tags128 + 5 * 16, tags128 + 2 * 16, 16) == 0;
+    
+    // 修改一个扇区只影响该扇区的标签
+    data[11 * 512 + 300] ^= 0x20;
+    aes_sm3_sector_tags(data, sectors, after, 128);
+    int changed = 0, changed_at = -1;
+    for (size_t i = 0; i < sectors; i++) {
+        if (memcmp(after + i * 16, tags128 + i * 16, 16) != 0) {
+            changed++;
+            changed_at = (int)i;
+        }
+    }
+    long first_bad = 0;
+    long bad = aes_sm3_sector_verify(data, sectors, tags128, 128, &first_bad);
+    long clean = aes_sm3_sector_verify(data, sectors, after, 128, NULL);
+    
+    // 每16字节中的任一位置（含NEON折叠的高8字节）被修改都应改变标签，两个256字节段都要覆盖
+    int lanes_ok = 1;
+    for (int half = 0; half < 2; half++) {
+        for (int lane = 0; lane < 16; lane++) {
+            size_t offset = 3 * 512 + half * 256 + 64 + lane;
+            data[offset] ^= 0x01;
+            lanes_ok &= aes_sm3_sector_verify(data, sectors, after, 128, NULL) == 1;
+            data[offset] ^= 0x01;
+        }
+    }
+    int invalid = aes_sm3_sector_tags(data, sectors, tags128, 96);
+    
+    printf("  不一致扇区: %ld（第%ld个）, 逐位置修改: %s\n", bad, first_bad, lanes_ok ? "均被检出" : "有遗漏");
+    
+    free(data);
+    free(tags128);
+    free(tags64);
+    free(tail);
+    free(after);
+    
+    ASSERT_TRUE(rc128 == 0 && rc64 == 0 && invalid == -1, "只接受64位和128位标签");
+    ASSERT_TRUE(prefix_ok, "64位标签应为128位标签的前缀");
+    ASSERT_TRUE(tail_ok, "不足8个扇区的尾组应与整组计算一致");
+    ASSERT_TRUE(equal_ok, "相同内容的扇区标签应相同");
+    ASSERT_TRUE(changed == 1 && changed_at == 11, "修改一个扇区只应改变该扇区的标签");
+    ASSERT_TRUE(bad == 1 && first_bad == 11 && clean == 0, "校验应定位到被修改的扇区");
+    ASSERT_TRUE(lanes_ok, "扇区中每16字节的任一位置被修改都应被检出");
+    
+    TEST_END();
+}
+
+// 测试40：大页面尺寸特化测试
+void test_large_page_sizes() {
+    TEST_START("大页面尺寸特化测试");
+    
+    const size_t bytes = 12 * 65536;
+    uint8_t* data = malloc(bytes);
+    uint8_t* expected = malloc(96 * 32);
+    uint8_t* actual = malloc(96 * 32);
+    const uint8_t* inputs[96];
+    uint8_t* outputs[96];
+    for (size_t i = 0; i < bytes; i++) {
+        data[i] = (uint8_t)(i * 131 + i / 8192);
+    }
+    
+    // 8KB批处理与单页一致（96页，跨越多个批处理组）
+    for (int i = 0; i < 96; i++) {
+        inputs[i] = data + (size_t)i * 8192;
+        outputs[i] = actual + i * 32;
+        aes_sm3_integrity_8k_256bit(inputs[i], expected + i * 32);
+    }
+    aes_sm3_integrity_batch_8k(inputs, outputs, 96);
+    int batch8_ok = memcmp(actual, expected, 96 * 32) == 0;
+    
+    // 64KB批处理与单页一致
+    for (int i = 0; i < 12; i++) {
+        inputs[i] = data + (size_t)i * 65536;
+        outputs[i] = actual + i * 32;
+        aes_sm3_integrity_64k_256bit(inputs[i], expected + i * 32);
+    }
+    aes_sm3_integrity_batch_64k(inputs, outputs, 12);
+    int batch64_ok = memcmp(actual, expected, 12 * 32) == 0;
+    
+    // 16KB并行（128位输出）与单页一致，128位为256位的前缀
+    int parallel_ok = 1;
+    aes_sm3_parallel_16k(data, actual, 48, 4, 128);
+    for (int i = 0; i < 48; i++) {
+        uint8_t d128[16], d256[32];
+        aes_sm3_integrity_16k_128bit(data + (size_t)i * 16384, d128);
+        aes_sm3_integrity_16k_256bit(data + (size_t)i * 16384, d256);
+        parallel_ok &= memcmp(actual + i * 16, d128, 16) == 0 && memcmp(d128, d256, 16) == 0;
+    }
+    
+    // 每个段的修改都反映到摘要中
+    int sensitive = 1;
+    uint8_t before[32], after[32];
+    aes_sm3_integrity_64k_256bit(data, before);
+    for (int seg = 0; seg < 16; seg++) {
+        data[seg * 4096 + 4095] ^= 0x01;
+        aes_sm3_integrity_64k_256bit(data, after);
+        sensitive &= memcmp(before, after, 32) != 0;
+        data[seg * 4096 + 4095] ^= 0x01;
+    }
+    // 每16字节中的任一位置（含NEON向量的高8字节）都参与折叠，8KB页同样
+    uint8_t before8[32];
+    aes_sm3_integrity_8k_256bit(data, before8);
+    for (int lane = 0; lane < 16; lane++) {
+        data[5 * 4096 + 1024 + lane] ^= 0x01;
+        aes_sm3_integrity_64k_256bit(data, after);
+        sensitive &= memcmp(before, after, 32) != 0;
+        data[5 * 4096 + 1024 + lane] ^= 0x01;
+        
+        data[3 * 512 + 64 + lane] ^= 0x01;
+        aes_sm3_integrity_8k_256bit(data, after);
+        sensitive &= memcmp(before8, after, 32) != 0;
+        data[3 * 512 + 64 + lane] ^= 0x01;
+    }
+    
+    free(data);
+    free(expected);
+    free(actual);
+    
+    ASSERT_TRUE(batch8_ok, "8KB批处理结果应与单页一致");
+    ASSERT_TRUE(batch64_ok, "64KB批处理结果应与单页一致");
+    ASSERT_TRUE(parallel_ok, "16KB并行结果应与单页一致");
+    ASSERT_TRUE(sensitive, "64KB/8KB页任一段、任一字节位置的修改都应改变摘要");
+    
+    TEST_END();
+}
+
+// 测试41：混合长度批处理测试
+void test_mixed_length_batch() {
+    TEST_START("混合长度批处理测试");
+    
+    // 覆盖空项、字节/字/段边界、整页以及需要8KB/16KB/64KB页长的项
+    static const size_t lengths[] = {
+        4096, 0, 1, 7, 8, 9, 255, 256, 257, 1000, 4095, 4097, 8192, 9000, 16384, 20000, 65536, 300
+    };
+    const int count = sizeof(lengths) / sizeof(lengths[0]);
+    const uint8_t* inputs[sizeof(lengths) / sizeof(lengths[0])];
+    uint8_t* outputs[sizeof(lengths) / sizeof(lengths[0])];
+    uint8_t* items[sizeof(lengths) / sizeof(lengths[0])];
+    uint8_t* digests = malloc(count * 32);
+    uint8_t* padded = calloc(1, 65536);
+    
+    // 每项单独按实际长度分配，越界读取会被内存检查工具发现
+    for (int i = 0; i < count; i++) {
+        items[i] = malloc(lengths[i] ? lengths[i] : 1);
+        for (size_t k = 0; k < lengths[i]; k++) {
+            items[i][k] = (uint8_t)(k * 13 + i * 7 + 1);
+        }
+        inputs[i] = items[i];
+        outputs[i] = digests + i * 32;
+    }
+    int rc = aes_sm3_integrity_batch_mixed(inputs, lengths, outputs, count);
+    
+    int match = 1;
+    for (int i = 0; i < count; i++) {
+        uint8_t expected[32];
+        memset(padded, 0, 65536);
+        memcpy(padded, items[i], lengths[i]);
+        if (lengths[i] <= 4096) {
+            aes_sm3_integrity_256bit(padded, expected);
+        } else if (lengths[i] <= 8192) {
+            aes_sm3_integrity_8k_256bit(padded, expected);
+        } else if (lengths[i] <= 16384) {
+            aes_sm3_integrity_16k_256bit(padded, expected);
+        } else {
+            aes_sm3_integrity_64k_256bit(padded, expected);
+        }
+        if (memcmp(expected, outputs[i], 32) != 0) {
+            printf("  长度%zu的项与补零计算不一致\n", lengths[i]);
+            match = 0;
+        }
+    }
+    
+    size_t too_long = 65537;
+    uint8_t untouched[32];
+    memcpy(untouched, digests, 32);
+    int rejected = aes_sm3_integrity_batch_mixed(inputs, &too_long, outputs, 1) == -1 &&
+                   memcmp(untouched, digests, 32) == 0;
+    
+    for (int i = 0; i < count; i++) {
+        free(items[i]);
+    }
+    free(digests);
+    free(padded);
+    
+    ASSERT_TRUE(rc == 0, "混合长度批处理应成功");
+    ASSERT_TRUE(match, "每项结果应与补零后单独计算一致");
+    ASSERT_TRUE(rejected, "超过64KB的项应被拒绝且不写输出");
+    
+    TEST_END();
+}
+
+// 测试42：128位紧密输出测试
+// 紧密输出的每项应等于256位摘要的前16字节，且不写出output[count * 16]之后
+static int packed_matches(const uint8_t* packed, const uint8_t* full, int count) {
+    for (int i = 0; i < count; i++) {
+        if (memcmp(packed + i * 16, full + i * 32, 16) != 0) {
+            return 0;
+        }
+    }
+    return packed[count * 16] == 0xA5;
+}
+
+void test_packed_128bit_outputs() {
+    TEST_START("128位紧密输出测试");
+    
+    const int count = 150;  // 跨越多个分块与输出组
+    uint8_t* data = malloc((size_t)count * 8192);
+    uint8_t* full = malloc(count * 32);
+    uint8_t* packed = malloc(count * 16 + 1);
+    const uint8_t** inputs = malloc(count * sizeof(uint8_t*));
+    uint8_t** outputs = malloc(count * sizeof(uint8_t*));
+    size_t* lengths = malloc(count * sizeof(size_t));
+    for (size_t i = 0; i < (size_t)count * 8192; i++) {
+        data[i] = (uint8_t)(i * 59 + i / 4096);
+    }
+    for (int i = 0; i < count; i++) {
+        inputs[i] = data + (size_t)i * 4096;
+        outputs[i] = full + i * 32;
+    }
+    aes_sm3_integrity_batch(inputs, outputs, count);
+    
+    int single_ok = 1;
+    for (int i = 0; i < count; i++) {
+        uint8_t digest[16];
+        aes_sm3_integrity_128bit(inputs[i], digest);
+        single_ok &= memcmp(digest, full + i * 32, 16) == 0;
+    }
+    
+    memset(packed, 0xA5, count * 16 + 1);
+    aes_sm3_integrity_batch_128bit(inputs, packed, count);
+    int batch_ok = packed_matches(packed, full, count);
+    
+    memset(packed, 0xA5, count * 16 + 1);
+    aes_sm3_integrity_batch_mode_128bit(inputs, packed, count, AES_SM3_LOAD_STREAMING);
+    int stream_ok = packed_matches(packed, full, count);
+    
+    memset(packed, 0xA5, count * 16 + 1);
+    aes_sm3_parallel(data, packed, count, 4, 128);
+    int parallel_ok = packed_matches(packed, full, count);
+    
+    for (int i = 0; i < count; i++) {
+        inputs[i] = data + (size_t)i * 8192;
+        lengths[i] = (size_t)(i * 997) % 8193;
+    }
+    aes_sm3_integrity_batch_8k(inputs, outputs, count);
+    memset(packed, 0xA5, count * 16 + 1);
+    aes_sm3_integrity_batch_8k_128bit(inputs, packed, count);
+    int large_ok = packed_matches(packed, full, count);
+    
+    aes_sm3_integrity_batch_mixed(inputs, lengths, outputs, count);
+    memset(packed, 0xA5, count * 16 + 1);
+    aes_sm3_integrity_batch_mixed_128bit(inputs, lengths, packed, count);
+    int mixed_ok = packed_matches(packed, full, count);
+    
+    free(data);
+    free(full);
+    free(packed);
+    free(inputs);
+    free(outputs);
+    free(lengths);
+    
+    ASSERT_TRUE(single_ok, "单块128位输出应为256位输出的前缀");
+    ASSERT_TRUE(batch_ok, "批处理128位紧密输出应正确");
+    ASSERT_TRUE(stream_ok, "流式加载批处理128位紧密输出应正确");
+    ASSERT_TRUE(parallel_ok, "多线程并行128位紧密输出应正确");
+    ASSERT_TRUE(large_ok, "8KB批处理128位紧密输出应正确");
+    ASSERT_TRUE(mixed_ok, "混合长度批处理128位紧密输出应正确");
+    
+    TEST_END();
+}
+
+// 测试43：定位型摘要测试
+void test_localizing_digest() {
+    TEST_START("定位型摘要测试");
+    
+    const int count = 70;  // 跨越两个批处理组
+    uint8_t* data = malloc((size_t)count * 4096);
+    uint8_t* records = malloc(count * AES_SM3_LOCATOR_RECORD);
+    const uint8_t** inputs = malloc(count * sizeof(uint8_t*));
+    uint16_t* masks = malloc(count * sizeof(uint16_t));
+    for (size_t i = 0; i < (size_t)count * 4096; i++) {
+        data[i] = (uint8_t)(i * 211 + i / 256);
+    }
+    for (int i = 0; i < count; i++) {
+        inputs[i] = data + (size_t)i * 4096;
+    }
+    aes_sm3_integrity_batch_localizing(inputs, records, count);
+    
+    // 批处理记录与单页记录一致，摘要部分与256位摘要一致
+    int record_ok = 1;
+    for (int i = 0; i < count; i++) {
+        uint8_t record[AES_SM3_LOCATOR_RECORD], digest[32];
+        aes_sm3_integrity_localizing(inputs[i], record);
+        aes_sm3_integrity_256bit(inputs[i], digest);
+        record_ok &= memcmp(record, records + i * AES_SM3_LOCATOR_RECORD, AES_SM3_LOCATOR_RECORD) == 0;
+        record_ok &= memcmp(digest, record, 32) == 0;
+    }
+    int clean = aes_sm3_localize_damage_batch(inputs, records, count, masks);
+    int clean_masks = 1;
+    for (int i = 0; i < count; i++) {
+        clean_masks &= masks[i] == 0;
+    }
+    
+    // 损坏第66页的第3段和第12段（各一个缓存行内的若干字节；第12段的字节位于每16字节的高8字节）
+    uint8_t* page = data + (size_t)66 * 4096;
+    page[3 * 256 + 17] ^= 0x40;
+    page[12 * 256 + 200] ^= 0x01;
+    page[12 * 256 + 201] ^= 0x80;
+    int bad = aes_sm3_localize_damage_batch(inputs, records, count, masks);
+    int expected_mask = (1 << 3) | (1 << 12);
+    int damaged_mask = masks[66];
+    int others_clean = 1;
+    for (int i = 0; i < count; i++) {
+        if (i != 66) others_clean &= masks[i] == 0;
+    }
+    int single_mask = aes_sm3_localize_damage(page, records + 66 * AES_SM3_LOCATOR_RECORD);
+    
+    // 每一段单独损坏都应被准确定位
+    int each_ok = 1;
+    uint8_t* other = data + (size_t)5 * 4096;
+    for (int seg = 0; seg < 16; seg++) {
+        other[seg * 256 + 255] ^= 0x10;
+        each_ok &= aes_sm3_localize_damage(other, records + 5 * AES_SM3_LOCATOR_RECORD) == 1 << seg;
+        other[seg * 256 + 255] ^= 0x10;
+    }
+    
+    // 每16字节中的任一位置被修改都应被定位（aarch64上高8字节不进入摘要，只能由指纹检出）
+    for (int lane = 0; lane < 16; lane++) {
+        other[7 * 256 + 96 + lane] ^= 0x01;
+        each_ok &= aes_sm3_localize_damage(other, records + 5 * AES_SM3_LOCATOR_RECORD) == 1 << 7;
+        other[7 * 256 + 96 + lane] ^= 0x01;
+    }
+    
+    printf("  损坏页数: %d, 损坏段位图: 0x%04x\n", bad, damaged_mask);
+    
+    free(data);
+    free(records);
+    free(inputs);
+    free(masks);
+    
+    ASSERT_TRUE(record_ok, "定位型记录应与单页计算和256位摘要一致");
+    ASSERT_TRUE(clean == 0 && clean_masks, "未损坏时不应报告任何段");
+    ASSERT_TRUE(bad == 1 && damaged_mask == expected_mask && others_clean, "应只报告损坏页的损坏段");
+    ASSERT_TRUE(single_mask == expected_mask, "单页定位结果应与批处理一致");
+    ASSERT_TRUE(each_ok, "任一段、段内任一字节位置的损坏都应被准确定位");
+    
+    TEST_END();
+}
+
 // ============================================================================
 // 主测试运行器
 // ============================================================================
@@ -1268,6 +3284,34 @@ int main() {
     test_multithread_correctness();    // 测试19：多线程正确性测试
     test_sm3_optimization_comparison(); // 测试20：SM3优化效果对比测试
     
+    printf(COLOR_MAGENTA "\n═══════════════════════════════════════════════════════════\n");
+    printf("第七部分：并行引擎测试\n");
+    printf("═══════════════════════════════════════════════════════════\n" COLOR_RESET);
+    
+    test_mpmc_queue_engine();          // 测试21：无锁MPMC任务队列测试
+    test_adaptive_concurrency();       // 测试22：自适应线程数控制器测试
+    test_heterogeneous_partition();    // 测试23：异构核心拓扑加权分区测试
+    test_incremental_snapshot();       // 测试24：soft-dirty增量快照测试
+    test_background_scrubber();        // 测试25：限速后台巡检测试
+    test_parallel_image_diff();        // 测试26：并行页级差异比较测试
+    test_delta_sync();                 // 测试27：本地增量同步测试
+    test_integrity_log();              // 测试28：带完整性帧的追加日志测试
+    test_verified_page_cache();        // 测试29：校验型直读页缓存测试
+    test_page_checksum_shim();         // 测试30：数据库页校验垫片测试
+    test_stream_tee();                 // 测试31：管道流式透传校验测试
+    test_hugepage_buffers();           // 测试32：大页缓冲区与2MB分块测试
+    test_streaming_load_modes();       // 测试33：流式加载折叠内核测试
+    test_runtime_stats();              // 测试34：运行时统计测试
+    test_trace_export();               // 测试35：时间线追踪导出测试
+    test_usdt_probe_paths();           // 测试36：USDT探针挂接路径测试
+    test_eager_init();                 // 测试37：显式初始化测试
+    test_autotune_tiling();            // 测试38：自动调优分块测试
+    test_sector_tags();                // 测试39：512字节扇区标签测试
+    test_large_page_sizes();           // 测试40：大页面尺寸特化测试
+    test_mixed_length_batch();         // 测试41：混合长度批处理测试
+    test_packed_128bit_outputs();      // 测试42：128位紧密输出测试
+    test_localizing_digest();          // 测试43：定位型摘要测试
+    
     // 打印测试汇总
     print_test_summary();
     